@@ -83,6 +83,15 @@ private:
     // Default handler for unknown commands
     int handleUnknownCommand(const std::string& command);
 
+    // Run the --batch command
+    int runBatch(const std::vector<std::string>& args);
+
+    // Run the --ask command, through the service if one is running
+    int runAsk(const std::vector<std::string>& args);
+
+    // Run the --bench command
+    int runBench(const std::vector<std::string>& args);
+
     // Helper methods for service management
     bool isServiceRunning();
     bool startService();
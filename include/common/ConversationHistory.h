@@ -0,0 +1,141 @@
+#pragma once
+
+#include "include/common/Message.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/**
+ * @class ConversationHistory
+ * @brief Persistent, structurally shared list of chat messages
+ *
+ * Messages live in fixed-size chunks behind shared_ptr. Copying a history
+ * copies two pointers and a count, so a long conversation can be handed to
+ * a background request in O(1); the copy and the original then share every
+ * chunk, including the cached JSON fragments of their messages.
+ *
+ * Appending never changes what an existing copy sees. The first history to
+ * append after a copy writes into the shared tail chunk in place; any other
+ * history that later appends at the same position copies the tail first.
+ * A single history object is not safe for concurrent use, but separate
+ * copies may be used from different threads.
+ */
+class ConversationHistory {
+public:
+    static constexpr size_t CHUNK_SIZE = 32;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Message;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Message*;
+        using reference = const Message&;
+
+        const_iterator(const ConversationHistory* history, size_t index) : history(history), index(index) {}
+
+        reference operator*() const { return (*history)[index]; }
+        pointer operator->() const { return &(*history)[index]; }
+        const_iterator& operator++() { index++; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; index++; return old; }
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+    private:
+        const ConversationHistory* history;
+        size_t index;
+    };
+
+    ConversationHistory() : count(0) {}
+
+    /**
+     * @brief Build a history from a plain message list
+     * @param messages Messages to copy, oldest first
+     */
+    ConversationHistory(const std::vector<Message>& messages) : count(0) {
+        for (const auto& message : messages) {
+            push_back(message);
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const Message& operator[](size_t index) const {
+        size_t chunk = index / CHUNK_SIZE;
+        if (full && chunk < full->size()) {
+            return (*full)[chunk]->items[index % CHUNK_SIZE];
+        }
+        return tail->items[index % CHUNK_SIZE];
+    }
+
+    const Message& back() const { return (*this)[count - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    /**
+     * @brief Append a message without affecting copies of this history
+     * @param message Message to append
+     */
+    void push_back(Message message) {
+        size_t index = count % CHUNK_SIZE;
+        if (tail && index == 0) {
+            // The tail is full: move it onto a new spine that copies share
+            auto spine = full ? std::make_shared<Spine>(*full) : std::make_shared<Spine>();
+            spine->push_back(tail);
+            full = std::move(spine);
+            tail.reset();
+        }
+
+        if (!tail) {
+            tail = std::make_shared<Chunk>();
+        }
+
+        size_t expected = index;
+        if (!tail->used.compare_exchange_strong(expected, index + 1)) {
+            // Another copy already appended here; branch off a private tail
+            auto branch = std::make_shared<Chunk>();
+            for (size_t i = 0; i < index; i++) {
+                branch->items[i] = tail->items[i];
+            }
+            branch->used.store(index + 1);
+            tail = std::move(branch);
+        }
+
+        tail->items[index] = std::move(message);
+        count++;
+    }
+
+    /**
+     * @brief Drop all messages; copies keep theirs
+     */
+    void clear() {
+        full.reset();
+        tail.reset();
+        count = 0;
+    }
+
+    /**
+     * @brief Copy the messages into a plain vector
+     * @return Messages, oldest first
+     */
+    std::vector<Message> toVector() const {
+        return std::vector<Message>(begin(), end());
+    }
+
+private:
+    struct Chunk {
+        std::array<Message, CHUNK_SIZE> items;
+        // Slots claimed by some history; a slot is written once, by its claimant
+        std::atomic<size_t> used{ 0 };
+    };
+    using Spine = std::vector<std::shared_ptr<Chunk>>;
+
+    std::shared_ptr<const Spine> full;  // Completely filled chunks
+    std::shared_ptr<Chunk> tail;        // Chunk holding the last count % CHUNK_SIZE messages
+    size_t count;
+};
@@ -1,13 +1,13 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include "include/utils/JsonWriter.h"
+#include <memory>
 #include <string>
+#include <utility>
 
 // Ϣṹ
 struct Message {
-    std::string role;    // "user" or "assistant"
-    std::string content; // Message content
-
     // Default constructor
     Message() = default;
 
@@ -15,6 +15,74 @@ struct Message {
     Message(const std::string& r, const std::string& c)
         : role(r), content(c) {
     }
+
+    // The cached fragment may be published by jsonFragment() on another thread
+    Message(const Message& other)
+        : role(other.role), content(other.content), fragment(std::atomic_load(&other.fragment)) {
+    }
+
+    Message(Message&& other) noexcept
+        : role(std::move(other.role)), content(std::move(other.content)),
+        fragment(std::atomic_exchange(&other.fragment, std::shared_ptr<const std::string>())) {
+    }
+
+    Message& operator=(const Message& other) {
+        if (this != &other) {
+            role = other.role;
+            content = other.content;
+            std::atomic_store(&fragment, std::atomic_load(&other.fragment));
+        }
+        return *this;
+    }
+
+    Message& operator=(Message&& other) noexcept {
+        if (this != &other) {
+            role = std::move(other.role);
+            content = std::move(other.content);
+            std::atomic_store(&fragment, std::atomic_exchange(&other.fragment, std::shared_ptr<const std::string>()));
+        }
+        return *this;
+    }
+
+    const std::string& getRole() const { return role; }       // "user", "assistant" or "system"
+    const std::string& getContent() const { return content; }
+
+    /**
+     * @brief Serialized {"content":...,"role":...} object for request bodies
+     *
+     * Computed on first use and shared by every copy of the message, so a
+     * history is only serialized once no matter how many turns resend it.
+     * Role and content cannot change after construction, so the cached text
+     * never goes stale; assign a new Message to change them.
+     * @return JSON text; stays valid while held, even if the message is assigned over
+     * @throws nlohmann::json::type_error if role or content is not valid UTF-8
+     */
+    std::shared_ptr<const std::string> jsonFragment() const {
+        std::shared_ptr<const std::string> cached = std::atomic_load(&fragment);
+        if (!cached) {
+            auto built = std::make_shared<std::string>();
+            built->reserve(26 + JsonWriter::estimateStringSize(content) +
+                JsonWriter::estimateStringSize(role));
+            built->append("{\"content\":");
+            JsonWriter::appendString(*built, content);
+            built->append(",\"role\":");
+            JsonWriter::appendString(*built, role);
+            built->push_back('}');
+
+            // Another thread may have published the same text first; keep theirs
+            cached = built;
+            std::shared_ptr<const std::string> expected;
+            if (!std::atomic_compare_exchange_strong(&fragment, &expected, cached)) {
+                cached = expected;
+            }
+        }
+        return cached;
+    }
+
+private:
+    std::string role;    // "user" or "assistant"
+    std::string content; // Message content
+    mutable std::shared_ptr<const std::string> fragment;
 };
 
 #endif // MESSAGE_H
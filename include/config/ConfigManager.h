@@ -40,6 +40,14 @@ public:
      */
     std::string getSetting(const std::string& key, const std::string& defaultValue = "") const;
 
+    /**
+     * @brief Get a numeric configuration setting
+     * @param key Setting name
+     * @param defaultValue Value used if the setting is missing or not a number
+     * @return Setting value or defaultValue
+     */
+    long long getIntSetting(const std::string& key, long long defaultValue) const;
+
     /**
      * @brief Set a configuration setting
      * @param key Setting name
@@ -48,6 +56,12 @@ public:
      */
     bool setSetting(const std::string& key, const std::string& value);
 
+    /**
+     * @brief Get the directory holding the configuration file
+     * @return Directory path, e.g. ~/.pichat
+     */
+    std::string getConfigDirectory() const;
+
     /**
      * @brief Get the current language setting
      * @return Language code (e.g., "en", "zh")
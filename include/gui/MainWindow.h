@@ -5,7 +5,7 @@
 #include <QString>
 #include <QVector>
 #include <QMessageBox>
-#include "include/common/Message.h"
+#include "include/common/ConversationHistory.h"
 #include "include/utils/DeepSeekAPI.h"
 
 class SettingsDialog;
@@ -36,5 +36,6 @@ private:
 
     Ui::MainWindow* ui;
     DeepSeekAPI* api;
-    std::vector<Message> chatHistory;
+    ConversationHistory chatHistory;
+    int pendingReplies;  // Requests sent whose reply has not arrived; Esc cancels them
 };
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @enum RequestClass
+ * @brief Kind of client a service request comes from
+ */
+enum class RequestClass {
+    RC_INTERACTIVE,  // Chat typed by a user, e.g. the GUI or --ask
+    RC_VOICE,        // Voice mode, which has to answer before the pause gets awkward
+    RC_BATCH         // Bulk jobs nobody watches token by token
+};
+
+/**
+ * @brief Parse a request class name
+ * @param name "interactive", "voice" or "batch"
+ * @param requestClass Set to the class on success
+ * @return true if the name is known
+ */
+bool parseRequestClass(const std::string& name, RequestClass& requestClass);
+
+/**
+ * @struct AdmissionClassStats
+ * @brief Queue counters and wait histogram of one request class
+ */
+struct AdmissionClassStats {
+    std::string name;
+    double sloMs;            // Queue-time objective
+    size_t queued;           // Waiting now
+    size_t admitted;         // Sent upstream since start
+    size_t shed;             // Turned away or evicted since start
+    size_t sloMisses;        // Admitted after waiting longer than sloMs
+    double waitSumMs;        // Total queue wait of the admitted requests
+    std::vector<size_t> waitBuckets;  // Per AdmissionQueue::waitBucketBoundsMs(), plus one for longer waits
+};
+
+/**
+ * @struct AdmissionStats
+ * @brief Snapshot of an AdmissionQueue
+ */
+struct AdmissionStats {
+    size_t running;   // Admitted requests that have not finished
+    size_t capacity;  // Requests allowed to run at once, now
+    std::vector<AdmissionClassStats> classes;  // Indexed by RequestClass
+};
+
+/**
+ * @class AdmissionQueue
+ * @brief Decides which waiting service request goes upstream next
+ *
+ * Only a limited number of requests run at once; the rest wait here rather
+ * than in the FIFO of the RateLimiter, so one client cannot crowd out
+ * another. When a slot frees up, voice goes before interactive and
+ * interactive before batch, unless a class has a request waiting past its
+ * queue-time objective: then the class furthest past it goes first, so a
+ * batch job slows down under load but never stalls. Within a class, clients
+ * take turns by deficit round robin, weighted by the estimated tokens of
+ * each request.
+ *
+ * A new request is shed when its class has a request that waited longer than
+ * admission_shed_factor times the objective. When the queue is full, the
+ * newest request of a lower class is evicted to make room, or the new one
+ * is refused.
+ *
+ * Settings: admission_max_in_flight (default 0, follow the RateLimiter's
+ * concurrency limit), admission_max_queue, admission_quantum (tokens per
+ * round), admission_shed_factor, admission_slo_interactive_ms,
+ * admission_slo_voice_ms, admission_slo_batch_ms.
+ */
+class AdmissionQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct Request
+     * @brief A request waiting for admission
+     */
+    struct Request {
+        RequestClass requestClass = RequestClass::RC_INTERACTIVE;
+        std::string client;  // Fairness key; requests of one client share one turn
+        uint64_t owner = 0;  // Connection the request belongs to
+        uint64_t id = 0;     // Request id within the owner
+        size_t cost = 1;     // Estimated tokens
+        std::function<void()> start;                      // Send it upstream
+        std::function<void(const std::string&)> reject;  // Refuse it, with the reason
+    };
+
+    AdmissionQueue();
+
+    /**
+     * @brief Queue a request, or start it right away if there is room
+     *
+     * Exactly one of start and reject is called, possibly before this returns.
+     * @param request Request to admit
+     */
+    void submit(Request request);
+
+    /**
+     * @brief Report that an admitted request finished
+     * @param owner Owner of the request
+     * @param id Request id within the owner
+     * @return true if the request had been admitted; then more may start
+     */
+    bool finish(uint64_t owner, uint64_t id);
+
+    /**
+     * @brief Refuse every waiting request of an owner, e.g. a closed connection
+     * @param owner Owner of the requests
+     * @param reason Reason passed to the reject callbacks
+     */
+    void rejectOwner(uint64_t owner, const std::string& reason);
+
+    /**
+     * @brief Refuse every waiting request
+     * @param reason Reason passed to the reject callbacks
+     */
+    void rejectAll(const std::string& reason);
+
+    /**
+     * @brief Get queue lengths, counters and wait histograms
+     * @return Snapshot of the queue
+     */
+    AdmissionStats getStats() const;
+
+    /**
+     * @brief Upper bounds of the wait histogram buckets
+     * @return Bounds in milliseconds, ascending
+     */
+    static const std::vector<double>& waitBucketBoundsMs();
+
+private:
+    static const size_t CLASS_COUNT = 3;
+
+    struct Waiting {
+        Request request;
+        Clock::time_point queuedAt;
+        uint64_t sequence;  // Order of arrival, to find the newest
+    };
+
+    // Deficit round robin over the clients of one class
+    struct ClassQueue {
+        std::unordered_map<std::string, std::deque<Waiting>> clients;
+        std::unordered_map<std::string, size_t> deficits;
+        std::deque<std::string> active;  // Clients with waiting requests, in turn order
+        size_t size = 0;
+        double sloMs = 0;
+
+        size_t admitted = 0;
+        size_t shed = 0;
+        size_t sloMisses = 0;
+        double waitSumMs = 0;
+        std::vector<size_t> waitBuckets;
+    };
+
+    // Called with mutex held
+    size_t capacity() const;
+    Clock::time_point oldest(const ClassQueue& queue) const;
+    size_t pickClass(Clock::time_point now) const;
+    Waiting takeNext(ClassQueue& queue);
+    bool evictBelow(RequestClass requestClass, Request& evicted);
+    void removeWaiting(const std::function<bool(const Request&)>& matches, std::vector<Request>& removed);
+    void recordWait(ClassQueue& queue, double waitMs);
+    void collectStarts(std::vector<std::function<void()>>& starts);
+
+    mutable std::mutex mutex;
+    ClassQueue classes[CLASS_COUNT];
+    std::set<std::pair<uint64_t, uint64_t>> running;
+    size_t waitingCount;
+    uint64_t nextSequence;
+
+    size_t configuredCapacity;
+    size_t maxQueue;
+    size_t quantum;
+    double shedFactor;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @enum RpcType
+ * @brief Frame types of the binary protocol between the CLI and the daemon
+ */
+enum class RpcType : uint8_t {
+    RPC_STATUS = 0x01,        // Client: empty body
+    RPC_CHAT = 0x02,          // Client: see RpcProtocol
+    RPC_METRICS = 0x03,       // Client: empty body
+    RPC_TRACE = 0x04,         // Client: empty body
+    RPC_STATUS_REPLY = 0x81,  // Daemon: pid, uptime ms and the ServiceStats counters, u64 each
+    RPC_DELTA = 0x82,         // Daemon: u32 id, then the streamed text to the end of the frame
+    RPC_REPLY = 0x83,         // Daemon: u32 id, u8 ok, then the reply or error to the end of the frame
+    RPC_ERROR = 0x84,         // Daemon: u32 id (0 if unknown), then the message
+    RPC_METRICS_REPLY = 0x85, // Daemon: the Prometheus text of Metrics::renderText()
+    RPC_TRACE_REPLY = 0x86    // Daemon: the JSON of Tracer::toChromeJson()
+};
+
+/**
+ * @class RpcProtocol
+ * @brief Framing of the binary protocol spoken on the daemon's Unix socket
+ *
+ * A client opens with the four bytes of MAGIC, whose leading zero byte tells
+ * the daemon it is neither a JSON-lines nor an HTTP client. Then each
+ * message is one frame: a big-endian u32 length of what follows, a u8
+ * RpcType and the body. Integers are big-endian, strings are a u32 length
+ * followed by the bytes.
+ *
+ * An RPC_CHAT body is: u32 id, u8 flags (CHAT_STREAM, CHAT_NO_CACHE, and
+ * CHAT_VOICE or CHAT_BATCH for a request that is not interactive), f32
+ * temperature, i32 max tokens, the model, a u32 message count and a role
+ * and content per message.
+ */
+class RpcProtocol {
+public:
+    static constexpr char MAGIC[4] = { '\0', 'P', 'C', '1' };
+
+    static const uint8_t CHAT_STREAM = 0x01;
+    static const uint8_t CHAT_NO_CACHE = 0x02;
+    static const uint8_t CHAT_VOICE = 0x04;
+    static const uint8_t CHAT_BATCH = 0x08;
+
+    /**
+     * @brief Start a frame; finish it with endFrame()
+     * @param out Output buffer
+     * @param type Frame type
+     * @return Offset of the frame in out
+     */
+    static size_t beginFrame(std::string& out, RpcType type);
+
+    /**
+     * @brief Fill in the length of a frame started with beginFrame()
+     * @param out Output buffer
+     * @param frameStart Offset returned by beginFrame()
+     */
+    static void endFrame(std::string& out, size_t frameStart);
+
+    static void appendU8(std::string& out, uint8_t value);
+    static void appendU32(std::string& out, uint32_t value);
+    static void appendU64(std::string& out, uint64_t value);
+    static void appendFloat(std::string& out, float value);
+    static void appendString(std::string& out, const std::string& value);
+
+    /**
+     * @brief Take the next complete frame off the front of a buffer
+     * @param buffer Received bytes; a complete frame is removed from the front
+     * @param type Frame type
+     * @param body Frame body without length and type
+     * @param maxSize Largest frame accepted
+     * @param invalid Set if the next frame is empty or exceeds maxSize
+     * @return True if a frame was taken
+     */
+    static bool takeFrame(std::string& buffer, RpcType& type, std::string& body, size_t maxSize, bool& invalid);
+};
+
+/**
+ * @class RpcReader
+ * @brief Reads the fields of a frame body in order
+ *
+ * Every read fails, and keeps failing, once the body is too short.
+ */
+class RpcReader {
+public:
+    explicit RpcReader(const std::string& body) : data(body), offset(0), failed(false) {}
+
+    uint8_t readU8();
+    uint32_t readU32();
+    uint64_t readU64();
+    float readFloat();
+    std::string readString();
+
+    /**
+     * @brief Read everything left in the body
+     * @return Remaining bytes
+     */
+    std::string readRest();
+
+    bool ok() const { return !failed; }
+
+private:
+    bool need(size_t size);
+
+    const std::string& data;
+    size_t offset;
+    bool failed;
+};
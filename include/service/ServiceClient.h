@@ -0,0 +1,97 @@
+#pragma once
+
+#include "include/common/ConversationHistory.h"
+#include "include/service/RpcProtocol.h"
+#include "include/service/ServiceDaemon.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * @struct ServiceStatus
+ * @brief Health of a running daemon, as reported over its socket
+ */
+struct ServiceStatus {
+    long long pid;
+    ServiceStats stats;
+};
+
+/**
+ * @class ServiceClient
+ * @brief Connection from a CLI process to a running ServiceDaemon
+ *
+ * Speaks the binary RpcProtocol over the daemon's Unix domain socket, so a
+ * one-shot command reuses the daemon's warm connections and response cache
+ * instead of opening its own. Calls block; one request runs at a time.
+ */
+class ServiceClient {
+public:
+    ServiceClient();
+    ~ServiceClient();
+
+    ServiceClient(const ServiceClient&) = delete;
+    ServiceClient& operator=(const ServiceClient&) = delete;
+
+    /**
+     * @brief Connect to a daemon
+     * @param socketPath Path of the daemon's socket
+     * @return True if a daemon accepted the connection
+     */
+    bool connect(const std::string& socketPath);
+
+    /**
+     * @brief Close the connection; a request in flight is cancelled
+     */
+    void disconnect();
+
+    bool isConnected() const;
+
+    /**
+     * @brief Ask the daemon how it is doing
+     * @param status Filled with the reply
+     * @param timeoutMs How long to wait for the reply
+     * @return True if the daemon answered in time
+     */
+    bool getStatus(ServiceStatus& status, int timeoutMs = 2000);
+
+    /**
+     * @brief Fetch the daemon's metrics
+     * @param text Filled with the Prometheus text exposition
+     * @param timeoutMs How long to wait for the reply
+     * @return True if the daemon answered in time
+     */
+    bool getMetrics(std::string& text, int timeoutMs = 2000);
+
+    /**
+     * @brief Fetch the spans the daemon's Tracer has buffered
+     * @param json Filled with the Chrome trace-event JSON
+     * @param timeoutMs How long to wait for the reply
+     * @return True if the daemon answered in time
+     */
+    bool getTrace(std::string& json, int timeoutMs = 5000);
+
+    /**
+     * @brief Run a chat completion on the daemon
+     *
+     * Takes the same arguments as streamingChatCompletion() and returns the
+     * reply or error text the same way.
+     * @param onDelta Called with each streamed piece; null for no streaming
+     * @param reply Filled with the reply or error text
+     * @return False if the daemon refused the request or the connection
+     *         failed before the reply arrived
+     */
+    bool chat(const ConversationHistory& messages,
+        std::function<void(const std::string&)> onDelta,
+        std::string& reply,
+        const std::string& model = "deepseek-chat",
+        float temperature = 0.7,
+        int maxTokens = 1000);
+
+private:
+    bool sendAll(const std::string& data);
+    bool readFrame(RpcType& type, std::string& body, int timeoutMs);
+
+    int fd;
+    std::string input;
+    uint32_t nextId;
+};
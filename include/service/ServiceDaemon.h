@@ -0,0 +1,213 @@
+#pragma once
+
+#include "include/common/ConversationHistory.h"
+#include "include/service/AdmissionQueue.h"
+#include "include/utils/CancellationToken.h"
+#include "include/utils/CompletionOptions.h"
+#include "include/utils/ResponseCache.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class RpcType : uint8_t;
+
+/**
+ * @struct ServiceStats
+ * @brief Counters of a running ServiceDaemon
+ */
+struct ServiceStats {
+    size_t connections;          // Clients connected now
+    size_t acceptedConnections;  // Clients accepted since start
+    size_t requests;             // Requests received since start
+    size_t activeRequests;       // Requests still waiting for their reply
+    double uptimeSeconds;
+};
+
+/**
+ * @class ServiceDaemon
+ * @brief Long-running process that serves chat requests to local clients
+ *
+ * Listens on a Unix domain socket and, if configured, on a TCP port of
+ * 127.0.0.1. A single epoll loop accepts clients, reads their requests and
+ * writes the replies; completions run on the RequestEngine, whose pooled
+ * connections stay open between requests. Clients thus pay neither process
+ * startup nor TCP and TLS handshakes.
+ *
+ * Each request is one JSON object on one line:
+ *   {"id": any, "prompt": "..." | "messages": [...], "model": ..., "temperature": ...,
+ *    "max_tokens": ..., "stream": bool, "timeout_ms": ..., "no_cache": bool,
+ *    "class": "interactive" | "voice" | "batch", "client": "..."}
+ * and is answered with {"id": ..., "ok": bool, "reply" | "error": "..."}. A
+ * streaming request first gets {"id": ..., "delta": "..."} lines, then the
+ * final line with "done": true. Several requests may be in flight on one
+ * connection; replies carry the id of their request.
+ *
+ * A connection whose first byte starts an HTTP request line is served as
+ * an OpenAI-compatible endpoint instead: POST /v1/chat/completions takes the
+ * usual request body, which goes upstream unchanged under the daemon's key.
+ * A streamed reply is relayed to the client as the upstream bytes arrive,
+ * without being parsed or copied into a reply line first. Requests the
+ * response cache can answer never leave the machine. GET /metrics returns
+ * the Metrics registry in the Prometheus text format, GET /debug/trace the
+ * spans the Tracer has buffered as Chrome trace-event JSON.
+ * Requests carrying an Origin header or a Host other than the loopback are
+ * refused, as are chat requests whose Content-Type is not application/json,
+ * so web pages cannot use the gateway through the user's browser.
+ *
+ * A connection that opens with RpcProtocol::MAGIC speaks the binary
+ * protocol of the ServiceClient, which the CLI uses for --status and
+ * one-shot prompts.
+ *
+ * Requests that go upstream pass an AdmissionQueue first, which orders them
+ * by class and shares the upstream fairly between clients. A client is its
+ * connection unless the request names one ("client", or the X-PiChat-Client
+ * header); HTTP requests give their class in X-PiChat-Class. Shed requests
+ * get an error, or 503 with Retry-After over HTTP.
+ *
+ * SIGTERM or SIGINT stops accepting clients and waits up to
+ * service_drain_seconds for requests in flight before cancelling them.
+ *
+ * Settings: service_socket (default <config dir>/pichat.sock),
+ * service_tcp_port (default 0, off), service_max_connections,
+ * service_max_request_kb, service_drain_seconds, service_http_token
+ * (Bearer token HTTP clients must send; default empty, none). The TCP port
+ * only serves HTTP, and run() refuses to start with it but without a token.
+ *
+ * Needs epoll, so run() fails on platforms other than Linux.
+ */
+class ServiceDaemon {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the ServiceDaemon instance
+     */
+    static ServiceDaemon& getInstance();
+
+    /**
+     * @brief Serve clients until a shutdown signal or stop()
+     *
+     * Blocks SIGTERM and SIGINT in the calling thread to receive them through
+     * a signalfd, so it must be called before other threads are started.
+     * @return Process exit code
+     */
+    int run();
+
+    /**
+     * @brief Begin a graceful shutdown, from any thread
+     */
+    void stop();
+
+    /**
+     * @brief Get connection and request counters
+     * @return Snapshot of the counters
+     */
+    ServiceStats getStats() const;
+
+    /**
+     * @brief Get the admission queue lengths and wait histograms
+     * @return Snapshot of the admission queue
+     */
+    AdmissionStats getAdmissionStats() const;
+
+    /**
+     * @brief Get the path of the Unix domain socket
+     *
+     * Reads only the settings, so clients can find the daemon without
+     * constructing it.
+     * @return Socket path from the settings
+     */
+    static std::string getSocketPath();
+
+private:
+    ServiceDaemon();
+    ServiceDaemon(const ServiceDaemon&) = delete;
+    ServiceDaemon& operator=(const ServiceDaemon&) = delete;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection;
+    struct HttpHead;
+    struct DirectSink;
+
+    // Output produced on the engine thread for the loop to write
+    struct Outgoing {
+        uint64_t connection;
+        uint64_t request;
+        std::string data;
+        bool finished;  // Last output of the request
+    };
+
+    bool openListeners();
+    void closeListeners();
+    void acceptClients(int listener);
+    void readClient(uint64_t id);
+    void writeClient(uint64_t id);
+    void closeClient(uint64_t id);
+    void updateEvents(Connection& connection, bool sinkBacklog);
+    void processLines(Connection& connection);
+    void handleLine(Connection& connection, const std::string& line);
+    void processFrames(Connection& connection);
+    void handleFrame(Connection& connection, RpcType type, const std::string& body);
+
+    // Turns a streamed piece or the final reply into protocol output
+    using Encoder = std::function<std::string(const std::string&)>;
+
+    // Null encodeDelta for a completion that is not streamed; encodeError
+    // turns the reason a request was refused admission into output
+    void startCompletion(Connection& connection, const ConversationHistory& messages,
+        const std::string& model, float temperature, int maxTokens, const CompletionOptions& options,
+        RequestClass requestClass, const std::string& client,
+        Encoder encodeDelta, Encoder encodeReply, Encoder encodeError);
+    void processHttp(Connection& connection);
+    void handleHttpRequest(Connection& connection, const HttpHead& head, std::string body);
+    void handleChatCompletions(Connection& connection, const HttpHead& head, std::string body);
+    void forwardHttp(uint64_t connectionId, uint64_t requestId, std::string body, bool stream,
+        bool keepAlive, bool cacheable, const CacheKey& key, const CompletionOptions& options);
+    void finishHttpResponse(Connection& connection, const std::string& tail);
+    bool relay(const std::shared_ptr<DirectSink>& sink, const char* data, size_t size);
+    void post(uint64_t connection, uint64_t request, std::string data, bool finished);
+    void deliverOutgoing();
+    void beginShutdown();
+    void cancelAll();
+    void registerMetrics();
+    bool flushed() const;
+
+    // Loop state, touched only by the thread in run()
+    int epollFd;
+    int signalFd;
+    int wakeFd;
+    int unixListener;
+    int tcpListener;
+    std::string apiKey;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    AdmissionQueue admission;
+    uint64_t nextConnectionId;
+    size_t activeRequests;
+    uint64_t nextCompletionId;  // For ids of replies served from the cache
+    bool draining;
+    Clock::time_point drainDeadline;
+
+    std::string socketPath;
+    int tcpPort;
+    size_t maxConnections;
+    size_t maxRequestBytes;
+    std::chrono::seconds drainTimeout;
+    std::string httpToken;
+
+    std::mutex outboxMutex;
+    std::vector<Outgoing> outbox;
+    std::atomic<bool> stopRequested;
+
+    std::atomic<size_t> connectionCount;
+    std::atomic<size_t> acceptedCount;
+    std::atomic<size_t> requestCount;
+    std::atomic<size_t> activeCount;
+    Clock::time_point startedAt;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "include/utils/ErrorHandler.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @struct AsyncLoggerStats
+ * @brief Counters of an AsyncLogger
+ */
+struct AsyncLoggerStats {
+    size_t capacity;  // Records the queue holds
+    size_t queued;    // Records waiting to be written
+    uint64_t written;  // Records written since start
+    uint64_t dropped;  // Records refused because the queue was full
+};
+
+/**
+ * @class AsyncLogger
+ * @brief Writes log lines to the console from a background thread
+ *
+ * Producers claim a slot of a fixed ring with one compare-and-swap and copy
+ * the record in; they never wait for a lock or for console I/O. A full ring
+ * drops the record and counts it rather than blocking the caller. The
+ * writer thread formats what has queued up and writes it in one batch per
+ * stream, flushing once per batch, and reports drops with a warning line.
+ *
+ * Lines keep the "[LEVEL] message" format; info and warnings go to stdout,
+ * errors to stderr. With error_log_file set, every line is also appended
+ * there with its timestamp and context; when the file passes
+ * error_log_max_kb it is renamed to error_log_file.1, the older ones move
+ * up by one, and those past error_log_files are removed.
+ *
+ * Settings: log_queue_capacity (records, rounded up to a power of two,
+ * default 4096), error_log_file (default empty, no file), error_log_max_kb
+ * (default 1024), error_log_files (rotated files kept, default 3).
+ */
+class AsyncLogger {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the AsyncLogger instance
+     */
+    static AsyncLogger& getInstance();
+
+    /**
+     * @brief Queue a line; writes it right away once the logger is shut down
+     * @param level Severity, which picks the prefix and the stream
+     * @param message Text of the line
+     * @param context Where it comes from; only written to the log file
+     * @param timestamp When it happened; only written to the log file
+     * @return false if the queue was full and the line was dropped
+     */
+    bool log(ErrorLevel level, const std::string& message, const std::string& context = "",
+        const std::string& timestamp = "");
+
+    /**
+     * @brief Wait until every line queued so far has been written
+     */
+    void flush();
+
+    /**
+     * @brief Write what is queued and stop the writer thread; later lines are written synchronously
+     */
+    void shutdown();
+
+    /**
+     * @brief Get queue size and counters
+     * @return Snapshot of the logger
+     */
+    AsyncLoggerStats getStats() const;
+
+private:
+    AsyncLogger();
+    ~AsyncLogger();
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // A slot is free for the producer at position p when sequence == p, and
+    // holds a record for the writer when sequence == p + 1
+    struct Slot {
+        std::atomic<size_t> sequence{ 0 };
+        ErrorLevel level = ErrorLevel::EL_INFO;
+        std::string message;
+        std::string context;
+        std::string timestamp;
+    };
+
+    void writerLoop();
+    size_t drainBatch();  // One thread at a time: the writer, or shutdown() after it
+    bool hasRecord() const;
+    void writeFile(const std::string& lines);  // Appends and rotates; same threads as drainBatch()
+
+    std::unique_ptr<Slot[]> ring;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail;  // Next position producers claim
+    alignas(64) std::atomic<size_t> head;  // Next position the writer reads
+    alignas(64) std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> written;
+    uint64_t reportedDrops;  // Writer thread only
+
+    std::string filePath;  // Empty when lines only go to the console
+    size_t fileMaxBytes;
+    size_t fileCount;
+    std::ofstream file;
+    size_t fileSize;
+
+    // Only taken to sleep and wake up; producers take it when the writer is asleep
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable drained;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> running;
+    bool stopping;
+    std::thread writer;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "include/common/ConversationHistory.h"
+#include "include/utils/CompletionOptions.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @struct BatchItem
+ * @brief One independent prompt of a batch
+ */
+struct BatchItem {
+    ConversationHistory messages;
+    std::string model = "deepseek-chat";
+    float temperature = 0.7f;
+    int maxTokens = 1000;
+};
+
+/**
+ * @struct BatchResult
+ * @brief Outcome of one batch item
+ */
+struct BatchResult {
+    size_t index;        // Position of the item in the input
+    std::string reply;   // Model output, or the error message if !ok
+    bool ok;
+    double startedMs;    // When the request was sent, relative to the start of the batch
+    double latencyMs;    // From sending the request to its reply
+};
+
+/**
+ * @struct BatchSummary
+ * @brief Totals of a finished batch
+ */
+struct BatchSummary {
+    size_t items = 0;        // Items sent; fewer than the input if the batch was cancelled
+    size_t succeeded = 0;
+    size_t failed = 0;
+    double elapsedMs = 0.0;
+    double meanLatencyMs = 0.0;
+    double maxLatencyMs = 0.0;
+};
+
+/**
+ * @brief Supplies the next item of a batch
+ * @return false once there are no more items
+ */
+using BatchSource = std::function<bool(BatchItem& item)>;
+
+/**
+ * @brief Receives the results of a batch, in input order
+ */
+using BatchSink = std::function<void(BatchResult&& result)>;
+
+/**
+ * @brief Run many independent chat completions concurrently
+ *
+ * At most maxInFlight requests are outstanding at once. Results reach the
+ * sink in input order, on the calling thread, as soon as every earlier item
+ * has finished. Items are pulled from the source only as there is room, and
+ * no item is sent further than twice maxInFlight ahead of the oldest
+ * unfinished one, so memory stays bounded however long the batch is.
+ *
+ * Every item shares options; cancelling options.cancellation aborts the
+ * items in flight and stops pulling new ones.
+ *
+ * @param apiKey API key used for every item
+ * @param next Source of the items
+ * @param sink Receiver of the results
+ * @param maxInFlight Concurrency limit, 0 for the batch_max_in_flight setting (default 16)
+ * @param options Completion options applied to every item
+ * @return Totals of the batch, once every result has been delivered
+ */
+BatchSummary batchChatCompletion(
+    const std::string& apiKey,
+    BatchSource next,
+    BatchSink sink,
+    size_t maxInFlight = 0,
+    const CompletionOptions& options = CompletionOptions()
+);
+
+/**
+ * @brief Run the items of a vector as a batch
+ * @see batchChatCompletion(const std::string&, BatchSource, BatchSink, size_t, const CompletionOptions&)
+ */
+BatchSummary batchChatCompletion(
+    const std::string& apiKey,
+    const std::vector<BatchItem>& items,
+    BatchSink sink,
+    size_t maxInFlight = 0,
+    const CompletionOptions& options = CompletionOptions()
+);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct TokenizerStats
+ * @brief Merge cache counters of a BpeTokenizer
+ */
+struct TokenizerStats {
+    size_t cacheHits;
+    size_t cacheMisses;
+    size_t cacheEntries;
+};
+
+/**
+ * @class BpeTokenizer
+ * @brief Byte-level BPE tokenizer for prompt token counts
+ *
+ * Loads a GPT-2 style vocabulary, either as vocab.json plus merges.txt or
+ * as a Hugging Face tokenizer.json. Text is split with the GPT-2
+ * pre-tokenization rules (contractions, letter runs, digit runs, symbol
+ * runs and whitespace), where runs of ASCII letters are found with SIMD
+ * compares. Each piece is then merged in rank order.
+ *
+ * Counts are not exact for vocabularies trained with other split rules.
+ * The pre_tokenizer of a tokenizer.json is not applied, and outside ASCII
+ * only a few blocks of digits, spaces and symbols are told apart: every
+ * other character, combining marks and CJK included, counts as a letter.
+ * DeepSeek splits CJK and digits differently, so its counts can differ.
+ *
+ * Merged pieces are kept in a bounded LRU cache, since most words repeat.
+ * The tokenizer must be loaded before use; after that it can be shared
+ * between threads.
+ */
+class BpeTokenizer {
+public:
+    /**
+     * @brief Get the shared tokenizer
+     *
+     * On first use it loads tokenizer_path (a tokenizer.json), or
+     * tokenizer_vocab and tokenizer_merges, from ConfigManager settings.
+     * Without settings it looks in the tokenizer directory next to the
+     * configuration file.
+     * @return Reference to the tokenizer; check isLoaded() before use
+     */
+    static BpeTokenizer& getInstance();
+
+    BpeTokenizer();
+
+    /**
+     * @brief Load vocab.json and merges.txt
+     * @param vocabPath JSON object mapping token text to id
+     * @param mergesPath One "left right" merge per line, highest priority first
+     * @return true if the tokenizer is ready
+     */
+    bool load(const std::string& vocabPath, const std::string& mergesPath);
+
+    /**
+     * @brief Load the model section of a Hugging Face tokenizer.json
+     *
+     * Only the vocabulary and merges are read; the file's pre_tokenizer
+     * is replaced by the GPT-2 split rules.
+     * @param path tokenizer.json path
+     * @return true if the tokenizer is ready
+     */
+    bool loadTokenizerJson(const std::string& path);
+
+    bool isLoaded() const;
+
+    /**
+     * @brief Get the reason the last load failed
+     * @return Error text, empty after a successful load
+     */
+    std::string getLastError() const;
+
+    /**
+     * @brief Encode text to token ids
+     * @param text UTF-8 text
+     * @return Token ids
+     */
+    std::vector<int> encode(std::string_view text) const;
+
+    /**
+     * @brief Count the tokens of text without materializing the ids
+     * @param text UTF-8 text
+     * @return Token count
+     */
+    size_t countTokens(std::string_view text) const;
+
+    /**
+     * @brief Turn token ids back into text
+     * @param ids Token ids
+     * @return Concatenated token bytes; unknown ids are skipped
+     */
+    std::string decode(const std::vector<int>& ids) const;
+
+    /**
+     * @brief Set how many merged pieces the cache keeps
+     * @param entries Maximum entries; 0 disables the cache
+     */
+    void setCacheCapacity(size_t entries);
+
+    /**
+     * @brief Get merge cache statistics
+     * @return Snapshot of the counters
+     */
+    TokenizerStats getStats() const;
+
+    /**
+     * @brief Split text into pre-tokenization pieces
+     * @param text UTF-8 text
+     * @param onPiece Called with each piece, in order
+     */
+    template <typename PieceHandler>
+    static void splitPieces(std::string_view text, PieceHandler onPiece);
+
+private:
+    void loadFromSettings();
+
+    // Append the tokens of one piece to out, if given, and return how many there are
+    size_t tokenizePiece(std::string_view piece, std::vector<int>* out) const;
+    void mergePiece(std::string_view piece, std::vector<int>& out) const;
+    bool finishLoad(const std::unordered_map<std::string, int>& vocab,
+        const std::vector<std::pair<std::string, std::string>>& merges);
+
+    static size_t nextPiece(const char* begin, const char* end);
+
+    // Merge of (left id, right id) -> rank and resulting id
+    struct Merge {
+        int rank;
+        int id;
+    };
+    std::unordered_map<uint64_t, Merge> merges;
+    std::vector<std::string> tokenBytes;  // Raw bytes of each id
+    int byteTokens[256];                  // Id of each single byte
+    bool loaded;
+    std::string lastError;
+
+    // LRU cache of merged pieces
+    using CacheList = std::list<std::pair<std::string, std::vector<int>>>;
+    mutable std::mutex cacheMutex;
+    mutable CacheList cacheOrder;
+    mutable std::unordered_map<std::string_view, CacheList::iterator> cacheIndex;
+    std::atomic<size_t> cacheCapacity;
+    mutable std::atomic<size_t> cacheHits;
+    mutable std::atomic<size_t> cacheMisses;
+};
+
+template <typename PieceHandler>
+void BpeTokenizer::splitPieces(std::string_view text, PieceHandler onPiece) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        size_t length = nextPiece(p, end);
+        onPiece(std::string_view(p, length));
+        p += length;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @class CancellationToken
+ * @brief Shared flag that asks running work to stop
+ *
+ * Copies share one state, so a token handed to a request can be cancelled
+ * through any copy, from any thread. Work that can stop early registers a
+ * callback; callbacks run once, on the thread that calls cancel().
+ */
+class CancellationToken {
+public:
+    using CallbackId = uint64_t;
+
+    CancellationToken() : state(std::make_shared<State>()) {}
+
+    /**
+     * @brief Request cancellation and run the registered callbacks
+     *
+     * Only the first call has an effect.
+     */
+    void cancel() const {
+        std::vector<std::pair<CallbackId, std::function<void()>>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->cancelled.exchange(true)) {
+                return;
+            }
+            callbacks.swap(state->callbacks);
+        }
+
+        for (auto& callback : callbacks) {
+            callback.second();
+        }
+    }
+
+    bool isCancelled() const {
+        return state->cancelled.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Register a function to run on cancellation
+     * @param callback Function to run; runs immediately if already cancelled
+     * @return Id for removeCallback(), or 0 if it already ran
+     */
+    CallbackId onCancel(std::function<void()> callback) const {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->cancelled.load()) {
+                CallbackId id = state->nextId++;
+                state->callbacks.emplace_back(id, std::move(callback));
+                return id;
+            }
+        }
+
+        callback();
+        return 0;
+    }
+
+    /**
+     * @brief Unregister a callback once the work it would stop has finished
+     * @param id Id returned by onCancel()
+     */
+    void removeCallback(CallbackId id) const {
+        if (id == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        auto& callbacks = state->callbacks;
+        for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+            if (it->first == id) {
+                callbacks.erase(it);
+                return;
+            }
+        }
+    }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{ false };
+        std::mutex mutex;
+        CallbackId nextId = 1;
+        std::vector<std::pair<CallbackId, std::function<void()>>> callbacks;
+    };
+
+    std::shared_ptr<State> state;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "include/utils/CancellationToken.h"
+#include <chrono>
+
+/**
+ * @struct CompletionOptions
+ * @brief Per-request switches for the chat completion functions
+ */
+struct CompletionOptions {
+    bool bypassCache = false;  // Always go to the network and do not store the reply
+    bool coalesce = true;      // Share the upstream call of an identical request in flight
+
+    // Cancelling aborts the request. A streaming call then completes with the
+    // text received so far, a non-streaming one with an error.
+    CancellationToken cancellation;
+
+    // Past this point the request is aborted as if cancelled
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
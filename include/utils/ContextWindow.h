@@ -0,0 +1,136 @@
+#pragma once
+
+#include "include/common/ConversationHistory.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief How a ContextWindow chooses which messages to send
+ */
+enum class ContextPolicy {
+    CP_KEEP_ALL,        // Send the whole conversation, ignoring the budget
+    CP_LAST_TURNS,      // Send system prompts, pinned messages and the last N turns
+    CP_SLIDING_WINDOW   // Send system prompts, pinned messages and as many recent messages as fit
+};
+
+/**
+ * @struct ContextStats
+ * @brief Token accounting of the requests a ContextWindow has prepared
+ */
+struct ContextStats {
+    size_t requests = 0;        // Requests prepared
+    size_t tokensSent = 0;      // Estimated prompt tokens actually sent
+    size_t tokensSaved = 0;     // Estimated tokens left out by trimming
+    size_t lastTokensSent = 0;  // Prompt tokens of the most recent request
+    size_t lastTokensSaved = 0; // Tokens saved on the most recent request
+    size_t lastDropped = 0;     // Messages left out of the most recent request
+};
+
+/**
+ * @class ContextWindow
+ * @brief Fits a conversation into a prompt token budget
+ *
+ * Keeps a token estimate for every message of one conversation. Estimates
+ * are computed once, the first time a message is seen, so preparing a
+ * request only counts the messages appended since the previous one.
+ * Messages with the "system" role and explicitly pinned messages are
+ * always sent; the newest message is always sent as well. A trimmed window
+ * of recent messages always starts at a user message.
+ */
+class ContextWindow {
+public:
+    /**
+     * @brief Estimates the number of prompt tokens a message costs
+     */
+    using TokenCounter = std::function<size_t(const Message& message)>;
+
+    /**
+     * @brief Tokens of role markers and separators the chat template adds per message
+     */
+    static constexpr size_t MESSAGE_OVERHEAD_TOKENS = 4;
+
+    ContextWindow();
+
+    /**
+     * @brief Read context_policy, context_budget and context_turns from ConfigManager
+     *
+     * context_policy is one of "all", "turns" or "window".
+     */
+    void loadSettings();
+
+    void setPolicy(ContextPolicy policy);
+    ContextPolicy getPolicy() const;
+
+    /**
+     * @brief Set the prompt token budget
+     * @param tokens Maximum estimated prompt tokens; 0 disables the limit
+     */
+    void setBudget(size_t tokens);
+    size_t getBudget() const;
+
+    /**
+     * @brief Set how many turns CP_LAST_TURNS keeps besides the new one
+     * @param turns Earlier turns to keep; a turn starts at a user message
+     */
+    void setMaxTurns(size_t turns);
+
+    /**
+     * @brief Replace the token estimator; existing estimates are recomputed
+     * @param counter Estimator, or an empty function for the default
+     */
+    void setTokenCounter(TokenCounter counter);
+
+    /**
+     * @brief Always send a message regardless of policy and budget
+     * @param index Position of the message in the conversation
+     */
+    void pin(size_t index);
+
+    /**
+     * @brief Forget the conversation, e.g. after its history was cleared
+     */
+    void clear();
+
+    /**
+     * @brief Choose the messages to send for the next request
+     * @param history Full conversation; its last message is the new turn
+     * @return The history itself if everything fits, otherwise a trimmed copy
+     */
+    ConversationHistory select(const ConversationHistory& history);
+
+    /**
+     * @brief Estimated tokens of the whole conversation seen so far
+     * @return Sum of all message estimates
+     */
+    size_t totalTokens() const;
+
+    /**
+     * @brief Get token accounting
+     * @return Copy of the statistics
+     */
+    ContextStats getStats() const;
+
+    /**
+     * @brief Default estimator: about four ASCII bytes or one other character per token
+     * @param message Message to estimate
+     * @return Estimated tokens, including per-message framing
+     */
+    static size_t estimateTokens(const Message& message);
+
+private:
+    void countNewMessages(const ConversationHistory& history);
+    bool isPinned(const ConversationHistory& history, size_t index) const;
+
+    ContextPolicy policy;
+    size_t budget;
+    size_t maxTurns;
+    TokenCounter counter;
+
+    std::vector<size_t> tokenCounts;  // Estimate of each message seen so far
+    size_t runningTotal;
+    std::vector<size_t> pinned;       // Sorted indexes of pinned messages
+
+    ContextStats stats;
+};
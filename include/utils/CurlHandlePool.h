@@ -0,0 +1,117 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * @struct CurlPoolStats
+ * @brief Snapshot of CurlHandlePool counters
+ */
+struct CurlPoolStats {
+    size_t hits;     // acquire() served from an idle handle
+    size_t misses;   // acquire() had to create a new handle
+    size_t idle;     // handles currently parked in the pool
+};
+
+/**
+ * @class CurlHandlePool
+ * @brief Thread-safe pool of reusable libcurl easy handles
+ *
+ * A released handle keeps its live connections, so the next request to the
+ * same host skips the TCP and TLS handshakes. Every handle is attached to a
+ * single CURLSH object that shares the DNS cache and TLS session cache
+ * across threads and chat sessions. The connection cache is not shared,
+ * since libcurl does not support that between concurrent threads; each
+ * handle keeps its own connections.
+ */
+class CurlHandlePool {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the CurlHandlePool instance
+     */
+    static CurlHandlePool& getInstance();
+
+    /**
+     * @brief Take a handle out of the pool, creating one if none is idle
+     * @return A handle reset to default options, or nullptr on failure
+     */
+    CURL* acquire();
+
+    /**
+     * @brief Return a handle to the pool
+     * @param handle Handle obtained from acquire()
+     */
+    void release(CURL* handle);
+
+    /**
+     * @brief Get pool hit/miss counters
+     * @return Current statistics
+     */
+    CurlPoolStats getStats() const;
+
+    /**
+     * @brief Set how many idle handles are kept; extra handles are cleaned up
+     * @param maxIdle Maximum number of idle handles
+     */
+    void setMaxIdle(size_t maxIdle);
+
+    /**
+     * @brief Clean up all idle handles and the share object
+     *
+     * Must be called before curl_global_cleanup().
+     */
+    void shutdown();
+
+private:
+    // Private constructor for singleton pattern
+    CurlHandlePool();
+    ~CurlHandlePool();
+
+    // Delete copy constructor and assignment operator
+    CurlHandlePool(const CurlHandlePool&) = delete;
+    CurlHandlePool& operator=(const CurlHandlePool&) = delete;
+
+    // Share lock callbacks
+    static void lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockShare(CURL* handle, curl_lock_data data, void* userptr);
+
+    // Apply the options every pooled handle carries
+    void prepareHandle(CURL* handle) const;
+
+    CURLSH* share;
+    std::mutex shareMutexes[CURL_LOCK_DATA_LAST];
+
+    std::vector<CURL*> idleHandles;
+    size_t maxIdleHandles;
+    mutable std::mutex poolMutex;
+
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+};
+
+/**
+ * @class PooledCurlHandle
+ * @brief RAII lease of a CurlHandlePool handle
+ */
+class PooledCurlHandle {
+public:
+    PooledCurlHandle() : handle(CurlHandlePool::getInstance().acquire()) {}
+    ~PooledCurlHandle() {
+        if (handle) {
+            CurlHandlePool::getInstance().release(handle);
+        }
+    }
+
+    PooledCurlHandle(const PooledCurlHandle&) = delete;
+    PooledCurlHandle& operator=(const PooledCurlHandle&) = delete;
+
+    CURL* get() const { return handle; }
+    explicit operator bool() const { return handle != nullptr; }
+
+private:
+    CURL* handle;
+};
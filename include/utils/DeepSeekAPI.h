@@ -6,7 +6,11 @@
 #include <QObject>
 #include <QString>
 #include <functional>
-#include "include/common/Message.h"
+#include <chrono>
+#include <mutex>
+#include "include/common/ConversationHistory.h"
+#include "include/utils/ContextWindow.h"
+#include "include/utils/CompletionOptions.h"
 
 // ȷstd::stringQtźŲϵͳʹ
 Q_DECLARE_METATYPE(std::string)
@@ -14,21 +18,74 @@ Q_DECLARE_METATYPE(std::string)
 // API
 std::string chatCompletion(
     const std::string& apiKey,
-    const std::vector<Message>& messages,
+    const ConversationHistory& messages,
     const std::string& model = "deepseek-chat",
     float temperature = 0.7,
-    int maxTokens = 1000
+    int maxTokens = 1000,
+    const CompletionOptions& options = CompletionOptions()
 );
 
 std::string streamingChatCompletion(
     const std::string& apiKey,
-    const std::vector<Message>& messages,
+    const ConversationHistory& messages,
     std::function<void(const std::string&)> callback,
     const std::string& model = "deepseek-chat",
     float temperature = 0.7,
-    int maxTokens = 1000
+    int maxTokens = 1000,
+    const CompletionOptions& options = CompletionOptions()
 );
 
+// Asynchronous variants: return immediately and call onComplete with the
+// final reply (or error text): on an Executor worker for chatCompletionAsync,
+// on the request engine thread, right after the last chunk, for the
+// streaming variant. A reply served from the ResponseCache is delivered
+// before the call returns. Cancelling
+// options.cancellation or passing options.deadline aborts the transfer; the
+// streaming variant then completes with the text received so far.
+void chatCompletionAsync(
+    const std::string& apiKey,
+    const ConversationHistory& messages,
+    std::function<void(const std::string&)> onComplete,
+    const std::string& model = "deepseek-chat",
+    float temperature = 0.7,
+    int maxTokens = 1000,
+    const CompletionOptions& options = CompletionOptions()
+);
+
+void streamingChatCompletionAsync(
+    const std::string& apiKey,
+    const ConversationHistory& messages,
+    std::function<void(const std::string&)> callback,
+    std::function<void(const std::string&)> onComplete,
+    const std::string& model = "deepseek-chat",
+    float temperature = 0.7,
+    int maxTokens = 1000,
+    const CompletionOptions& options = CompletionOptions()
+);
+
+// True if a reply of the functions above is an error message rather than
+// model output
+bool isErrorReply(const std::string& reply);
+
+// Send a request body built by the caller, e.g. one relayed from an
+// OpenAI-compatible client, with apiKey for authorization. The bytes of a
+// 2xx streaming response go to onData unparsed as they arrive (return false
+// to abort); onComplete then gets the HTTP status (0 on a transport error),
+// the body of a response that was not streamed, and the transport error.
+// Passes the rate limiter like every other completion.
+void forwardChatCompletionAsync(
+    const std::string& apiKey,
+    std::string body,
+    std::function<bool(const char* data, size_t size)> onData,
+    std::function<void(long statusCode, const std::string& body, const std::string& error)> onComplete,
+    const CompletionOptions& options = CompletionOptions()
+);
+
+// Open a connection to the API ahead of the first request, so that request
+// does not pay for the TCP and TLS handshakes. Sends an empty body, whose
+// error reply is ignored.
+void warmUpChatConnection(const std::string& apiKey);
+
 // Chat Session class to manage conversation with DeepSeek
 class ChatSession {
 public:
@@ -46,11 +103,28 @@ public:
     void clearHistory();
 
     // Make chat history accessible for GUI
-    const std::vector<Message>& getHistory() const;
+    const ConversationHistory& getHistory() const;
+
+    // Token budgeting applied to every request of this session
+    ContextWindow& getContextWindow();
+
+    // Abort the request in flight, from any thread. A streaming send returns
+    // the text received so far and keeps it in the history; any other
+    // cancelled turn is dropped from the history, prompt included.
+    void cancel();
+
+    // Time limit for each request, zero for none (setting request_timeout_seconds)
+    void setRequestTimeout(std::chrono::milliseconds timeout);
 
 private:
+    CompletionOptions beginRequest();
+
     std::string apiKey;
-    std::vector<Message> history;
+    ConversationHistory history;
+    ContextWindow context;
+    std::mutex requestMutex;
+    CancellationToken activeRequest;
+    std::chrono::milliseconds requestTimeout;
     std::string model = "deepseek-chat"; // Updated model name
 };
 
@@ -62,7 +136,10 @@ public:
     ~DeepSeekAPI();
 
     // ϢAPI
-    void sendMessage(const std::string& message, const std::vector<Message>& history);
+    void sendMessage(const std::string& message, const ConversationHistory& history);
+
+    // Abandon every request in flight; their replies are never emitted
+    void cancelPending();
 
 signals:
     // Ӧź - ʹQStringstd::stringת
@@ -70,6 +147,8 @@ signals:
 
 private:
     std::string apiKey;
+    CancellationToken pending;
+    std::chrono::milliseconds requestTimeout;
     bool getApiKey();
-    std::string sendRequest(const std::string& message, const std::vector<Message>& history);
+    void sendRequest(const std::string& message, const ConversationHistory& history);
 };
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * @struct StreamDelta
+ * @brief Fields of one streamed chat completion chunk
+ */
+struct StreamDelta {
+    bool hasContent = false;       // choices[0].delta.content was a string
+    std::string content;           // Unescaped content delta
+    bool hasFinishReason = false;  // choices[0].finish_reason was a string
+    std::string finishReason;      // e.g. "stop", "length"
+    bool hasUsage = false;         // usage object present (last chunk)
+    long long promptTokens = 0;
+    long long completionTokens = 0;
+    long long totalTokens = 0;
+
+    void clear() {
+        hasContent = false;
+        content.clear();
+        hasFinishReason = false;
+        finishReason.clear();
+        hasUsage = false;
+        promptTokens = completionTokens = totalTokens = 0;
+    }
+};
+
+/**
+ * @class DeltaExtractor
+ * @brief Reads streamed completion chunks without building a JSON DOM
+ *
+ * A single forward scan over the SSE payload pulls out
+ * choices[0].delta.content, choices[0].finish_reason and usage, skipping
+ * everything else in place. Payloads whose shape the scanner does not
+ * expect are handed to nlohmann::json instead.
+ */
+class DeltaExtractor {
+public:
+    /**
+     * @brief Extract the delta fields of one event payload
+     * @param payload JSON text of one SSE data event
+     * @param delta Output; cleared first, its buffers are reused
+     * @return false if the payload is not a JSON object
+     */
+    static bool extract(std::string_view payload, StreamDelta& delta);
+
+    /**
+     * @brief Fast path only: scan without falling back to nlohmann::json
+     * @param payload JSON text of one SSE data event
+     * @param delta Output; cleared first
+     * @return false if the payload has an unexpected shape
+     */
+    static bool scan(std::string_view payload, StreamDelta& delta);
+
+    /**
+     * @brief Slow path only: extract through a full nlohmann::json DOM
+     * @param payload JSON text of one SSE data event
+     * @param delta Output; cleared first
+     * @return false if the payload is not a JSON object
+     */
+    static bool extractWithDom(std::string_view payload, StreamDelta& delta);
+};
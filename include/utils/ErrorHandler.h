@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
-#include <mutex>
 
 // ʹö࣬Ƴͻ
 enum class ErrorLevel {
@@ -21,6 +26,8 @@ struct ErrorRecord {
 };
 
 // 
+// Keeps the last error_history_capacity records (default 256) in a ring;
+// console output and the optional error_log_file go through AsyncLogger
 class ErrorHandler {
 public:
     // ȡʵ
@@ -42,11 +49,17 @@ public:
     void logFatal(const std::string& message, const std::string& context = "");
 
     // ȡĴ¼
-    const ErrorRecord* getLastError() const;
+    std::optional<ErrorRecord> getLastError() const;
 
     // ȡд¼
     std::vector<ErrorRecord> getAllErrors() const;
 
+    // Visit the retained records, oldest first, without copying them
+    void forEachError(const std::function<void(const ErrorRecord&)>& visit) const;
+
+    // Records logged at a level since start; clearErrors() leaves these alone
+    uint64_t getErrorCount(ErrorLevel level) const;
+
     // д¼
     void clearErrors();
 
@@ -57,11 +70,23 @@ private:
     ErrorHandler(const ErrorHandler&) = delete;
     ErrorHandler& operator=(const ErrorHandler&) = delete;
 
-    // ¼б
-    std::vector<ErrorRecord> errorRecords;
-
-    // ̰߳ȫ
-    mutable std::mutex errorMutex;
+    // A record and its position in the log, which says which lap of the ring it is from
+    struct HistoryEntry {
+        uint64_t sequence;
+        ErrorRecord record;
+    };
+
+    // Most recent records. Slots are read and replaced with the atomic
+    // shared_ptr functions, so readers never block loggers and a record
+    // stays valid while a reader holds it
+    std::unique_ptr<std::shared_ptr<const HistoryEntry>[]> history;
+    size_t historyCapacity;
+    std::atomic<uint64_t> nextSequence;
+    std::atomic<uint64_t> clearedBefore;  // Records before this sequence were cleared
+    std::atomic<uint64_t> levelCounts[4];
+
+    // Retained entries in log order
+    std::vector<std::shared_ptr<const HistoryEntry>> snapshot() const;
 
     // ȡǰʱ
     std::string getCurrentTimestamp() const;
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @enum TaskPriority
+ * @brief Order in which queued Executor tasks are picked
+ */
+enum class TaskPriority {
+    TP_HIGH,    // Someone is waiting for the result, e.g. a reply to parse
+    TP_NORMAL,
+    TP_LOW      // Housekeeping such as cache writes
+};
+
+/**
+ * @struct ExecutorStats
+ * @brief Snapshot of an Executor
+ */
+struct ExecutorStats {
+    size_t workers;
+    size_t queued;         // Tasks waiting, over all workers
+    size_t maxQueueDepth;  // Tasks waiting on the busiest worker
+    size_t active;         // Tasks running now
+    size_t executed;       // Tasks run since start
+    size_t stolen;         // Tasks run by a worker other than the one they were queued on
+};
+
+/**
+ * @class Executor
+ * @brief Work-stealing thread pool for blocking and CPU-bound work
+ *
+ * Each worker owns one deque per priority. A task submitted from a worker
+ * goes to that worker's deque; others are spread over the workers in turn.
+ * A worker runs its own tasks in submission order and, when it has none of
+ * a priority, steals the newest task of that priority from another worker
+ * before it looks at lower priorities. Idle workers sleep until a task is
+ * submitted.
+ *
+ * The RequestEngine thread only drives transfers; parsing replies, cache
+ * writes and speech synthesis run here instead.
+ *
+ * Settings: executor_threads (default 0, one per hardware thread, at least 2).
+ */
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the Executor instance
+     */
+    static Executor& getInstance();
+
+    /**
+     * @brief Queue a task; runs it right away once the pool is shut down
+     * @param task Task to run; exceptions it throws are logged
+     * @param priority Priority of the task
+     */
+    void submit(Task task, TaskPriority priority = TaskPriority::TP_NORMAL);
+
+    /**
+     * @brief Check if the calling thread is one of the workers
+     * @return true on a worker thread
+     */
+    bool isWorkerThread() const;
+
+    size_t getWorkerCount() const;
+
+    /**
+     * @brief Get queue depths and counters
+     * @return Snapshot of the pool
+     */
+    ExecutorStats getStats() const;
+
+    /**
+     * @brief Run every queued task, then stop the workers
+     *
+     * Tasks submitted from then on run on the submitting thread.
+     */
+    void shutdown();
+
+private:
+    Executor();
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    static const size_t PRIORITY_COUNT = 3;
+
+    struct Worker {
+        std::mutex mutex;
+        std::array<std::deque<Task>, PRIORITY_COUNT> queues;
+        std::array<std::atomic<size_t>, PRIORITY_COUNT> depths{};  // Sizes of queues, read without the lock
+        std::thread thread;
+    };
+
+    void workerLoop(size_t index);
+    bool takeTask(size_t index, Task& task);
+    void runTask(Task& task);
+    void runLeftovers();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // A worker goes to sleep only after it saw pending at 0 with sleeping
+    // raised; a submit wakes a worker if it sees sleeping above 0
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> sleeping;
+    std::atomic<size_t> pending;
+    bool stopping;
+    std::atomic<bool> stopped;
+
+    std::mutex shutdownMutex;
+    std::atomic<size_t> nextWorker;
+    std::atomic<size_t> active;
+    std::atomic<size_t> executed;
+    std::atomic<size_t> stolen;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * @class JsonWriter
+ * @brief Appends JSON tokens straight into an output buffer
+ *
+ * Output is byte-for-byte identical to what nlohmann::json::dump() produces
+ * for the same values, so request bodies can be written without building
+ * an intermediate DOM.
+ */
+class JsonWriter {
+public:
+    /**
+     * @brief Append a quoted, escaped JSON string
+     * @param out Output buffer
+     * @param value UTF-8 text
+     * @throws nlohmann::json::type_error if value is not valid UTF-8, as dump() does
+     */
+    static void appendString(std::string& out, std::string_view value);
+
+    /**
+     * @brief Append an integer
+     * @param out Output buffer
+     * @param value Integer value
+     */
+    static void appendInt(std::string& out, long long value);
+
+    /**
+     * @brief Append true or false
+     * @param out Output buffer
+     * @param value Boolean value
+     */
+    static void appendBool(std::string& out, bool value);
+
+    /**
+     * @brief Append a float the way a json number built from it is dumped
+     * @param out Output buffer
+     * @param value Float value
+     */
+    static void appendFloat(std::string& out, float value);
+
+    /**
+     * @brief Typical number of bytes appendString() writes, for reserve()
+     * @param value UTF-8 text
+     * @return Size estimate including quotes and a margin for escapes
+     */
+    static size_t estimateStringSize(std::string_view value) { return value.size() + 2 + value.size() / 8; }
+};
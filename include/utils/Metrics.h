@@ -0,0 +1,181 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @class MetricCounter
+ * @brief Monotonic counter, split into shards so threads rarely share a cache line
+ */
+class MetricCounter {
+public:
+    static const size_t SHARDS = 8;
+
+    /**
+     * @brief Add to the shard of the calling thread
+     * @param amount Amount to add
+     */
+    void add(uint64_t amount = 1);
+
+    /**
+     * @brief Sum the shards
+     * @return Current value
+     */
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{ 0 };
+    };
+    std::array<Shard, SHARDS> shards;
+};
+
+/**
+ * @class MetricHistogram
+ * @brief Log-linear histogram in the style of HdrHistogram
+ *
+ * Values are counted in whole units (e.g. microseconds) into buckets that
+ * split every power of two into 8, so a bucket is at most 12.5% wide
+ * whatever the magnitude, from 1 unit to 2^40. Exposition re-buckets them
+ * onto the bounds given at registration. Recording is a few relaxed
+ * atomic adds on the calling thread's shard.
+ */
+class MetricHistogram {
+public:
+    /**
+     * @param unit Size of one counted unit, in the exposed unit (1e-6 for microseconds of seconds)
+     * @param bounds Upper bounds of the exposed buckets, ascending, in the exposed unit
+     */
+    MetricHistogram(double unit, std::vector<double> bounds);
+
+    /**
+     * @brief Record a value
+     * @param value Value in the exposed unit, e.g. seconds
+     */
+    void observe(double value);
+
+    /**
+     * @brief Append the _bucket, _sum and _count samples
+     * @param out Text to append to
+     * @param name Metric name
+     * @param labels Label pairs without braces, e.g. kind="stream"; may be empty
+     */
+    void render(std::string& out, const std::string& name, const std::string& labels) const;
+
+private:
+    static const size_t SUB_BUCKET_BITS = 3;
+    static const size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static const size_t MAX_MAGNITUDE = 40;
+    static const size_t BUCKETS = SUB_BUCKETS + (MAX_MAGNITUDE - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucketOf(uint64_t units);
+    static uint64_t bucketEnd(size_t bucket);  // Smallest value of the next bucket
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+        std::atomic<uint64_t> sum{ 0 };  // In units
+    };
+
+    double unit;
+    std::vector<double> bounds;
+    std::unique_ptr<Shard[]> shards;
+};
+
+/**
+ * @class Metrics
+ * @brief Registry of counters and histograms, rendered in the Prometheus text format
+ *
+ * Instruments are registered once, usually into a function-local static,
+ * and live as long as the process. A metric family may have several label
+ * sets; registering the same name and labels again returns the existing
+ * instrument. Values kept elsewhere (queue depths, cache counters) are
+ * added at render time by collectors.
+ */
+class Metrics {
+public:
+    // Appends complete families, e.g. with appendGauge()
+    using Collector = std::function<void(std::string& out)>;
+
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the Metrics instance
+     */
+    static Metrics& getInstance();
+
+    /**
+     * @brief Register a counter, or find the one registered before
+     * @param name Metric name, ending in _total
+     * @param help One-line description
+     * @param labels Label pairs without braces; may be empty
+     * @return Counter that lives as long as the process
+     */
+    MetricCounter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    /**
+     * @brief Register a histogram, or find the one registered before
+     * @param name Metric name, ending in the unit, e.g. _seconds
+     * @param help One-line description
+     * @param unit Resolution in the exposed unit, see MetricHistogram
+     * @param bounds Upper bounds of the exposed buckets
+     * @param labels Label pairs without braces; may be empty
+     * @return Histogram that lives as long as the process
+     */
+    MetricHistogram& histogram(const std::string& name, const std::string& help, double unit,
+        const std::vector<double>& bounds, const std::string& labels = "");
+
+    /**
+     * @brief Register a collector called on every render
+     * @param collector Function appending families; must not call back into the registry
+     */
+    void addCollector(Collector collector);
+
+    /**
+     * @brief Render everything in the Prometheus text exposition format
+     * @return Text for a /metrics response
+     */
+    std::string renderText() const;
+
+    /**
+     * @brief Bounds for latencies in seconds, from 1 ms to 60 s
+     * @return Bucket bounds
+     */
+    static const std::vector<double>& latencyBounds();
+
+    // Helpers for collectors; type is "gauge", "counter" or "histogram"
+    static void appendHeader(std::string& out, const std::string& name, const std::string& help, const char* type);
+    static void appendGauge(std::string& out, const std::string& name, const std::string& help, double value);
+    static void appendCounter(std::string& out, const std::string& name, const std::string& help, double value);
+    static void appendSample(std::string& out, const std::string& name, const std::string& labels, double value);
+
+    // Histogram samples from per-bucket counts; counts has one more entry
+    // than bounds, for values above the last bound
+    static void appendBuckets(std::string& out, const std::string& name, const std::string& labels,
+        const std::vector<double>& bounds, const std::vector<size_t>& counts, double sum);
+
+private:
+    Metrics() = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    struct Family {
+        std::string name;
+        std::string help;
+        bool isHistogram;
+        std::vector<std::pair<std::string, std::unique_ptr<MetricCounter>>> counters;      // By labels
+        std::vector<std::pair<std::string, std::unique_ptr<MetricHistogram>>> histograms;  // By labels
+    };
+
+    Family& family(const std::string& name, const std::string& help, bool isHistogram);
+
+    mutable std::mutex mutex;
+    std::deque<Family> families;  // In registration order
+    std::vector<Collector> collectors;
+};
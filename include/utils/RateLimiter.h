@@ -0,0 +1,169 @@
+#pragma once
+
+#include "include/utils/RequestEngine.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+/**
+ * @struct RateLimiterStats
+ * @brief Snapshot of a RateLimiter
+ */
+struct RateLimiterStats {
+    double concurrencyLimit;  // Current AIMD limit
+    size_t inFlight;
+    size_t queued;            // Waiting for a slot, a token or a backoff
+    size_t throttled;         // 429/503 responses seen
+    size_t retries;
+    size_t exhausted;         // Requests that ran out of retries
+    double requestsPerSecond; // Current token bucket rate, 0 if unlimited
+};
+
+/**
+ * @class RateLimiter
+ * @brief Client-side pacing of API requests
+ *
+ * Requests pass a token bucket and an AIMD concurrency limit before they are
+ * sent. A success raises the limit by about one per round trip, but only
+ * while the limit is what holds requests back, and more slowly near the
+ * level of the last throttle. A 429 or 503 scales the limit down, at most
+ * once per cooldown of one smoothed latency. Each slow-down reacts to
+ * overload once, so the limit settles just under what the API sustains
+ * instead of swinging between extremes.
+ *
+ * Throttled requests are retried with full-jitter exponential backoff, never
+ * sooner than Retry-After, which also pauses the whole queue. When the API
+ * reports x-ratelimit-remaining-requests and x-ratelimit-reset-requests, the
+ * bucket spreads the remaining quota over the reset window.
+ *
+ * A hedge sent by RequestHedger takes a token and a concurrency slot like
+ * any other request. It is only sent when both are free, nothing is queued,
+ * and the limiter is neither paused nor cooling down after a throttle.
+ *
+ * When the RequestEngine shuts down, jobs still queued or in backoff fail
+ * with "Request engine shut down", and later requests bypass the limiter.
+ *
+ * Settings: rate_limit_enabled (default 1), rate_limit_rps (0 = no fixed
+ * cap), rate_limit_burst, concurrency_initial, concurrency_max,
+ * retry_max, retry_base_ms, retry_max_ms.
+ */
+class RateLimiter {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the RateLimiter instance
+     */
+    static RateLimiter& getInstance();
+
+    /**
+     * @brief Queue a request behind the limits
+     *
+     * Cancellation and the deadline of the request also apply while it waits.
+     * @param request Request to send
+     * @param onComplete Called on the engine thread with the final response
+     */
+    void submit(HttpRequest request, RequestEngine::Completion onComplete);
+
+    /**
+     * @brief Claim a token and a concurrency slot for a hedge
+     *
+     * Queued requests come first, so this never waits: with no room to
+     * spare the hedge is not worth sending.
+     * @param counted Set when a slot was taken and must be given back
+     * @return true if the hedge may be sent
+     */
+    bool tryAcquireHedge(bool& counted);
+
+    /**
+     * @brief Give back the slot of a hedge that has finished
+     */
+    void releaseHedge();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Get the current limits and counters
+     * @return Snapshot of the limiter
+     */
+    RateLimiterStats getStats() const;
+
+private:
+    RateLimiter();
+    ~RateLimiter();
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        uint64_t id;
+        HttpRequest request;
+        RequestEngine::Completion onComplete;
+        int attempts = 0;
+        Clock::time_point sentAt;
+        CancellationToken::CallbackId cancelCallback = 0;
+    };
+
+    void pump();
+    void dispatch(const std::shared_ptr<Job>& job);
+    void onResponse(const std::shared_ptr<Job>& job, HttpResponse response);
+    void requeue(const std::shared_ptr<Job>& job);
+    void abandon(uint64_t id, bool timedOut);
+    void finish(const std::shared_ptr<Job>& job, HttpResponse response);
+    void failWaiting();  // Engine shutdown hook
+
+    // Called with mutex held
+    bool takeToken(Clock::time_point now, Clock::duration& wait);
+    void increaseLimit();
+    void decreaseLimit(Clock::time_point now);
+    void applyRateHeaders(const HttpResponse& response, Clock::time_point now);
+    std::chrono::milliseconds backoff(int attempt, std::chrono::milliseconds retryAfter);
+    void schedulePump(Clock::time_point at);
+
+    mutable std::mutex mutex;
+    bool enabled;
+
+    // Waiting jobs: ready ones in FIFO order, plus those in backoff
+    std::deque<std::shared_ptr<Job>> ready;
+    std::unordered_map<uint64_t, std::shared_ptr<Job>> waiting;
+    uint64_t nextJobId;
+    size_t inFlight;
+    bool pumpScheduled;
+    Clock::time_point pumpAt;
+    Clock::time_point pausedUntil;
+
+    // Token bucket; rate 0 means unlimited
+    double configuredRate;
+    double configuredBurst;
+    double rate;
+    double burst;
+    double tokens;
+    Clock::time_point refilledAt;
+    Clock::time_point quotaResetAt;
+
+    // AIMD concurrency
+    double limit;
+    double minLimit;
+    double maxLimit;
+    double lastThrottleLimit;
+    Clock::time_point cooldownUntil;
+    double smoothedLatencyMs;
+
+    // Retries
+    int maxRetries;
+    std::chrono::milliseconds retryBase;
+    std::chrono::milliseconds retryCap;
+    std::mt19937_64 random;
+
+    size_t throttled;
+    size_t retries;
+    size_t exhausted;
+
+    RequestEngine::HookId shutdownHook;
+};
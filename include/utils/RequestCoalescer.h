@@ -0,0 +1,132 @@
+#pragma once
+
+#include "include/utils/ResponseCache.h"
+#include "include/utils/CancellationToken.h"
+#include "include/utils/RequestEngine.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @struct FlightKey
+ * @brief Identity of an upstream completion request
+ */
+struct FlightKey {
+    CacheKey request;    // Model, sampling parameters and messages
+    std::string apiKey;  // Requests billed to different keys are never shared
+    bool stream = false;
+
+    bool operator==(const FlightKey& other) const {
+        return request == other.request && stream == other.stream && apiKey == other.apiKey;
+    }
+};
+
+/**
+ * @struct CoalescerStats
+ * @brief Counters of a RequestCoalescer
+ */
+struct CoalescerStats {
+    size_t flights;      // Upstream calls made
+    size_t savedCalls;   // Requests served by joining a call already in flight
+    size_t inFlight;     // Calls currently running
+};
+
+/**
+ * @class RequestCoalescer
+ * @brief Singleflight for identical concurrent completion requests
+ *
+ * The first request for a key becomes the leader and makes the upstream
+ * call; identical requests arriving while it runs join it as waiters
+ * instead. Streamed chunks fan out to every waiter, and a waiter joining
+ * mid-stream first receives everything streamed so far as one chunk.
+ * Chunks are delivered under a per-flight lock, so callbacks must not
+ * block; completions run without it.
+ *
+ * A waiter that is cancelled or reaches its deadline leaves the flight on its
+ * own, with the text streamed so far; the upstream call is only cancelled
+ * when no waiters are left. When the RequestEngine shuts down, every waiter
+ * is completed the same way and later waiters leave without its timers.
+ */
+class RequestCoalescer {
+public:
+    using ChunkCallback = std::function<void(const std::string& chunk)>;
+    using Completion = std::function<void(const std::string& reply)>;
+
+    class Flight;
+
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the RequestCoalescer instance
+     */
+    static RequestCoalescer& getInstance();
+
+    /**
+     * @brief Join an identical request in flight, or start a new flight
+     * @param key Request identity
+     * @param onChunk Streaming callback, may be empty
+     * @param onComplete Called once with the final reply
+     * @param cancellation Token that makes this waiter leave
+     * @param deadline Point at which this waiter leaves
+     * @return The new flight if the caller is the leader and must make the
+     *         upstream call, or null if it joined an existing one
+     */
+    std::shared_ptr<Flight> join(const FlightKey& key, ChunkCallback onChunk, Completion onComplete,
+        const CancellationToken& cancellation = CancellationToken(),
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    /**
+     * @brief Get the token that aborts a flight's upstream call
+     * @param flight Flight returned by join()
+     * @return Token cancelled once every waiter has left
+     */
+    CancellationToken upstreamCancellation(const std::shared_ptr<Flight>& flight) const;
+
+    /**
+     * @brief Fan a streamed chunk out to every waiter of a flight
+     * @param flight Flight returned by join()
+     * @param chunk Content delta
+     */
+    void publish(const std::shared_ptr<Flight>& flight, const std::string& chunk);
+
+    /**
+     * @brief Complete a flight and deliver the reply to every waiter
+     * @param flight Flight returned by join()
+     * @param reply Final reply or error text
+     */
+    void finish(const std::shared_ptr<Flight>& flight, const std::string& reply);
+
+    /**
+     * @brief Get flight counters
+     * @return Snapshot of the counters
+     */
+    CoalescerStats getStats() const;
+
+private:
+    RequestCoalescer();
+    ~RequestCoalescer();
+    RequestCoalescer(const RequestCoalescer&) = delete;
+    RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+
+    void leave(const std::shared_ptr<Flight>& flight, uint64_t waiterId, bool timedOut);
+    void abandonAll();  // Engine shutdown hook
+
+    struct FlightKeyHash {
+        size_t operator()(const FlightKey& key) const {
+            return static_cast<size_t>(key.request.high) ^ (key.stream ? 1 : 0);
+        }
+    };
+
+    mutable std::mutex flightsMutex;
+    std::unordered_map<FlightKey, std::shared_ptr<Flight>, FlightKeyHash> flights;
+
+    std::atomic<size_t> flightCount;
+    std::atomic<size_t> savedCalls;
+
+    std::atomic<bool> engineStopped;  // Leaving can no longer be deferred to the engine thread
+    RequestEngine::HookId shutdownHook;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "include/utils/CancellationToken.h"
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct HttpRequest
+ * @brief A single HTTP POST handed to the RequestEngine
+ */
+struct HttpRequest {
+    std::string url;
+    std::vector<std::string> headers;
+    std::string body;
+
+    // Optional streaming sink, called on the engine thread for every chunk of
+    // a 2xx response. Return false to abort the transfer. Other responses
+    // are collected in HttpResponse::body as usual.
+    std::function<bool(const char* data, size_t size)> onData;
+
+    // Never share a connection with another transfer in flight. Multiplexing
+    // is off for such a transfer, so it gets an idle pooled or new connection.
+    bool ownConnection = false;
+
+    // Cancelling the token aborts the transfer, as does passing the deadline
+    CancellationToken cancellation;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+/**
+ * @struct HttpResponse
+ * @brief Outcome of an HttpRequest
+ */
+struct HttpResponse {
+    CURLcode result = CURLE_OK;  // Transport result
+    long statusCode = 0;         // HTTP status, 0 if no response
+    std::string body;            // Response body (unless streamed through onData)
+    std::string error;           // Transport error text when result != CURLE_OK
+    bool cancelled = false;      // Stopped by cancel(), the request's token or its deadline
+
+    // Headers of the final response, names lowercased
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    /**
+     * @brief Look a header up
+     * @param name Lowercase header name
+     * @return Header value, or an empty string if absent
+     */
+    std::string header(const std::string& name) const {
+        for (const auto& entry : headers) {
+            if (entry.first == name) {
+                return entry.second;
+            }
+        }
+        return std::string();
+    }
+};
+
+/**
+ * @class RequestEngine
+ * @brief Event-loop HTTP client driving many transfers from one thread
+ *
+ * Transfers run on a curl multi handle driven by curl_multi_socket_action.
+ * On Linux the loop waits on epoll; elsewhere it falls back to
+ * curl_multi_poll. Completion callbacks run on the engine thread and must
+ * not block.
+ */
+class RequestEngine {
+public:
+    using Completion = std::function<void(HttpResponse)>;
+    using TransferId = uint64_t;
+    using HookId = uint64_t;
+
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the RequestEngine instance
+     */
+    static RequestEngine& getInstance();
+
+    /**
+     * @brief Start a transfer and return immediately
+     * @param request Request to send
+     * @param onComplete Called on the engine thread when the transfer ends
+     * @return Id for cancel()
+     */
+    TransferId submit(HttpRequest request, Completion onComplete);
+
+    /**
+     * @brief Start a transfer and return a future for its response
+     * @param request Request to send
+     * @return Future resolved when the transfer ends
+     */
+    std::future<HttpResponse> submit(HttpRequest request);
+
+    /**
+     * @brief Abort a transfer
+     *
+     * Takes effect on the next loop iteration; the completion still runs,
+     * with CURLE_ABORTED_BY_CALLBACK. Unknown or finished ids are ignored.
+     * Safe to call from any thread, including engine callbacks.
+     * @param id Id returned by submit()
+     */
+    void cancel(TransferId id);
+
+    /**
+     * @brief Run a function on the engine thread after a delay
+     *
+     * Timers still pending at shutdown are dropped.
+     * @param delay Time to wait
+     * @param task Function to run; must not block
+     */
+    void schedule(std::chrono::milliseconds delay, std::function<void()> task);
+
+    /**
+     * @brief Run a function once the engine shuts down
+     *
+     * Hooks run on the thread calling shutdown(), after unfinished transfers
+     * have failed. Components that wait on schedule() timers use them to
+     * fail whatever is still waiting, since those timers never fire.
+     * @param hook Function to run; runs right away if the engine already shut down
+     * @return Id for removeShutdownHook(), or 0 if it already ran
+     */
+    HookId onShutdown(std::function<void()> hook);
+
+    /**
+     * @brief Forget a hook that has not run yet
+     * @param id Id returned by onShutdown()
+     */
+    void removeShutdownHook(HookId id);
+
+    /**
+     * @brief Get the number of transfers queued or in flight
+     * @return Active transfer count
+     */
+    size_t activeTransfers() const;
+
+    /**
+     * @brief Stop the event loop, failing any unfinished transfers, then run the shutdown hooks
+     *
+     * Must be called before curl_global_cleanup().
+     */
+    void shutdown();
+
+private:
+    struct Transfer;
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        std::function<void()> task;
+
+        // Earliest deadline on top of the heap
+        bool operator<(const Timer& other) const { return deadline > other.deadline; }
+    };
+
+    // Private constructor for singleton pattern
+    RequestEngine();
+    ~RequestEngine();
+
+    // Delete copy constructor and assignment operator
+    RequestEngine(const RequestEngine&) = delete;
+    RequestEngine& operator=(const RequestEngine&) = delete;
+
+    // Event loop
+    void ensureStarted();
+    void stopLoop();
+    void run();
+    void wakeUp();
+    void addPendingTransfers();
+    void processCompletedTransfers();
+    void processCancellations();
+    void runDueTimers();
+    void finishTransfer(CURL* easy, CURLcode result);
+    void deliver(std::unique_ptr<Transfer> transfer);
+    int loopTimeoutMs() const;
+
+    // libcurl callbacks
+    static int socketCallback(CURL* easy, curl_socket_t socket, int what, void* userp, void* socketp);
+    static int timerCallback(CURLM* multi, long timeoutMs, void* userp);
+    static size_t writeCallback(char* data, size_t size, size_t nmemb, void* userp);
+    static size_t headerCallback(char* data, size_t size, size_t nmemb, void* userp);
+
+    CURLM* multi;
+    std::thread loopThread;
+    std::atomic<bool> running;
+    bool stopped;
+    std::mutex startMutex;
+    std::vector<std::pair<HookId, std::function<void()>>> shutdownHooks;  // Guarded by startMutex
+    HookId nextHookId;
+
+    // Transfers submitted by other threads, picked up by the loop
+    std::deque<std::unique_ptr<Transfer>> pending;
+    std::vector<TransferId> cancelled;
+    mutable std::mutex pendingMutex;
+    std::atomic<TransferId> nextId;
+
+    std::vector<Timer> timers;  // Heap ordered by deadline
+    mutable std::mutex timersMutex;
+
+    // Loop-thread state
+    std::unordered_map<CURL*, std::unique_ptr<Transfer>> inFlight;
+    bool timerArmed;
+    std::chrono::steady_clock::time_point timerDeadline;
+    std::atomic<size_t> activeCount;
+
+#ifdef __linux__
+    int epollFd;
+    int wakeFd;
+#endif
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "include/utils/RequestEngine.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @struct HedgeStats
+ * @brief Counters of a RequestHedger
+ */
+struct HedgeStats {
+    size_t requests;         // Requests submitted while hedging was enabled
+    size_t hedged;           // Requests that sent a duplicate; hedge rate is hedged / requests
+    size_t hedgeWins;        // Duplicates that answered first
+    size_t hedgesSkipped;    // Duplicates not sent because the rate limiter had no room
+    double latencySavedMs;   // Estimated total over hedge wins
+    long long firstByteDelayMs;  // Current hedge delay for streaming requests
+    long long responseDelayMs;   // Current hedge delay for whole responses
+};
+
+/**
+ * @class RequestHedger
+ * @brief Sends a duplicate of a slow request and keeps whichever answers first
+ *
+ * If a request has not produced its first byte (streaming) or its response
+ * (otherwise) within a delay taken from a percentile of recent latencies, a
+ * copy goes out on a separate connection. The first attempt to answer wins
+ * and the other is cancelled; a failed attempt only counts once the other
+ * one has failed too. The copy goes through RateLimiter::tryAcquireHedge()
+ * and is skipped when the limiter has no room for it.
+ *
+ * Latency saved by a hedge win is estimated from the recorded latencies as
+ * the expected remaining time of the primary, given it had not answered yet.
+ *
+ * Settings: hedge_enabled (default 0), hedge_percentile (default 95),
+ * hedge_min_delay_ms, hedge_initial_delay_ms (used until hedge_min_samples
+ * latencies have been recorded).
+ */
+class RequestHedger {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the RequestHedger instance
+     */
+    static RequestHedger& getInstance();
+
+    /**
+     * @brief Submit a request, hedging it when enabled
+     *
+     * Behaves like RequestEngine::submit(); with hedging disabled it is a
+     * plain pass-through. Callbacks run on the engine thread.
+     * @param request Request to send
+     * @param onComplete Called once with the winning (or last failed) response
+     */
+    void submit(HttpRequest request, RequestEngine::Completion onComplete);
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Get hedging counters and the current delays
+     * @return Snapshot of the counters
+     */
+    HedgeStats getStats() const;
+
+private:
+    RequestHedger();
+    RequestHedger(const RequestHedger&) = delete;
+    RequestHedger& operator=(const RequestHedger&) = delete;
+
+    struct HedgedCall;
+
+    /**
+     * @brief Ring of recent latencies
+     */
+    class LatencyWindow {
+    public:
+        explicit LatencyWindow(size_t capacity);
+
+        // complete is false for a cancelled primary, whose latency is only a lower bound
+        void record(double ms, bool complete = true);
+        size_t size() const;
+        double percentile(double p) const;
+
+        // Mean of the complete samples above elapsedMs, or elapsedMs if there are none
+        double expectedGiven(double elapsedMs) const;
+
+    private:
+        struct Sample {
+            double ms;
+            bool complete;
+        };
+
+        mutable std::mutex mutex;
+        std::vector<Sample> samples;
+        size_t next;
+        size_t capacity;
+    };
+
+    std::chrono::milliseconds delayFor(const LatencyWindow& window) const;
+    void launchHedge(const std::shared_ptr<HedgedCall>& call);
+    bool onAttemptData(const std::shared_ptr<HedgedCall>& call, int attempt, const char* data, size_t size);
+    void onAttemptComplete(const std::shared_ptr<HedgedCall>& call, int attempt, HttpResponse response);
+    void declareWinner(HedgedCall& call, int attempt);
+
+    std::atomic<bool> enabled;
+    double percentile;
+    std::chrono::milliseconds minDelay;
+    std::chrono::milliseconds initialDelay;
+    size_t minSamples;
+
+    LatencyWindow firstByteLatency;
+    LatencyWindow responseLatency;
+
+    std::atomic<size_t> requests;
+    std::atomic<size_t> hedged;
+    std::atomic<size_t> hedgeWins;
+    std::atomic<size_t> hedgesSkipped;
+    std::atomic<long long> latencySavedUs;
+};
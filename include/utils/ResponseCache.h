@@ -0,0 +1,147 @@
+#pragma once
+
+#include "include/common/ConversationHistory.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @struct CacheKey
+ * @brief 128-bit hash of everything that determines a completion
+ *
+ * Two independently seeded 64-bit lanes: one selects the bucket, the other
+ * verifies the match, so a false hit needs a full 128-bit collision.
+ */
+struct CacheKey {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator==(const CacheKey& other) const { return high == other.high && low == other.low; }
+};
+
+/**
+ * @struct CacheStats
+ * @brief Counters of a ResponseCache
+ */
+struct CacheStats {
+    size_t memoryHits;
+    size_t diskHits;
+    size_t misses;
+    size_t stores;
+    size_t evictions;     // In-memory entries dropped for capacity
+    size_t memoryEntries;
+};
+
+/**
+ * @class ResponseCache
+ * @brief Exact-match cache of chat completion replies
+ *
+ * Replies are keyed on a hash of model, temperature, max_tokens and the
+ * serialized messages. The first tier is an in-memory LRU split into
+ * independently locked shards. The second tier lives under
+ * <config dir>/cache: an open-addressed index mapped into memory plus an
+ * append-only data file, so entries survive restarts and are shared with
+ * other PiChat processes.
+ *
+ * Settings: cache_enabled (default 1), cache_memory_entries,
+ * cache_ttl_seconds (memory tier), cache_disk_ttl_seconds and
+ * cache_disk_max_mb (0 disables the disk tier).
+ */
+class ResponseCache {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the ResponseCache instance
+     */
+    static ResponseCache& getInstance();
+
+    /**
+     * @brief Hash a request
+     * @param messages Conversation sent to the API
+     * @param model Model name
+     * @param temperature Sampling temperature
+     * @param maxTokens Reply token limit
+     * @return Cache key
+     */
+    static CacheKey makeKey(const ConversationHistory& messages, const std::string& model,
+        float temperature, int maxTokens);
+
+    /**
+     * @brief Look a reply up, memory tier first
+     * @param key Request key
+     * @param response Receives the cached reply on a hit
+     * @return true on a hit that has not expired
+     */
+    bool lookup(const CacheKey& key, std::string& response);
+
+    /**
+     * @brief Store a successful reply in both tiers
+     * @param key Request key
+     * @param response Reply text
+     */
+    void store(const CacheKey& key, const std::string& response);
+
+    /**
+     * @brief Drop every entry from both tiers
+     */
+    void clear();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Get hit and miss counters
+     * @return Snapshot of the counters
+     */
+    CacheStats getStats() const;
+
+    ~ResponseCache();
+
+private:
+    ResponseCache();
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    struct KeyHash {
+        size_t operator()(const CacheKey& key) const { return static_cast<size_t>(key.high); }
+    };
+
+    struct Entry {
+        CacheKey key;
+        std::string response;
+        std::chrono::steady_clock::time_point expiresAt;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries;  // Most recently used first
+        std::unordered_map<CacheKey, std::list<Entry>::iterator, KeyHash> index;
+    };
+
+    static const size_t SHARD_COUNT = 16;
+
+    Shard& shardFor(const CacheKey& key);
+    bool lookupMemory(const CacheKey& key, std::string& response);
+    void storeMemory(const CacheKey& key, const std::string& response, std::chrono::seconds ttl);
+
+    Shard shards[SHARD_COUNT];
+    size_t entriesPerShard;
+    std::chrono::seconds memoryTtl;
+    std::atomic<bool> enabled;
+
+    // Disk tier, null when disabled or unavailable
+    class DiskTier;
+    std::unique_ptr<DiskTier> disk;
+
+    std::atomic<size_t> memoryHits;
+    std::atomic<size_t> diskHits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> stores;
+    std::atomic<size_t> evictions;
+};
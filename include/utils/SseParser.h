@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * @class SseParser
+ * @brief Incremental Server-Sent Events framing parser
+ *
+ * Bytes can be fed in arbitrary chunks: events split across chunks and
+ * chunks carrying several events are both handled. Complete lines are read
+ * in place from the caller's chunk; only a line or event that straddles a
+ * chunk boundary is copied into an internal buffer whose capacity is reused
+ * for the lifetime of the parser.
+ */
+class SseParser {
+public:
+    /**
+     * @brief Called with the data of every complete event
+     *
+     * The view is only valid for the duration of the call.
+     */
+    using EventHandler = std::function<void(std::string_view data)>;
+
+    /**
+     * @brief Construct a parser
+     * @param onEvent Handler for event data
+     * @param initialCapacity Bytes reserved for straddling lines and events
+     */
+    explicit SseParser(EventHandler onEvent, size_t initialCapacity = 4096);
+
+    /**
+     * @brief Feed the next chunk of the stream
+     * @param data Chunk bytes
+     * @param size Chunk length
+     */
+    void feed(const char* data, size_t size);
+
+    /**
+     * @brief Flush an event left unterminated at end of stream
+     */
+    void finish();
+
+    /**
+     * @brief Check whether the [DONE] sentinel has been seen
+     * @return true once the stream signalled completion
+     */
+    bool isDone() const;
+
+    /**
+     * @brief Discard all state so the parser can be reused for a new stream
+     */
+    void reset();
+
+private:
+    void processLine(std::string_view line, bool lineIsBuffered);
+    void dispatch();
+
+    EventHandler onEvent;
+
+    // Partial line carried over from the previous chunk
+    std::string lineBuffer;
+
+    // Data of the event being assembled. While pendingInChunk is set the data
+    // is a view into the current chunk and has not been copied yet.
+    std::string eventBuffer;
+    std::string_view pendingData;
+    bool hasPending;
+    bool pendingInChunk;
+
+    // A chunk ended on '\r'; a leading '\n' in the next one belongs to it
+    bool skipLineFeed;
+    bool done;
+};
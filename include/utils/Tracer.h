@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @class Tracer
+ * @brief Records timed spans per thread and exports them as Chrome trace events
+ *
+ * Each thread writes into its own ring buffer, so recording takes no shared
+ * lock; when a buffer is full the oldest events are overwritten. While
+ * tracing is off a span costs one relaxed atomic load. The export is the
+ * JSON object format of chrome://tracing, which Perfetto also opens.
+ *
+ * Names and categories must be string literals or otherwise outlive the
+ * process; only the pointer is stored.
+ *
+ * Settings: trace_enabled (default 0; the environment variable PICHAT_TRACE=1
+ * also turns it on), trace_file (written at exit, default trace.json in the
+ * configuration directory), trace_buffer_events (events kept per thread).
+ */
+class Tracer {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the Tracer instance
+     */
+    static Tracer& getInstance();
+
+    /**
+     * @brief Check whether spans are being recorded
+     * @return true if tracing is on
+     */
+    static bool isEnabled() { return active.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Turn recording on or off; events recorded so far are kept
+     * @param enabled true to record spans
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Microseconds since the tracer started, the trace's time base
+     * @return Timestamp in microseconds
+     */
+    static int64_t now();
+
+    /**
+     * @brief Record a finished span on the calling thread
+     * @param name Span name
+     * @param category Span category, e.g. "net"
+     * @param start Start from now()
+     * @param duration Length in microseconds
+     */
+    void complete(const char* name, const char* category, int64_t start, int64_t duration);
+
+    /**
+     * @brief Record the start of a span that may end on another thread or overlap others
+     * @param name Span name; the end must use the same name, category and id
+     * @param category Span category
+     * @param id Identifies the span among those with the same name
+     */
+    void asyncBegin(const char* name, const char* category, uint64_t id);
+
+    /**
+     * @brief Record the end of a span started with asyncBegin()
+     * @param name Span name
+     * @param category Span category
+     * @param id Id given to asyncBegin()
+     */
+    void asyncEnd(const char* name, const char* category, uint64_t id);
+
+    /**
+     * @brief Name the calling thread in the trace; call before it records anything
+     * @param name Thread name, e.g. "RequestEngine"
+     */
+    static void setThreadName(const char* name);
+
+    /**
+     * @brief Export every buffered event
+     * @return JSON object with a traceEvents array
+     */
+    std::string toChromeJson() const;
+
+    /**
+     * @brief Write toChromeJson() to a file
+     * @param path File to write
+     * @return true on success
+     */
+    bool writeChromeJson(const std::string& path) const;
+
+    /**
+     * @brief Write the trace to trace_file if tracing was on; called at exit
+     */
+    void writeOnExit() const;
+
+private:
+    Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    struct Event {
+        const char* name;
+        const char* category;
+        char phase;  // 'X' complete, 'b' async begin, 'e' async end
+        int64_t timestamp;
+        int64_t duration;
+        uint64_t id;
+    };
+
+    // Written by its thread only; the mutex is contended only by an export
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events;  // Ring of capacity entries
+        size_t next = 0;
+        bool wrapped = false;
+        uint64_t threadId = 0;
+        const char* threadName = nullptr;  // Set at creation, read by exports
+        std::atomic<bool> exited{ false };
+    };
+
+    // Releases its buffer to the tracer when the thread exits
+    struct ThreadSlot {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~ThreadSlot();
+    };
+
+    ThreadBuffer& threadBuffer();
+    void record(const Event& event);
+
+    static std::atomic<bool> active;
+
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // Exited threads' too, until pruned
+    uint64_t nextThreadId;
+    size_t capacity;
+    std::string traceFile;
+    std::atomic<bool> wasEnabled;
+};
+
+/**
+ * @class TraceSpan
+ * @brief Records the lifetime of a scope as a span, if tracing is on
+ */
+class TraceSpan {
+public:
+    /**
+     * @param name Span name, a string literal
+     * @param category Span category, a string literal
+     */
+    TraceSpan(const char* name, const char* category)
+        : name(Tracer::isEnabled() ? name : nullptr), category(category), start(this->name ? Tracer::now() : 0) {
+    }
+
+    ~TraceSpan() {
+        if (name) {
+            Tracer::getInstance().complete(name, category, start, Tracer::now() - start);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;  // Null while tracing is off
+    const char* category;
+    int64_t start;
+};
@@ -5,6 +5,8 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <deque>
+#include <mutex>
 
 // Forward declarations
 class SpeechRecognizer;
@@ -49,6 +51,14 @@ public:
      */
     void speak(const std::string& text);
 
+    /**
+     * @brief Speak the provided text on the Executor, without waiting
+     *
+     * Texts queued this way are spoken one after another, in order.
+     * @param text Text to convert to speech
+     */
+    void speakAsync(const std::string& text);
+
     /**
      * @brief Process a command and determine if it's a system command
      * @param command The command text to process
@@ -81,10 +91,19 @@ private:
     std::unique_ptr<TextToSpeech> textToSpeech;
     std::unique_ptr<CommandProcessor> commandProcessor;
 
-    // Listening state
+    // Listening state. The loop blocks on input for as long as voice mode
+    // runs, so it keeps a thread of its own rather than a pool worker.
     std::atomic<bool> listening;
     std::thread listeningThread;
 
+    // Texts waiting for speakAsync(); one pool task speaks them at a time
+    std::mutex speechMutex;
+    std::deque<std::string> speechQueue;
+    bool speaking;
+
     // Listening loop function
     void listeningLoop(std::function<void(const std::string&)> callback);
+
+    // Speak queued texts until none are left
+    void drainSpeech();
 };
\ No newline at end of file
@@ -1,10 +1,31 @@
 #include "include/cli/CLIManager.h"
 #include "include/config/ConfigManager.h"
 #include "include/utils/ErrorHandler.h"
+#include "include/utils/BpeTokenizer.h"
+#include "include/utils/ContextWindow.h"
+#include "include/utils/ResponseCache.h"
+#include "include/utils/BatchCompletion.h"
+#include "include/service/ServiceClient.h"
+#include "include/service/ServiceDaemon.h"
+#include "include/utils/DeepSeekAPI.h"
+#include "include/utils/SseParser.h"
+#include "include/utils/DeltaExtractor.h"
+#include <nlohmann/json.hpp>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <cstdio>
+#include <random>
 
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
@@ -13,6 +34,7 @@
 #ifdef _WIN32
 #include <Windows.h>
 #include <ShlObj.h>  // For SHGetFolderPathA and CSIDL_APPDATA
+#include <io.h>      // For _isatty
 #else
 #include <unistd.h>
 #include <sys/types.h>
@@ -21,6 +43,7 @@
 #endif
 #include <signal.h>
 namespace fs = std::filesystem;
+using json = nlohmann::json;
 
 // Process ID file
 const std::string PID_FILE = [] {
@@ -38,6 +61,102 @@ const std::string PID_FILE = [] {
 #endif
     }();
 
+namespace {
+    // Where a --batch run stopped: the input consumed and the output written
+    // up to the last result in order. Stored as text in <out.jsonl>.checkpoint.
+    struct BatchCheckpoint {
+        unsigned long long inputOffset = 0;
+        unsigned long long inputLines = 0;
+        unsigned long long outputBytes = 0;
+    };
+
+    bool readCheckpoint(const std::string& path, BatchCheckpoint& checkpoint) {
+        std::ifstream file(path);
+        return static_cast<bool>(file >> checkpoint.inputOffset >> checkpoint.inputLines >> checkpoint.outputBytes);
+    }
+
+    // Written to a temporary file and renamed, so a crash never leaves half a checkpoint
+    bool writeCheckpoint(const std::string& path, const BatchCheckpoint& checkpoint) {
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::trunc);
+            file << checkpoint.inputOffset << " " << checkpoint.inputLines << " " << checkpoint.outputBytes << std::endl;
+            if (!file) {
+                return false;
+            }
+        }
+        std::error_code error;
+        fs::rename(temp, path, error);
+        return !error;
+    }
+
+    // One input line: {"prompt": "..."} or {"messages": [{"role": ..., "content": ...}]},
+    // optionally with "id", "model", "temperature" and "max_tokens"
+    bool parseBatchLine(const std::string& line, BatchItem& item, json& id, std::string& error) {
+        json entry = json::parse(line, nullptr, false);
+        if (entry.is_discarded() || !entry.is_object()) {
+            error = "not a JSON object";
+            return false;
+        }
+
+        if (entry.contains("messages") && entry["messages"].is_array()) {
+            for (const auto& message : entry["messages"]) {
+                if (!message.is_object() || !message.contains("content") || !message["content"].is_string()) {
+                    error = "every message needs a string \"content\"";
+                    return false;
+                }
+                std::string role = message.contains("role") && message["role"].is_string()
+                    ? message["role"].get<std::string>() : "user";
+                item.messages.push_back(Message(role, message["content"].get<std::string>()));
+            }
+        }
+        else if (entry.contains("prompt") && entry["prompt"].is_string()) {
+            item.messages.push_back(Message("user", entry["prompt"].get<std::string>()));
+        }
+        if (item.messages.empty()) {
+            error = "expected \"prompt\" or \"messages\"";
+            return false;
+        }
+
+        if (entry.contains("model") && entry["model"].is_string()) {
+            item.model = entry["model"].get<std::string>();
+        }
+        if (entry.contains("temperature") && entry["temperature"].is_number()) {
+            item.temperature = entry["temperature"].get<float>();
+        }
+        if (entry.contains("max_tokens") && entry["max_tokens"].is_number_integer()) {
+            item.maxTokens = entry["max_tokens"].get<int>();
+        }
+        if (entry.contains("id")) {
+            id = entry["id"];
+        }
+        return true;
+    }
+
+    double percentileOf(std::vector<double> values, double p) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+        std::nth_element(values.begin(), values.begin() + rank, values.end());
+        return values[rank];
+    }
+
+    bool stderrIsTerminal() {
+#ifdef _WIN32
+        return _isatty(_fileno(stderr)) != 0;
+#else
+        return isatty(fileno(stderr)) != 0;
+#endif
+    }
+
+    std::atomic<bool> batchInterrupted(false);
+
+    void onBatchInterrupt(int) {
+        batchInterrupted = true;
+    }
+}
+
 CLIManager::CLIManager() : appName("pichat") {
     // Register default commands
     registerCommand("--help", "Show this help message",
@@ -94,15 +213,88 @@ CLIManager::CLIManager() : appName("pichat") {
 
     registerCommand("--status", "Check PiChat service status",
         [this](const std::vector<std::string>& args) {
+            std::string socketPath = ServiceDaemon::getSocketPath();
+            ServiceClient client;
+            ServiceStatus status;
+            if (client.connect(socketPath) && client.getStatus(status)) {
+                std::cout << "PiChat is running (pid " << status.pid << ")" << std::endl
+                    << "  Socket: " << socketPath << std::endl
+                    << std::fixed << std::setprecision(0)
+                    << "  Uptime: " << status.stats.uptimeSeconds << " s" << std::endl
+                    << "  Clients: " << status.stats.connections << " connected, "
+                    << status.stats.acceptedConnections << " since start" << std::endl
+                    << "  Requests: " << status.stats.requests << " received, "
+                    << status.stats.activeRequests << " in flight" << std::endl;
+                return 0;
+            }
+
             if (isServiceRunning()) {
-                std::cout << "PiChat is running" << std::endl;
+                std::cout << "PiChat is running but not answering on " << socketPath << std::endl;
+                return 1;
+            }
+            std::cout << "PiChat is not running" << std::endl;
+            return 0;
+        });
+
+    registerCommand("--stats", "Print PiChat service metrics in the Prometheus text format",
+        [this](const std::vector<std::string>& args) {
+            // The metrics live in the daemon; a fresh process has none
+            std::string socketPath = ServiceDaemon::getSocketPath();
+            ServiceClient client;
+            std::string text;
+            if (client.connect(socketPath) && client.getMetrics(text)) {
+                std::cout << text << std::flush;
+                return 0;
+            }
+
+            if (isServiceRunning()) {
+                std::cerr << "PiChat is running but not answering on " << socketPath << std::endl;
             }
             else {
-                std::cout << "PiChat is not running" << std::endl;
+                std::cerr << "PiChat is not running; start it with --start to collect metrics" << std::endl;
             }
+            return 1;
+        });
+
+    registerCommand("--trace", "Write the PiChat service's trace spans as Chrome trace JSON: [file]",
+        [this](const std::vector<std::string>& args) {
+            std::string socketPath = ServiceDaemon::getSocketPath();
+            ServiceClient client;
+            std::string trace;
+            if (!client.connect(socketPath) || !client.getTrace(trace)) {
+                if (isServiceRunning()) {
+                    std::cerr << "PiChat is running but not answering on " << socketPath << std::endl;
+                }
+                else {
+                    std::cerr << "PiChat is not running; start it with --start to collect a trace" << std::endl;
+                }
+                return 1;
+            }
+
+            json parsed = json::parse(trace, nullptr, false);
+            if (!parsed.is_discarded() && parsed["traceEvents"].empty()) {
+                std::cerr << "The trace is empty; set trace_enabled=1 and restart the service to record one" << std::endl;
+            }
+
+            if (args.empty()) {
+                std::cout << trace << std::flush;
+                return 0;
+            }
+            std::ofstream file(args[0], std::ios::binary | std::ios::trunc);
+            file << trace;
+            if (!file) {
+                std::cerr << "Cannot write " << args[0] << std::endl;
+                return 1;
+            }
+            std::cout << "Trace written to " << args[0] << "; open it in chrome://tracing or ui.perfetto.dev" << std::endl;
             return 0;
         });
 
+    registerCommand("--ask", "Ask one question and stream the reply: <prompt... | ->",
+        [this](const std::vector<std::string>& args) {
+            return runAsk(args);
+        });
+
     registerCommand("--set-key", "Set DeepSeek API key",
         [this](const std::vector<std::string>& args) {
             if (args.size() < 1) {
@@ -122,6 +314,79 @@ CLIManager::CLIManager() : appName("pichat") {
                 return 1;
             }
         });
+    registerCommand("--estimate", "Estimate prompt tokens and cost of text, a file or stdin (-)",
+        [this](const std::vector<std::string>& args) {
+            if (args.empty()) {
+                std::cerr << "Error: nothing to estimate" << std::endl;
+                std::cout << "Usage: " << appName << " --estimate <text | file | ->" << std::endl;
+                return 1;
+            }
+
+            std::string text;
+            if (args.size() == 1 && args[0] == "-") {
+                std::stringstream input;
+                input << std::cin.rdbuf();
+                text = input.str();
+            }
+            else if (args.size() == 1 && fs::is_regular_file(args[0])) {
+                std::ifstream file(args[0], std::ios::binary);
+                std::stringstream input;
+                input << file.rdbuf();
+                text = input.str();
+            }
+            else {
+                for (size_t i = 0; i < args.size(); i++) {
+                    text += (i > 0 ? " " : "") + args[i];
+                }
+            }
+
+            ConfigManager& config = ConfigManager::getInstance();
+            BpeTokenizer& tokenizer = BpeTokenizer::getInstance();
+            Message message("user", text);
+
+            auto start = std::chrono::steady_clock::now();
+            size_t tokens = tokenizer.isLoaded()
+                ? ContextWindow::MESSAGE_OVERHEAD_TOKENS + tokenizer.countTokens(message.getRole()) +
+                    tokenizer.countTokens(message.getContent())
+                : ContextWindow::estimateTokens(message);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Prices are per million tokens
+            double inputPrice = std::strtod(config.getSetting("price_input_per_mtok", "0.27").c_str(), nullptr);
+            double outputPrice = std::strtod(config.getSetting("price_output_per_mtok", "1.10").c_str(), nullptr);
+            const long long replyTokens = 1000;  // Default maxTokens of a chat completion
+
+            std::cout << "Prompt tokens: " << tokens
+                << (tokenizer.isLoaded() ? " (tokenizer count, the API's may differ)" : " (approximate, no tokenizer installed)") << std::endl;
+            std::cout << std::fixed << std::setprecision(6)
+                << "Input cost: $" << tokens * inputPrice / 1e6 << std::endl
+                << "Reply cost: up to $" << replyTokens * outputPrice / 1e6
+                << " for " << replyTokens << " tokens" << std::endl;
+            if (tokenizer.isLoaded() && seconds > 0) {
+                std::cout << std::setprecision(2)
+                    << "Tokenized " << text.size() / 1e6 << " MB in " << seconds * 1e3 << " ms ("
+                    << tokens / seconds / 1e6 << "M tokens/s)" << std::endl;
+            }
+            return 0;
+        });
+
+    registerCommand("--bench", "Measure how fast streamed replies are framed and read: [chunks]",
+        [this](const std::vector<std::string>& args) {
+            return runBench(args);
+        });
+
+    registerCommand("--clear-cache", "Drop all cached chat replies",
+        [this](const std::vector<std::string>& args) {
+            ResponseCache::getInstance().clear();
+            std::cout << "Response cache cleared" << std::endl;
+            return 0;
+        });
+
+    registerCommand("--batch", "Run prompts from a JSONL file or stdin (-) concurrently: <in.jsonl> <out.jsonl> [--parallel N]",
+        [this](const std::vector<std::string>& args) {
+            return runBatch(args);
+        });
+
         registerCommand("--interactive", "Start interactive chat mode",
             [this](const std::vector<std::string>& args) {
                 std::cout << "Starting PiChat interactive mode. Type 'exit' to quit.\n";
@@ -150,13 +415,7 @@ CLIManager::CLIManager() : appName("pichat") {
         
         registerCommand("--service", "Run PiChat as a background service",
             [this](const std::vector<std::string>& args) {
-                std::cout << "PiChat service is running in the background." << std::endl;
-                // Simulated background process loop
-                while (true) {
-                    // std::this_thread::sleep_for(std::chrono::seconds(60));
-                    // This would typically process queued inputs, etc.
-                }
-                return 0;
+                return ServiceDaemon::getInstance().run();
             });
 }
 
@@ -219,8 +478,375 @@ int CLIManager::handleUnknownCommand(const std::string& command) {
     return 1;
 }
 
+int CLIManager::runBatch(const std::vector<std::string>& args) {
+    std::vector<std::string> paths;
+    size_t parallel = 0;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--parallel" && i + 1 < args.size()) {
+            parallel = static_cast<size_t>(std::strtoul(args[++i].c_str(), nullptr, 10));
+        }
+        else {
+            paths.push_back(args[i]);
+        }
+    }
+    if (paths.size() != 2) {
+        std::cerr << "Error: input and output files not provided" << std::endl;
+        std::cout << "Usage: " << appName << " --batch <in.jsonl | -> <out.jsonl> [--parallel N]" << std::endl;
+        return 1;
+    }
+    const std::string& inputPath = paths[0];
+    const std::string& outputPath = paths[1];
+
+    ConfigManager& config = ConfigManager::getInstance();
+    std::string apiKey = config.getApiKey();
+    if (apiKey.empty()) {
+        std::cerr << "Error: API key not set. Use --set-key to configure." << std::endl;
+        return 1;
+    }
+
+    std::ifstream inputFile;
+    std::istream* input = &std::cin;
+    if (inputPath != "-") {
+        inputFile.open(inputPath, std::ios::binary);
+        if (!inputFile) {
+            std::cerr << "Error: cannot open " << inputPath << std::endl;
+            return 1;
+        }
+        input = &inputFile;
+    }
+
+    // A checkpoint left by an interrupted run: skip the input it covers and
+    // drop any output written after it
+    const std::string checkpointPath = outputPath + ".checkpoint";
+    BatchCheckpoint checkpoint;
+    bool resuming = readCheckpoint(checkpointPath, checkpoint);
+    if (resuming) {
+        std::error_code error;
+        if (!fs::exists(outputPath) || fs::file_size(outputPath, error) < checkpoint.outputBytes) {
+            std::cerr << "Error: " << outputPath << " is shorter than its checkpoint; delete "
+                << checkpointPath << " to start over" << std::endl;
+            return 1;
+        }
+        fs::resize_file(outputPath, checkpoint.outputBytes, error);
+
+        if (input == &inputFile) {
+            inputFile.seekg(static_cast<std::streamoff>(checkpoint.inputOffset));
+        }
+        else {
+            std::string skipped;
+            for (unsigned long long i = 0; i < checkpoint.inputLines && std::getline(*input, skipped); i++) {
+            }
+        }
+        std::cerr << "Resuming after input line " << checkpoint.inputLines << std::endl;
+    }
+
+    std::ofstream output(outputPath, std::ios::binary | (resuming ? std::ios::app : std::ios::trunc));
+    if (!output) {
+        std::cerr << "Error: cannot write " << outputPath << std::endl;
+        return 1;
+    }
+
+    // The source and the sink both run on this thread; results come back in
+    // input order, so the oldest pending entry belongs to the next result
+    struct PendingLine {
+        unsigned long long line;
+        unsigned long long endOffset;
+        json id;
+    };
+    std::deque<PendingLine> pending;
+    unsigned long long offset = checkpoint.inputOffset;
+    unsigned long long lineNumber = checkpoint.inputLines;
+    size_t invalid = 0;
+
+    BatchSource next = [&](BatchItem& item) {
+        std::string line;
+        while (std::getline(*input, line)) {
+            offset += line.size() + 1;
+            lineNumber++;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+
+            item = BatchItem();
+            json id;
+            std::string error;
+            if (parseBatchLine(line, item, id, error)) {
+                pending.push_back(PendingLine{ lineNumber, offset, std::move(id) });
+                return true;
+            }
+            std::cerr << "Line " << lineNumber << " skipped: " << error << std::endl;
+            invalid++;
+        }
+        return false;
+    };
+
+    CompletionOptions options;
+    const bool live = stderrIsTerminal();
+    const auto start = std::chrono::steady_clock::now();
+    auto lastReport = start;
+    size_t written = 0;
+    size_t failed = 0;
+    std::vector<double> recentLatencies;  // Ring of the latest results, for percentiles
+    const size_t latencyWindow = 1024;
+    bool outputFailed = false;
+
+    auto report = [&](bool final) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << (live && !final ? "\r" : "") << std::fixed << std::setprecision(1)
+            << written << " done (" << failed << " failed), "
+            << (seconds > 0 ? written / seconds : 0.0) << " req/s, latency p50 "
+            << percentileOf(recentLatencies, 50) << " ms p95 " << percentileOf(recentLatencies, 95) << " ms"
+            << (live && !final ? "" : "\n") << std::flush;
+    };
+
+    BatchSink sink = [&](BatchResult&& result) {
+        PendingLine line = std::move(pending.front());
+        pending.pop_front();
+
+        // After an interrupt the remaining results are errors; leave them to the next run
+        if (options.cancellation.isCancelled()) {
+            return;
+        }
+
+        json record;
+        record["line"] = line.line;
+        if (!line.id.is_null()) {
+            record["id"] = line.id;
+        }
+        record["ok"] = result.ok;
+        record[result.ok ? "reply" : "error"] = result.reply;
+        record["latency_ms"] = std::round(result.latencyMs);
+        std::string text = record.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+
+        output.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if (!output) {
+            outputFailed = true;
+            options.cancellation.cancel();
+            return;
+        }
+        checkpoint.outputBytes += text.size();
+        checkpoint.inputOffset = line.endOffset;
+        checkpoint.inputLines = line.line;
+
+        written++;
+        if (!result.ok) {
+            failed++;
+        }
+        if (recentLatencies.size() < latencyWindow) {
+            recentLatencies.push_back(result.latencyMs);
+        }
+        else {
+            recentLatencies[written % latencyWindow] = result.latencyMs;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            lastReport = now;
+            output.flush();
+            writeCheckpoint(checkpointPath, checkpoint);
+            report(false);
+        }
+    };
+
+    // Ctrl+C stops pulling prompts and aborts the requests in flight; the
+    // checkpoint then lets the same command pick up where this run stopped
+    batchInterrupted = false;
+    auto previousHandler = signal(SIGINT, onBatchInterrupt);
+    std::atomic<bool> batchDone(false);
+    std::thread watcher([&]() {
+        while (!batchDone) {
+            if (batchInterrupted) {
+                options.cancellation.cancel();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        });
+
+    BatchSummary summary = batchChatCompletion(apiKey, std::move(next), std::move(sink), parallel, options);
+
+    batchDone = true;
+    watcher.join();
+    signal(SIGINT, previousHandler);
+
+    output.flush();
+    bool interrupted = options.cancellation.isCancelled();
+    if (interrupted) {
+        writeCheckpoint(checkpointPath, checkpoint);
+    }
+    else {
+        fs::remove(checkpointPath);
+    }
+
+    if (live) {
+        std::cerr << std::endl;
+    }
+    report(true);
+    std::cerr << std::fixed << std::setprecision(1)
+        << "Batch " << (interrupted ? "interrupted" : "done") << ": " << written << " written, "
+        << failed << " failed, " << invalid << " invalid lines in " << summary.elapsedMs / 1000.0 << " s"
+        << ", mean latency " << summary.meanLatencyMs << " ms, max " << summary.maxLatencyMs << " ms" << std::endl;
+
+    if (outputFailed) {
+        std::cerr << "Error: writing " << outputPath << " failed" << std::endl;
+        return 1;
+    }
+    if (interrupted) {
+        std::cerr << "Run the same command again to resume after input line " << checkpoint.inputLines << std::endl;
+        return 130;
+    }
+    return 0;
+}
+
+int CLIManager::runAsk(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cerr << "Error: no prompt given" << std::endl;
+        std::cout << "Usage: " << appName << " --ask <prompt... | ->" << std::endl;
+        return 1;
+    }
+
+    std::string prompt;
+    if (args.size() == 1 && args[0] == "-") {
+        std::stringstream input;
+        input << std::cin.rdbuf();
+        prompt = input.str();
+    }
+    else {
+        for (size_t i = 0; i < args.size(); i++) {
+            prompt += (i > 0 ? " " : "") + args[i];
+        }
+    }
+
+    ConversationHistory messages;
+    messages.push_back(Message("user", prompt));
+    bool printed = false;
+    auto print = [&printed](const std::string& delta) {
+        printed = true;
+        std::cout << delta << std::flush;
+    };
+
+    // A running service has warm connections and a shared cache; without
+    // one, or if it goes away before answering, ask the API directly
+    std::string reply;
+    ServiceClient client;
+    bool served = client.connect(ServiceDaemon::getSocketPath()) && client.chat(messages, print, reply);
+    if (!served && printed) {
+        std::cout << std::endl;
+        std::cerr << "Error: lost the connection to the PiChat service" << std::endl;
+        return 1;
+    }
+    if (!served) {
+        std::string apiKey = ConfigManager::getInstance().getApiKey();
+        if (apiKey.empty()) {
+            std::cerr << "Error: API key not set. Use --set-key to configure." << std::endl;
+            return 1;
+        }
+        reply = streamingChatCompletion(apiKey, messages, print);
+    }
+
+    if (isErrorReply(reply)) {
+        if (printed) {
+            std::cout << std::endl;
+        }
+        std::cerr << reply << std::endl;
+        return 1;
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+int CLIManager::runBench(const std::vector<std::string>& args) {
+    long long chunkCount = args.empty() ? 100000 : std::atoll(args[0].c_str());
+    if (chunkCount <= 0) {
+        std::cerr << "Error: the chunk count must be a positive number" << std::endl;
+        std::cout << "Usage: " << appName << " --bench [chunks]" << std::endl;
+        return 1;
+    }
+
+    // A stream shaped like the API's, cut at random points as the network would
+    std::mt19937 random(42);
+    std::vector<std::string> payloads;
+    std::string stream;
+    for (long long i = 0; i < chunkCount; i++) {
+        std::string content = "token " + std::to_string(random() % 100000) +
+            (i % 7 == 0 ? " \\\"quoted\\\"\\n" : " ");
+        payloads.push_back("{\"id\":\"chatcmpl-1\",\"object\":\"chat.completion.chunk\",\"created\":1700000000,"
+            "\"model\":\"deepseek-chat\",\"choices\":[{\"index\":0,\"delta\":{\"content\":\"" + content +
+            "\"},\"logprobs\":null,\"finish_reason\":null}]}");
+        stream += "data: " + payloads.back() + (i % 2 == 0 ? "\n\n" : "\r\n\r\n");
+    }
+    stream += "data: [DONE]\n\n";
+    std::vector<size_t> cuts;
+    for (size_t offset = 0; offset < stream.size();) {
+        offset = std::min(stream.size(), offset + 1 + random() % 512);
+        cuts.push_back(offset);
+    }
+
+    // Best of a few passes, so a cold cache or a preempted pass does not count
+    const int passes = 5;
+    double best = 0;
+    size_t events = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        events = 0;
+        SseParser parser([&events](std::string_view) { events++; });
+        auto start = std::chrono::steady_clock::now();
+        size_t offset = 0;
+        for (size_t cut : cuts) {
+            parser.feed(stream.data() + offset, cut - offset);
+            offset = cut;
+        }
+        parser.finish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = pass == 0 ? seconds : std::min(best, seconds);
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+        << "SSE framing: " << events << " events, " << stream.size() / 1e6 << " MB in "
+        << cuts.size() << " chunks, " << stream.size() / best / 1e9 << " GB/s" << std::endl;
+    if (events != payloads.size()) {
+        std::cerr << "Error: expected " << payloads.size() << " events" << std::endl;
+        return 1;
+    }
+
+    // The scanner against the nlohmann::json DOM it replaced; both must agree
+    auto timeExtraction = [&payloads](bool (*extract)(std::string_view, StreamDelta&), std::vector<std::string>& contents) {
+        double fastest = 0;
+        StreamDelta delta;
+        for (int pass = 0; pass < passes; pass++) {
+            contents.clear();
+            auto start = std::chrono::steady_clock::now();
+            for (const std::string& payload : payloads) {
+                extract(payload, delta);
+                contents.push_back(delta.content);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            fastest = pass == 0 ? seconds : std::min(fastest, seconds);
+        }
+        return fastest * 1e9 / payloads.size();
+        };
+    std::vector<std::string> scanned;
+    std::vector<std::string> parsed;
+    double scanNs = timeExtraction(&DeltaExtractor::scan, scanned);
+    double domNs = timeExtraction(&DeltaExtractor::extractWithDom, parsed);
+    std::cout << std::setprecision(0)
+        << "Delta extraction: " << scanNs << " ns per chunk scanned, " << domNs << " ns with a JSON DOM ("
+        << std::setprecision(1) << domNs / scanNs << "x)" << std::endl;
+    if (scanned != parsed) {
+        std::cerr << "Error: the scanner and the JSON DOM disagree" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 // Helper methods for service management
 bool CLIManager::isServiceRunning() {
+    // A daemon that answers is running, whoever started it
+    ServiceClient client;
+    ServiceStatus status;
+    if (client.connect(ServiceDaemon::getSocketPath()) && client.getStatus(status)) {
+        return true;
+    }
+
     if (!fs::exists(PID_FILE)) {
         return false;
     }
@@ -1,4 +1,6 @@
 #include "include/config/ConfigManager.h"
+#include "include/utils/Tracer.h"
+#include <charconv>
 #include <fstream>
 #include <filesystem>
 #include <iostream>
@@ -79,6 +81,16 @@ std::string ConfigManager::getSetting(const std::string& key, const std::string&
     return (it != config.end()) ? it->second : defaultValue;
 }
 
+long long ConfigManager::getIntSetting(const std::string& key, long long defaultValue) const {
+    std::string value = getSetting(key);
+    long long result = 0;
+    auto parsed = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (value.empty() || parsed.ec != std::errc() || parsed.ptr != value.data() + value.size()) {
+        return defaultValue;
+    }
+    return result;
+}
+
 bool ConfigManager::setSetting(const std::string& key, const std::string& value) {
     std::lock_guard<std::mutex> lock(configMutex);
     auto config = loadConfig();
@@ -86,6 +98,10 @@ bool ConfigManager::setSetting(const std::string& key, const std::string& value)
     return saveConfig(config);
 }
 
+std::string ConfigManager::getConfigDirectory() const {
+    return fs::path(configFilePath).parent_path().string();
+}
+
 std::string ConfigManager::getCurrentLanguage() const {
     return getSetting("language", "en");
 }
@@ -107,6 +123,7 @@ void ConfigManager::ensureConfigDirectory() const {
 }
 
 std::unordered_map<std::string, std::string> ConfigManager::loadConfig() const {
+    TraceSpan span("ConfigManager::loadConfig", "config");
     std::unordered_map<std::string, std::string> config;
 
     if (!fs::exists(configFilePath)) {
@@ -134,6 +151,7 @@ std::unordered_map<std::string, std::string> ConfigManager::loadConfig() const {
 }
 
 bool ConfigManager::saveConfig(const std::unordered_map<std::string, std::string>& config) const {
+    TraceSpan span("ConfigManager::saveConfig", "config");
     try {
         ensureConfigDirectory();
         std::ofstream file(configFilePath);
@@ -1,14 +1,17 @@
 ﻿#include "include/gui/MainWindow.h"
 #include "ui_MainWindow.h"
 #include "include/gui/SettingsDialog.h"
+#include "include/utils/Tracer.h"
 #include <QScrollBar>
 #include <QKeyEvent>
 #include <QMessageBox>
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget* parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    api(new DeepSeekAPI(this))
+    api(new DeepSeekAPI(this)),
+    pendingReplies(0)
 {
     ui->setupUi(this);
     setupConnections();
@@ -31,6 +34,9 @@ void MainWindow::setupConnections() {
 
     // Connect new chat button
     connect(ui->newChatButton, &QPushButton::clicked, this, [this]() {
+        // Replies to the old conversation are no longer wanted
+        api->cancelPending();
+        pendingReplies = 0;
         chatHistory.clear();
         ui->chatDisplay->clear();
         appendMessage("PiChat", "Starting a new conversation. How can I help you?");
@@ -76,14 +82,17 @@ void MainWindow::on_sendButton_clicked() {
     // Clear input field
     ui->messageInput->clear();
 
+    // Update history first so the request snapshot shares it instead of branching
+    chatHistory.push_back(Message("user", message.toStdString()));
+
     // Send message to API
+    pendingReplies++;
     api->sendMessage(message.toStdString(), chatHistory);
-
-    // Update history for API
-    chatHistory.push_back(Message("user", message.toStdString()));
 }
 
 void MainWindow::onResponseReceived(const QString& response) {
+    pendingReplies = std::max(0, pendingReplies - 1);
+
     // 显示助理回复 - 现在直接使用QString，无需转换
     appendMessage("PiChat", response);
 
@@ -91,6 +100,7 @@ void MainWindow::onResponseReceived(const QString& response) {
     chatHistory.push_back(Message("assistant", response.toStdString()));
 }
 void MainWindow::appendMessage(const QString& sender, const QString& message) {
+    TraceSpan span("MainWindow::appendMessage", "gui");
     QTextCursor cursor(ui->chatDisplay->document());
     cursor.movePosition(QTextCursor::End);
 
@@ -125,6 +135,12 @@ bool MainWindow::eventFilter(QObject* obj, QEvent* event) {
             on_sendButton_clicked();
             return true;
         }
+        if (keyEvent->key() == Qt::Key_Escape && pendingReplies > 0) {
+            api->cancelPending();
+            pendingReplies = 0;
+            appendMessage("PiChat", "Request cancelled.");
+            return true;
+        }
     }
     return QMainWindow::eventFilter(obj, event);
 }
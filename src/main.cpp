@@ -6,6 +6,7 @@
 #include <functional>
 #include <future>
 #include <mutex>
+#include <atomic>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 #include <filesystem>
@@ -27,7 +28,12 @@
 
 #include "include/config/ConfigManager.h"
 #include "include/utils/ErrorHandler.h"
+#include "include/utils/CurlHandlePool.h"
+#include "include/utils/RequestEngine.h"
+#include "include/utils/Executor.h"
+#include "include/utils/Tracer.h"
 #include "include/cli/CLIManager.h"
+#include "include/service/ServiceDaemon.h"
 #include "include/voice/VoiceManager.h"
 #include "include/voice/CommandProcessor.h"
 #include "include/voice/TextToSpeech.h"
@@ -80,26 +86,58 @@ void signalHandler(int signum) {
 }
 #endif
 
-// Service mode
-void runService() {
-    // Setup signal handling
+// Ctrl+C while a chat request is in flight cancels the request instead of
+// ending the program
+std::atomic<bool> g_requestInFlight(false);
+std::atomic<bool> g_cancelRequested(false);
+
 #ifdef _WIN32
-    SetConsoleCtrlHandler(consoleHandler, TRUE);
+BOOL WINAPI interruptHandler(DWORD signal) {
+    if (signal == CTRL_C_EVENT && g_requestInFlight) {
+        g_cancelRequested = true;
+        return TRUE;
+    }
+    return FALSE;
+}
 #else
-    signal(SIGTERM, signalHandler);
-    signal(SIGINT, signalHandler);
+void interruptHandler(int signum) {
+    if (g_requestInFlight) {
+        g_cancelRequested = true;
+        return;
+    }
+    signal(SIGINT, SIG_DFL);
+    raise(SIGINT);
+}
 #endif
 
-    std::cout << "PiChat service started" << std::endl;
+// Run a blocking chat call. The handler cannot take locks, so a watcher
+// thread turns its flag into ChatSession::cancel().
+std::string sendInterruptible(ChatSession& session, const std::function<std::string()>& send, bool& interrupted) {
+    g_cancelRequested = false;
+    g_requestInFlight = true;
+    interrupted = false;
+
+    std::atomic<bool> done(false);
+    std::thread watcher([&]() {
+        while (!done) {
+            if (g_cancelRequested.exchange(false)) {
+                interrupted = true;
+                session.cancel();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        });
 
-    // Main service loop
-    while (g_running) {
-        // In a real application, this would handle incoming requests
-        // This is just a placeholder
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
+    std::string response = send();
+    g_requestInFlight = false;
+    done = true;
+    watcher.join();
+    return response;
+}
 
-    std::cout << "PiChat service stopped" << std::endl;
+// Service mode: serve local clients until SIGTERM
+int runService() {
+    return ServiceDaemon::getInstance().run();
 }
 
 // Interactive mode with DeepSeek API
@@ -126,6 +164,12 @@ void runInteractive() {
         return;
     }
 
+#ifdef _WIN32
+    SetConsoleCtrlHandler(interruptHandler, TRUE);
+#else
+    signal(SIGINT, interruptHandler);
+#endif
+
     // Basic interactive loop
     std::string input;
     while (true) {
@@ -145,9 +189,12 @@ void runInteractive() {
         if (!input.empty()) {
             std::cout << "PiChat: ";
 
-            // Try non-streaming first
-            std::string response = chatSession.sendMessage(input);
-            std::cout << response << std::endl;
+            // Try non-streaming first; Ctrl+C abandons the request
+            bool interrupted = false;
+            std::string response = sendInterruptible(chatSession, [&]() {
+                return chatSession.sendMessage(input);
+                }, interrupted);
+            std::cout << (interrupted ? std::string("[cancelled]") : response) << std::endl;
 
             // Use streaming API if you prefer real-time responses (currently disabled to test non-streaming first)
             /*
@@ -244,7 +291,7 @@ void runVoice() {
         std::cout << "PiChat: " << response << std::endl;
 
         // 使用TTS播放回答
-        tts.speak(response);
+        voiceManager.speakAsync(response);
         };
 
     // 开始监听
@@ -259,6 +306,9 @@ void runVoice() {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
+    // Do not wait for a reply nobody will hear
+    chatSession.cancel();
+
     // 停止语音识别
     voiceManager.stopListening();
     std::cout << "Voice mode exited." << std::endl;
@@ -326,6 +376,17 @@ void runGui(int argc, char* argv[]) {
     app.exec();
 }
 
+// Stop the request engine, let the pool finish what the last replies queued,
+// and release pooled curl handles before libcurl itself is torn down. The
+// trace is written once the last spans are in.
+void cleanupNetworking() {
+    RequestEngine::getInstance().shutdown();
+    Executor::getInstance().shutdown();
+    Tracer::getInstance().writeOnExit();
+    CurlHandlePool::getInstance().shutdown();
+    curl_global_cleanup();
+}
+
 int main(int argc, char* argv[]) {
     // Initialize libcurl
     curl_global_init(CURL_GLOBAL_ALL);
@@ -336,42 +397,45 @@ int main(int argc, char* argv[]) {
     // Initialize ConfigManager
     ConfigManager& configManager = ConfigManager::getInstance();
 
+    // Reads trace_enabled, so spans are recorded from here on
+    Tracer::getInstance();
+
     // Check command line arguments
     if (argc > 1) {
         std::string arg = argv[1];
 
         // Check if we're running in service mode
         if (arg == "--service") {
-            runService();
-            curl_global_cleanup();
-            return 0;
+            int result = runService();
+            cleanupNetworking();
+            return result;
         }
 
         // Check if we're running in interactive mode
         if (arg == "--interactive") {
             runInteractive();
-            curl_global_cleanup();
+            cleanupNetworking();
             return 0;
         }
 
         // Check for voice mode flag
         if (arg == "--voice") {
             runVoice();
-            curl_global_cleanup();
+            cleanupNetworking();
             return 0;
         }
 
         // Check for GUI mode flag
         if (arg == "--gui") {
             runGui(argc, argv);
-            curl_global_cleanup();
+            cleanupNetworking();
             return 0;
         }
 
         // Process other CLI commands
         CLIManager& cliManager = CLIManager::getInstance();
         int result = cliManager.parseAndExecute(argc, argv);
-        curl_global_cleanup();
+        cleanupNetworking();
         return result;
     }
 
@@ -386,6 +450,6 @@ int main(int argc, char* argv[]) {
     }
 
     // Clean up libcurl
-    curl_global_cleanup();
+    cleanupNetworking();
     return 0;
 }
@@ -0,0 +1,328 @@
+#include "include/service/AdmissionQueue.h"
+#include "include/config/ConfigManager.h"
+#include "include/utils/RateLimiter.h"
+#include <algorithm>
+
+namespace {
+    const long long DEFAULT_MAX_QUEUE = 1024;
+    const long long DEFAULT_QUANTUM = 1024;
+    const double DEFAULT_SHED_FACTOR = 4.0;
+    const long long DEFAULT_SLO_MS[] = { 500, 250, 30000 };
+    const char* const CLASS_NAMES[] = { "interactive", "voice", "batch" };
+
+    // Requests allowed to run when the RateLimiter is off
+    const size_t UNLIMITED_CAPACITY = 64;
+
+    // Order in which classes are served while none is past its objective
+    const RequestClass PRIORITY_ORDER[] = {
+        RequestClass::RC_VOICE, RequestClass::RC_INTERACTIVE, RequestClass::RC_BATCH
+    };
+
+    size_t rank(RequestClass requestClass) {
+        return static_cast<size_t>(std::find(std::begin(PRIORITY_ORDER), std::end(PRIORITY_ORDER), requestClass) -
+            std::begin(PRIORITY_ORDER));
+    }
+
+    double millisecondsBetween(AdmissionQueue::Clock::time_point from, AdmissionQueue::Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+}
+
+bool parseRequestClass(const std::string& name, RequestClass& requestClass) {
+    for (size_t i = 0; i < sizeof(CLASS_NAMES) / sizeof(CLASS_NAMES[0]); i++) {
+        if (name == CLASS_NAMES[i]) {
+            requestClass = static_cast<RequestClass>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+AdmissionQueue::AdmissionQueue() : waitingCount(0), nextSequence(0) {
+    ConfigManager& config = ConfigManager::getInstance();
+    configuredCapacity = static_cast<size_t>(std::max(0LL, config.getIntSetting("admission_max_in_flight", 0)));
+    maxQueue = static_cast<size_t>(std::max(1LL, config.getIntSetting("admission_max_queue", DEFAULT_MAX_QUEUE)));
+    quantum = static_cast<size_t>(std::max(1LL, config.getIntSetting("admission_quantum", DEFAULT_QUANTUM)));
+    try {
+        shedFactor = std::stod(config.getSetting("admission_shed_factor", "4"));
+    }
+    catch (...) {
+        shedFactor = DEFAULT_SHED_FACTOR;
+    }
+    shedFactor = std::max(1.0, shedFactor);
+
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        std::string setting = std::string("admission_slo_") + CLASS_NAMES[i] + "_ms";
+        classes[i].sloMs = static_cast<double>(std::max(1LL, config.getIntSetting(setting, DEFAULT_SLO_MS[i])));
+        classes[i].waitBuckets.assign(waitBucketBoundsMs().size() + 1, 0);
+    }
+}
+
+const std::vector<double>& AdmissionQueue::waitBucketBoundsMs() {
+    static const std::vector<double> bounds = {
+        1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000
+    };
+    return bounds;
+}
+
+void AdmissionQueue::submit(Request request) {
+    std::vector<std::function<void()>> starts;
+    const char* reason = nullptr;
+    Request evicted;
+    bool wasEvicted = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point now = Clock::now();
+        ClassQueue& queue = classes[static_cast<size_t>(request.requestClass)];
+
+        // A class whose oldest request is far past its objective is not
+        // catching up; more of the same would only wait longer
+        if (queue.size > 0 && millisecondsBetween(oldest(queue), now) > shedFactor * queue.sloMs) {
+            reason = "Service overloaded, request shed; retry later";
+        }
+        else if (waitingCount >= maxQueue) {
+            wasEvicted = evictBelow(request.requestClass, evicted);
+            if (!wasEvicted) {
+                reason = "Service queue is full; retry later";
+            }
+        }
+
+        if (reason) {
+            queue.shed++;
+        }
+        else {
+            std::deque<Waiting>& waiting = queue.clients[request.client];
+            if (waiting.empty()) {
+                queue.active.push_back(request.client);
+                queue.deficits[request.client] = 0;
+            }
+            waiting.push_back(Waiting{ std::move(request), now, nextSequence++ });
+            queue.size++;
+            waitingCount++;
+            collectStarts(starts);
+        }
+    }
+
+    if (wasEvicted) {
+        evicted.reject("Service overloaded, request gave way to a higher priority one; retry later");
+    }
+    if (reason) {
+        request.reject(reason);
+    }
+    for (auto& start : starts) {
+        start();
+    }
+}
+
+bool AdmissionQueue::finish(uint64_t owner, uint64_t id) {
+    std::vector<std::function<void()>> starts;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running.erase(std::make_pair(owner, id)) == 0) {
+            return false;
+        }
+        collectStarts(starts);
+    }
+    for (auto& start : starts) {
+        start();
+    }
+    return true;
+}
+
+void AdmissionQueue::rejectOwner(uint64_t owner, const std::string& reason) {
+    std::vector<Request> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        removeWaiting([owner](const Request& request) { return request.owner == owner; }, removed);
+    }
+    for (Request& request : removed) {
+        request.reject(reason);
+    }
+}
+
+void AdmissionQueue::rejectAll(const std::string& reason) {
+    std::vector<Request> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        removeWaiting([](const Request&) { return true; }, removed);
+    }
+    for (Request& request : removed) {
+        request.reject(reason);
+    }
+}
+
+AdmissionStats AdmissionQueue::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    AdmissionStats stats;
+    stats.running = running.size();
+    stats.capacity = capacity();
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        const ClassQueue& queue = classes[i];
+        AdmissionClassStats entry;
+        entry.name = CLASS_NAMES[i];
+        entry.sloMs = queue.sloMs;
+        entry.queued = queue.size;
+        entry.admitted = queue.admitted;
+        entry.shed = queue.shed;
+        entry.sloMisses = queue.sloMisses;
+        entry.waitSumMs = queue.waitSumMs;
+        entry.waitBuckets = queue.waitBuckets;
+        stats.classes.push_back(entry);
+    }
+    return stats;
+}
+
+size_t AdmissionQueue::capacity() const {
+    if (configuredCapacity > 0) {
+        return configuredCapacity;
+    }
+
+    // One above the limiter's limit, so it sees enough demand to raise it
+    RateLimiter& limiter = RateLimiter::getInstance();
+    if (!limiter.isEnabled()) {
+        return UNLIMITED_CAPACITY;
+    }
+    return static_cast<size_t>(std::max(1.0, limiter.getStats().concurrencyLimit)) + 1;
+}
+
+AdmissionQueue::Clock::time_point AdmissionQueue::oldest(const ClassQueue& queue) const {
+    Clock::time_point first = Clock::time_point::max();
+    for (const auto& client : queue.clients) {
+        if (!client.second.empty()) {
+            first = std::min(first, client.second.front().queuedAt);
+        }
+    }
+    return first;
+}
+
+size_t AdmissionQueue::pickClass(Clock::time_point now) const {
+    size_t chosen = CLASS_COUNT;
+    double mostOverdue = 1.0;
+    for (RequestClass requestClass : PRIORITY_ORDER) {
+        size_t index = static_cast<size_t>(requestClass);
+        const ClassQueue& queue = classes[index];
+        if (queue.size == 0) {
+            continue;
+        }
+        if (chosen == CLASS_COUNT) {
+            chosen = index;
+        }
+        double overdue = millisecondsBetween(oldest(queue), now) / queue.sloMs;
+        if (overdue > mostOverdue) {
+            mostOverdue = overdue;
+            chosen = index;
+        }
+    }
+    return chosen;
+}
+
+AdmissionQueue::Waiting AdmissionQueue::takeNext(ClassQueue& queue) {
+    // A client keeps the turn while its deficit covers its next request;
+    // otherwise it gets a quantum more and goes to the back
+    for (;;) {
+        const std::string client = queue.active.front();
+        std::deque<Waiting>& waiting = queue.clients[client];
+        size_t& deficit = queue.deficits[client];
+        size_t cost = waiting.front().request.cost;
+        if (deficit < cost) {
+            deficit += quantum;
+            queue.active.pop_front();
+            queue.active.push_back(client);
+            continue;
+        }
+
+        deficit -= cost;
+        Waiting next = std::move(waiting.front());
+        waiting.pop_front();
+        if (waiting.empty()) {
+            // An idle client does not save up turns
+            queue.clients.erase(client);
+            queue.deficits.erase(client);
+            queue.active.pop_front();
+        }
+        queue.size--;
+        waitingCount--;
+        return next;
+    }
+}
+
+bool AdmissionQueue::evictBelow(RequestClass requestClass, Request& evicted) {
+    for (size_t i = CLASS_COUNT; i-- > rank(requestClass) + 1;) {
+        ClassQueue& queue = classes[static_cast<size_t>(PRIORITY_ORDER[i])];
+        auto newest = queue.clients.end();
+        for (auto it = queue.clients.begin(); it != queue.clients.end(); ++it) {
+            if (newest == queue.clients.end() || it->second.back().sequence > newest->second.back().sequence) {
+                newest = it;
+            }
+        }
+        if (newest == queue.clients.end()) {
+            continue;
+        }
+
+        evicted = std::move(newest->second.back().request);
+        newest->second.pop_back();
+        if (newest->second.empty()) {
+            queue.active.erase(std::find(queue.active.begin(), queue.active.end(), newest->first));
+            queue.deficits.erase(newest->first);
+            queue.clients.erase(newest);
+        }
+        queue.size--;
+        queue.shed++;
+        waitingCount--;
+        return true;
+    }
+    return false;
+}
+
+void AdmissionQueue::removeWaiting(const std::function<bool(const Request&)>& matches, std::vector<Request>& removed) {
+    for (ClassQueue& queue : classes) {
+        for (auto it = queue.clients.begin(); it != queue.clients.end();) {
+            std::deque<Waiting>& waiting = it->second;
+            for (auto entry = waiting.begin(); entry != waiting.end();) {
+                if (matches(entry->request)) {
+                    removed.push_back(std::move(entry->request));
+                    entry = waiting.erase(entry);
+                    queue.size--;
+                    waitingCount--;
+                }
+                else {
+                    ++entry;
+                }
+            }
+            if (waiting.empty()) {
+                queue.active.erase(std::find(queue.active.begin(), queue.active.end(), it->first));
+                queue.deficits.erase(it->first);
+                it = queue.clients.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+}
+
+void AdmissionQueue::recordWait(ClassQueue& queue, double waitMs) {
+    const std::vector<double>& bounds = waitBucketBoundsMs();
+    size_t bucket = static_cast<size_t>(std::lower_bound(bounds.begin(), bounds.end(), waitMs) - bounds.begin());
+    queue.waitBuckets[bucket]++;
+    queue.waitSumMs += waitMs;
+    queue.admitted++;
+    if (waitMs > queue.sloMs) {
+        queue.sloMisses++;
+    }
+}
+
+void AdmissionQueue::collectStarts(std::vector<std::function<void()>>& starts) {
+    if (waitingCount == 0) {
+        return;
+    }
+    size_t limit = capacity();
+    Clock::time_point now = Clock::now();
+    while (waitingCount > 0 && running.size() < limit) {
+        ClassQueue& queue = classes[pickClass(now)];
+        Waiting next = takeNext(queue);
+        recordWait(queue, millisecondsBetween(next.queuedAt, now));
+        running.insert(std::make_pair(next.request.owner, next.request.id));
+        starts.push_back(std::move(next.request.start));
+    }
+}
@@ -0,0 +1,126 @@
+#include "include/service/RpcProtocol.h"
+#include <cstring>
+
+constexpr char RpcProtocol::MAGIC[4];
+
+size_t RpcProtocol::beginFrame(std::string& out, RpcType type) {
+    size_t frameStart = out.size();
+    out.append(4, '\0');
+    appendU8(out, static_cast<uint8_t>(type));
+    return frameStart;
+}
+
+void RpcProtocol::endFrame(std::string& out, size_t frameStart) {
+    uint32_t length = static_cast<uint32_t>(out.size() - frameStart - 4);
+    for (int i = 0; i < 4; i++) {
+        out[frameStart + i] = static_cast<char>(length >> (24 - 8 * i));
+    }
+}
+
+void RpcProtocol::appendU8(std::string& out, uint8_t value) {
+    out += static_cast<char>(value);
+}
+
+void RpcProtocol::appendU32(std::string& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out += static_cast<char>(value >> shift);
+    }
+}
+
+void RpcProtocol::appendU64(std::string& out, uint64_t value) {
+    appendU32(out, static_cast<uint32_t>(value >> 32));
+    appendU32(out, static_cast<uint32_t>(value));
+}
+
+void RpcProtocol::appendFloat(std::string& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendU32(out, bits);
+}
+
+void RpcProtocol::appendString(std::string& out, const std::string& value) {
+    appendU32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+bool RpcProtocol::takeFrame(std::string& buffer, RpcType& type, std::string& body, size_t maxSize, bool& invalid) {
+    invalid = false;
+    if (buffer.size() < 4) {
+        return false;
+    }
+
+    uint32_t length = 0;
+    for (int i = 0; i < 4; i++) {
+        length = (length << 8) | static_cast<unsigned char>(buffer[i]);
+    }
+    // A frame without even a type byte is as unusable as an oversized one
+    if (length == 0 || length > maxSize) {
+        invalid = true;
+        return false;
+    }
+    if (buffer.size() - 4 < length) {
+        return false;
+    }
+
+    type = static_cast<RpcType>(static_cast<unsigned char>(buffer[4]));
+    body.assign(buffer, 5, length - 1);
+    buffer.erase(0, 4 + static_cast<size_t>(length));
+    return true;
+}
+
+bool RpcReader::need(size_t size) {
+    if (failed || data.size() - offset < size) {
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+uint8_t RpcReader::readU8() {
+    if (!need(1)) {
+        return 0;
+    }
+    return static_cast<uint8_t>(data[offset++]);
+}
+
+uint32_t RpcReader::readU32() {
+    if (!need(4)) {
+        return 0;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value = (value << 8) | static_cast<unsigned char>(data[offset++]);
+    }
+    return value;
+}
+
+uint64_t RpcReader::readU64() {
+    uint64_t high = readU32();
+    return (high << 32) | readU32();
+}
+
+float RpcReader::readFloat() {
+    uint32_t bits = readU32();
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string RpcReader::readString() {
+    uint32_t size = readU32();
+    if (!need(size)) {
+        return std::string();
+    }
+    std::string value = data.substr(offset, size);
+    offset += size;
+    return value;
+}
+
+std::string RpcReader::readRest() {
+    if (failed) {
+        return std::string();
+    }
+    std::string value = data.substr(offset);
+    offset = data.size();
+    return value;
+}
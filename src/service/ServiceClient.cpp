@@ -0,0 +1,255 @@
+#include "include/service/ServiceClient.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+    // Replies are bounded by what the daemon accepts as requests plus the
+    // model's output; this only stops a broken stream from eating memory
+    const size_t MAX_FRAME = 64 * 1024 * 1024;
+}
+
+ServiceClient::ServiceClient() : fd(-1), nextId(1) {
+}
+
+ServiceClient::~ServiceClient() {
+    disconnect();
+}
+
+bool ServiceClient::isConnected() const {
+    return fd >= 0;
+}
+
+#ifdef __linux__
+
+bool ServiceClient::connect(const std::string& socketPath) {
+    disconnect();
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        !sendAll(std::string(RpcProtocol::MAGIC, sizeof(RpcProtocol::MAGIC)))) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void ServiceClient::disconnect() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    input.clear();
+}
+
+bool ServiceClient::getStatus(ServiceStatus& status, int timeoutMs) {
+    std::string frame;
+    size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_STATUS);
+    RpcProtocol::endFrame(frame, start);
+    if (!sendAll(frame)) {
+        return false;
+    }
+
+    RpcType type;
+    std::string body;
+    if (!readFrame(type, body, timeoutMs) || type != RpcType::RPC_STATUS_REPLY) {
+        disconnect();
+        return false;
+    }
+
+    RpcReader reader(body);
+    status.pid = static_cast<long long>(reader.readU64());
+    status.stats.uptimeSeconds = reader.readU64() / 1000.0;
+    status.stats.connections = static_cast<size_t>(reader.readU64());
+    status.stats.acceptedConnections = static_cast<size_t>(reader.readU64());
+    status.stats.requests = static_cast<size_t>(reader.readU64());
+    status.stats.activeRequests = static_cast<size_t>(reader.readU64());
+    return reader.ok();
+}
+
+bool ServiceClient::getMetrics(std::string& text, int timeoutMs) {
+    std::string frame;
+    size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_METRICS);
+    RpcProtocol::endFrame(frame, start);
+    if (!sendAll(frame)) {
+        return false;
+    }
+
+    RpcType type;
+    if (!readFrame(type, text, timeoutMs) || type != RpcType::RPC_METRICS_REPLY) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool ServiceClient::getTrace(std::string& json, int timeoutMs) {
+    std::string frame;
+    size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_TRACE);
+    RpcProtocol::endFrame(frame, start);
+    if (!sendAll(frame)) {
+        return false;
+    }
+
+    RpcType type;
+    if (!readFrame(type, json, timeoutMs) || type != RpcType::RPC_TRACE_REPLY) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool ServiceClient::chat(const ConversationHistory& messages,
+    std::function<void(const std::string&)> onDelta,
+    std::string& reply,
+    const std::string& model,
+    float temperature,
+    int maxTokens) {
+    uint32_t id = nextId++;
+    std::string frame;
+    size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_CHAT);
+    RpcProtocol::appendU32(frame, id);
+    RpcProtocol::appendU8(frame, onDelta ? RpcProtocol::CHAT_STREAM : 0);
+    RpcProtocol::appendFloat(frame, temperature);
+    RpcProtocol::appendU32(frame, static_cast<uint32_t>(maxTokens));
+    RpcProtocol::appendString(frame, model);
+    RpcProtocol::appendU32(frame, static_cast<uint32_t>(messages.size()));
+    for (const Message& message : messages) {
+        RpcProtocol::appendString(frame, message.getRole());
+        RpcProtocol::appendString(frame, message.getContent());
+    }
+    RpcProtocol::endFrame(frame, start);
+    if (!sendAll(frame)) {
+        return false;
+    }
+
+    for (;;) {
+        RpcType type;
+        std::string body;
+        if (!readFrame(type, body, -1)) {
+            disconnect();
+            return false;
+        }
+
+        RpcReader reader(body);
+        uint32_t replyId = reader.readU32();
+        if (type == RpcType::RPC_DELTA && replyId == id) {
+            if (onDelta) {
+                onDelta(reader.readRest());
+            }
+        }
+        else if (type == RpcType::RPC_REPLY && replyId == id) {
+            reader.readU8();
+            reply = reader.readRest();
+            return reader.ok();
+        }
+        else if (type == RpcType::RPC_ERROR && (replyId == id || replyId == 0)) {
+            // Refused, e.g. while the daemon shuts down; id 0 fails the whole connection
+            reply = reader.readRest();
+            return false;
+        }
+    }
+}
+
+bool ServiceClient::sendAll(const std::string& data) {
+    size_t sent = 0;
+    while (fd >= 0 && sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            disconnect();
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return fd >= 0;
+}
+
+bool ServiceClient::readFrame(RpcType& type, std::string& body, int timeoutMs) {
+    char buffer[16 * 1024];
+    for (;;) {
+        bool invalid;
+        if (RpcProtocol::takeFrame(input, type, body, MAX_FRAME, invalid)) {
+            return true;
+        }
+        if (invalid || fd < 0) {
+            return false;
+        }
+
+        pollfd readable{ fd, POLLIN, 0 };
+        int ready = poll(&readable, 1, timeoutMs);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            return false;
+        }
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        input.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+#else
+
+// The daemon needs epoll, so there is never one to talk to elsewhere
+bool ServiceClient::connect(const std::string&) {
+    return false;
+}
+
+void ServiceClient::disconnect() {
+}
+
+bool ServiceClient::getStatus(ServiceStatus&, int) {
+    return false;
+}
+
+bool ServiceClient::getMetrics(std::string&, int) {
+    return false;
+}
+
+bool ServiceClient::getTrace(std::string&, int) {
+    return false;
+}
+
+bool ServiceClient::chat(const ConversationHistory&,
+    std::function<void(const std::string&)>,
+    std::string&,
+    const std::string&,
+    float,
+    int) {
+    return false;
+}
+
+bool ServiceClient::sendAll(const std::string&) {
+    return false;
+}
+
+bool ServiceClient::readFrame(RpcType&, std::string&, int) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,1723 @@
+#include "include/service/ServiceDaemon.h"
+#include "include/service/RpcProtocol.h"
+#include "include/config/ConfigManager.h"
+#include "include/utils/DeepSeekAPI.h"
+#include "include/utils/ErrorHandler.h"
+#include "include/utils/AsyncLogger.h"
+#include "include/utils/Executor.h"
+#include "include/utils/CurlHandlePool.h"
+#include "include/utils/Metrics.h"
+#include "include/utils/Tracer.h"
+#include "include/utils/RateLimiter.h"
+#include "include/utils/RequestCoalescer.h"
+#include "include/utils/RequestEngine.h"
+#include "include/utils/RequestHedger.h"
+#include "include/utils/DeltaExtractor.h"
+#include "include/utils/JsonWriter.h"
+#include "include/utils/ResponseCache.h"
+#include "include/utils/SseParser.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using json = nlohmann::json;
+
+namespace {
+    const long long DEFAULT_MAX_CONNECTIONS = 256;
+    const long long DEFAULT_MAX_REQUEST_KB = 8192;
+    const long long DEFAULT_DRAIN_SECONDS = 10;
+
+    // Time allowed for cancelled requests to report back once the drain timed out
+    const std::chrono::seconds CANCEL_GRACE(2);
+
+    // epoll tags below FIRST_CONNECTION_ID; connections count up from there
+    const uint64_t TAG_UNIX_LISTENER = 1;
+    const uint64_t TAG_TCP_LISTENER = 2;
+    const uint64_t TAG_SIGNAL = 3;
+    const uint64_t TAG_WAKE = 4;
+    const uint64_t FIRST_CONNECTION_ID = 16;
+
+    const size_t READ_CHUNK = 64 * 1024;
+    const size_t MAX_HTTP_HEAD = 64 * 1024;
+
+    // Reply tokens assumed for admission when a request sets no max_tokens
+    const size_t DEFAULT_REPLY_TOKENS = 1000;
+
+    // A streamed reply the client reads slower than it arrives is dropped
+    // once this much of it waits to be sent
+    const size_t MAX_SINK_BACKLOG = 16 * 1024 * 1024;
+
+    enum class WireProtocol {
+        WP_UNKNOWN,
+        WP_JSON_LINES,
+        WP_HTTP,
+        WP_RPC
+    };
+
+    // Replies may carry invalid UTF-8 from a truncated stream; replace it
+    // rather than fail the whole line
+    void appendJsonString(std::string& out, const std::string& text) {
+        try {
+            JsonWriter::appendString(out, text);
+        }
+        catch (const json::exception&) {
+            out += json(text).dump(-1, ' ', false, json::error_handler_t::replace);
+        }
+    }
+
+    std::string replyLine(const std::string& prefix, const std::string& reply, bool stream) {
+        bool ok = !isErrorReply(reply);
+        std::string line = prefix;
+        line += stream ? ",\"done\":true,\"ok\":" : ",\"ok\":";
+        JsonWriter::appendBool(line, ok);
+        line += ok ? ",\"reply\":" : ",\"error\":";
+        appendJsonString(line, reply);
+        line += "}\n";
+        return line;
+    }
+
+    std::string errorLine(const std::string& idText, const std::string& error) {
+        std::string line = "{\"id\":" + idText + ",\"ok\":false,\"error\":";
+        appendJsonString(line, error);
+        line += "}\n";
+        return line;
+    }
+
+    // Rough token count of a request, for the admission queue to weigh it by
+    size_t estimateCost(size_t promptBytes, int maxTokens) {
+        return promptBytes / 4 + (maxTokens > 0 ? static_cast<size_t>(maxTokens) : DEFAULT_REPLY_TOKENS);
+    }
+
+    std::string rpcText(RpcType type, uint32_t id, const std::string& text) {
+        std::string frame;
+        size_t start = RpcProtocol::beginFrame(frame, type);
+        RpcProtocol::appendU32(frame, id);
+        frame += text;
+        RpcProtocol::endFrame(frame, start);
+        return frame;
+    }
+
+    std::string rpcReply(uint32_t id, const std::string& reply) {
+        std::string frame;
+        size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_REPLY);
+        RpcProtocol::appendU32(frame, id);
+        RpcProtocol::appendU8(frame, isErrorReply(reply) ? 0 : 1);
+        frame += reply;
+        RpcProtocol::endFrame(frame, start);
+        return frame;
+    }
+
+    std::string toLower(std::string text) {
+        for (char& c : text) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return text;
+    }
+
+    const char* statusReason(long status) {
+        switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 402: return "Payment Required";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 415: return "Unsupported Media Type";
+        case 422: return "Unprocessable Entity";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return status < 400 ? "OK" : "Error";
+        }
+    }
+
+    // A Host header naming the loopback; absent, as HTTP/1.0 allows, also passes
+    bool isLoopbackHost(const std::string& host) {
+        std::string name = toLower(host);
+        if (!name.empty() && name[0] == '[') {
+            name = name.substr(1, name.find(']') - 1);
+        }
+        else {
+            name = name.substr(0, name.find(':'));
+        }
+        // 127.0.0.0/8 written as an address, not a name that merely starts with 127.
+        bool loopbackAddress = name.compare(0, 4, "127.") == 0 &&
+            name.find_first_not_of("0123456789.") == std::string::npos;
+        return name.empty() || name == "localhost" || name == "::1" || loopbackAddress;
+    }
+
+    std::string httpResponse(long status, const std::string& contentType, const std::string& body,
+        bool keepAlive, const char* extraHeaders = "") {
+        std::string response = "HTTP/1.1 " + std::to_string(status) + " " + statusReason(status) + "\r\n";
+        response += "Content-Type: " + contentType + "\r\n";
+        response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        response += extraHeaders;
+        response += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        response += body;
+        return response;
+    }
+
+    // Error body in the shape OpenAI clients expect
+    std::string httpError(long status, const std::string& message, const char* type, bool keepAlive,
+        const char* extraHeaders = "") {
+        std::string body = "{\"error\":{\"message\":";
+        appendJsonString(body, message);
+        body += ",\"type\":\"";
+        body += type;
+        body += "\"}}";
+        return httpResponse(status, "application/json", body, keepAlive, extraHeaders);
+    }
+
+    std::string streamHead(bool keepAlive) {
+        std::string head = "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/event-stream\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Transfer-Encoding: chunked\r\n";
+        head += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        return head;
+    }
+
+    // A reply that was not streamed: the upstream status and body as they
+    // are, or a gateway error if the transfer failed
+    std::string upstreamReply(long status, const std::string& body, const std::string& error, bool keepAlive) {
+        if (status != 0) {
+            return httpResponse(status, "application/json", body, keepAlive);
+        }
+        if (error == "Deadline exceeded") {
+            return httpError(504, "Upstream request timed out", "upstream_error", keepAlive);
+        }
+        return httpError(502, "Upstream request failed: " + error, "upstream_error", keepAlive);
+    }
+
+    json completionObject(const char* object, const std::string& model, uint64_t serial) {
+        return json{
+            { "id", "chatcmpl-pichat-" + std::to_string(serial) },
+            { "object", object },
+            { "created", static_cast<long long>(std::time(nullptr)) },
+            { "model", model }
+        };
+    }
+
+    // Replies from the response cache, shaped like those of the API
+    std::string cachedCompletion(const std::string& model, const std::string& reply, uint64_t serial) {
+        json completion = completionObject("chat.completion", model, serial);
+        completion["choices"] = json::array({ {
+            { "index", 0 },
+            { "message", { { "role", "assistant" }, { "content", reply } } },
+            { "finish_reason", "stop" } } });
+        return completion.dump(-1, ' ', false, json::error_handler_t::replace);
+    }
+
+    std::string cachedStream(const std::string& model, const std::string& reply, uint64_t serial) {
+        json chunk = completionObject("chat.completion.chunk", model, serial);
+        chunk["choices"] = json::array({ {
+            { "index", 0 },
+            { "delta", { { "role", "assistant" }, { "content", reply } } },
+            { "finish_reason", nullptr } } });
+        std::string events = "data: " + chunk.dump(-1, ' ', false, json::error_handler_t::replace) + "\n\n";
+        chunk["choices"][0]["delta"] = json::object();
+        chunk["choices"][0]["finish_reason"] = "stop";
+        events += "data: " + chunk.dump() + "\n\n";
+        events += "data: [DONE]\n\n";
+        return events;
+    }
+
+    // Reassembles a relayed stream, for the response cache
+    struct StreamCollector {
+        std::string text;
+        StreamDelta delta;
+        SseParser parser;
+
+        StreamCollector()
+            : parser([this](std::string_view data) {
+                if (DeltaExtractor::extract(data, delta) && delta.hasContent) {
+                    text += delta.content;
+                }
+            }) {
+        }
+    };
+}
+
+struct ServiceDaemon::Connection {
+    uint64_t id;
+    int fd;
+    std::string input;
+    std::string output;
+    size_t outputOffset = 0;  // Bytes of output already sent
+    bool readClosed = false;  // Client finished sending; close once its replies are out
+    uint32_t events = 0;  // epoll interest set, filled in when registered
+    bool tcp = false;  // Accepted on the TCP port, which only serves HTTP
+    uint64_t nextRequest = 1;
+    std::unordered_map<uint64_t, CancellationToken> requests;  // In flight
+    WireProtocol protocol = WireProtocol::WP_UNKNOWN;
+    bool rpcGreeted = false;  // RPC client sent RpcProtocol::MAGIC
+
+    // HTTP requests are answered one at a time, in order
+    bool httpBusy = false;
+    bool httpKeepAlive = true;
+    std::shared_ptr<DirectSink> sink;  // Reply being streamed by the engine thread
+};
+
+struct ServiceDaemon::HttpHead {
+    std::string method;
+    std::string target;
+    std::string version;
+    std::vector<std::pair<std::string, std::string>> headers;  // Names in lower case
+
+    std::string header(const char* name) const {
+        for (const auto& entry : headers) {
+            if (entry.first == name) {
+                return entry.second;
+            }
+        }
+        return std::string();
+    }
+
+    bool parse(const std::string& text) {
+        size_t lineEnd = text.find("\r\n");
+        std::string requestLine = text.substr(0, lineEnd);
+        size_t first = requestLine.find(' ');
+        size_t last = requestLine.rfind(' ');
+        if (first == std::string::npos || last == first) {
+            return false;
+        }
+        method = requestLine.substr(0, first);
+        target = requestLine.substr(first + 1, last - first - 1);
+        version = requestLine.substr(last + 1);
+        if (version.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+
+        while (lineEnd != std::string::npos) {
+            size_t start = lineEnd + 2;
+            lineEnd = text.find("\r\n", start);
+            std::string line = text.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+            size_t colon = line.find(':');
+            if (colon == std::string::npos || colon == 0) {
+                return false;
+            }
+            size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+            size_t valueEnd = line.find_last_not_of(" \t");
+            std::string value = valueStart == std::string::npos ? std::string()
+                : line.substr(valueStart, valueEnd - valueStart + 1);
+            headers.emplace_back(toLower(line.substr(0, colon)), value);
+        }
+        return true;
+    }
+};
+
+// Streamed HTTP reply, written to the client socket straight from the
+// engine thread. The loop detaches it under the mutex before it closes or
+// reuses the socket.
+struct ServiceDaemon::DirectSink {
+    std::mutex mutex;
+    int fd = -1;              // -1 once detached
+    uint64_t connection = 0;
+    uint64_t request = 0;
+    bool keepAlive = true;
+    bool headSent = false;
+    std::string pending;      // Bytes the socket did not take yet, for the loop to send
+};
+
+ServiceDaemon& ServiceDaemon::getInstance() {
+    static ServiceDaemon instance;
+    return instance;
+}
+
+ServiceDaemon::ServiceDaemon()
+    : epollFd(-1),
+      signalFd(-1),
+      wakeFd(-1),
+      unixListener(-1),
+      tcpListener(-1),
+      nextConnectionId(FIRST_CONNECTION_ID),
+      activeRequests(0),
+      nextCompletionId(1),
+      draining(false),
+      stopRequested(false),
+      connectionCount(0),
+      acceptedCount(0),
+      requestCount(0),
+      activeCount(0) {
+    ConfigManager& config = ConfigManager::getInstance();
+    socketPath = getSocketPath();
+    tcpPort = static_cast<int>(config.getIntSetting("service_tcp_port", 0));
+    maxConnections = static_cast<size_t>(std::max(1LL, config.getIntSetting("service_max_connections", DEFAULT_MAX_CONNECTIONS)));
+    maxRequestBytes = static_cast<size_t>(std::max(1LL, config.getIntSetting("service_max_request_kb", DEFAULT_MAX_REQUEST_KB))) * 1024;
+    drainTimeout = std::chrono::seconds(std::max(0LL, config.getIntSetting("service_drain_seconds", DEFAULT_DRAIN_SECONDS)));
+    httpToken = config.getSetting("service_http_token", "");
+    registerMetrics();
+}
+
+std::string ServiceDaemon::getSocketPath() {
+    ConfigManager& config = ConfigManager::getInstance();
+    return config.getSetting("service_socket", config.getConfigDirectory() + "/pichat.sock");
+}
+
+ServiceStats ServiceDaemon::getStats() const {
+    ServiceStats stats;
+    stats.connections = connectionCount.load();
+    stats.acceptedConnections = acceptedCount.load();
+    stats.requests = requestCount.load();
+    stats.activeRequests = activeCount.load();
+    stats.uptimeSeconds = std::chrono::duration<double>(Clock::now() - startedAt).count();
+    return stats;
+}
+
+AdmissionStats ServiceDaemon::getAdmissionStats() const {
+    return admission.getStats();
+}
+
+void ServiceDaemon::registerMetrics() {
+    Metrics& metrics = Metrics::getInstance();
+
+    metrics.addCollector([this](std::string& out) {
+        ServiceStats stats = getStats();
+        Metrics::appendGauge(out, "pichat_service_connections", "Clients connected now", stats.connections);
+        Metrics::appendCounter(out, "pichat_service_connections_total", "Clients accepted since start", stats.acceptedConnections);
+        Metrics::appendCounter(out, "pichat_service_requests_total", "Requests received since start", stats.requests);
+        Metrics::appendGauge(out, "pichat_service_active_requests", "Requests waiting for their reply", stats.activeRequests);
+        Metrics::appendGauge(out, "pichat_service_uptime_seconds", "Time since the service started", stats.uptimeSeconds);
+
+        AdmissionStats queue = getAdmissionStats();
+        Metrics::appendGauge(out, "pichat_admission_running", "Admitted requests not finished yet", queue.running);
+        Metrics::appendGauge(out, "pichat_admission_capacity", "Requests allowed to run at once", queue.capacity);
+        struct PerClass {
+            const char* name;
+            const char* help;
+            const char* type;
+            size_t AdmissionClassStats::* field;
+        };
+        static const PerClass perClass[] = {
+            { "pichat_admission_queue_depth", "Requests waiting for admission", "gauge", &AdmissionClassStats::queued },
+            { "pichat_admission_admitted_total", "Requests admitted", "counter", &AdmissionClassStats::admitted },
+            { "pichat_admission_shed_total", "Requests refused or evicted under load", "counter", &AdmissionClassStats::shed },
+            { "pichat_admission_slo_misses_total", "Requests admitted after their queue-time objective", "counter",
+                &AdmissionClassStats::sloMisses }
+        };
+        for (const PerClass& entry : perClass) {
+            Metrics::appendHeader(out, entry.name, entry.help, entry.type);
+            for (const AdmissionClassStats& stats : queue.classes) {
+                Metrics::appendSample(out, entry.name, "class=\"" + stats.name + "\"", static_cast<double>(stats.*entry.field));
+            }
+        }
+        Metrics::appendHeader(out, "pichat_admission_wait_seconds", "Time requests waited for admission", "histogram");
+        std::vector<double> bounds;
+        for (double bound : AdmissionQueue::waitBucketBoundsMs()) {
+            bounds.push_back(bound / 1000);
+        }
+        for (const AdmissionClassStats& stats : queue.classes) {
+            Metrics::appendBuckets(out, "pichat_admission_wait_seconds", "class=\"" + stats.name + "\"",
+                bounds, stats.waitBuckets, stats.waitSumMs / 1000);
+        }
+    });
+
+    // Components the daemon drives, which keep their own counters
+    metrics.addCollector([](std::string& out) {
+        ExecutorStats executor = Executor::getInstance().getStats();
+        Metrics::appendGauge(out, "pichat_executor_workers", "Executor threads", executor.workers);
+        Metrics::appendGauge(out, "pichat_executor_queue_depth", "Executor tasks waiting", executor.queued);
+        Metrics::appendGauge(out, "pichat_executor_max_worker_queue_depth", "Executor tasks waiting on the busiest worker",
+            executor.maxQueueDepth);
+        Metrics::appendGauge(out, "pichat_executor_active_tasks", "Executor tasks running", executor.active);
+        Metrics::appendCounter(out, "pichat_executor_tasks_total", "Executor tasks run", executor.executed);
+        Metrics::appendCounter(out, "pichat_executor_stolen_tasks_total", "Executor tasks run by another worker",
+            executor.stolen);
+
+        RateLimiterStats limiter = RateLimiter::getInstance().getStats();
+        Metrics::appendGauge(out, "pichat_limiter_concurrency_limit", "Current AIMD concurrency limit", limiter.concurrencyLimit);
+        Metrics::appendGauge(out, "pichat_limiter_in_flight", "Requests past the rate limiter", limiter.inFlight);
+        Metrics::appendGauge(out, "pichat_limiter_queue_depth", "Requests waiting for a slot, a token or a backoff",
+            limiter.queued);
+        Metrics::appendGauge(out, "pichat_limiter_requests_per_second", "Token bucket rate, 0 if unlimited",
+            limiter.requestsPerSecond);
+        Metrics::appendCounter(out, "pichat_limiter_throttled_total", "429 and 503 responses", limiter.throttled);
+        Metrics::appendCounter(out, "pichat_limiter_retries_total", "Requests retried after throttling", limiter.retries);
+        Metrics::appendCounter(out, "pichat_limiter_exhausted_total", "Requests that ran out of retries", limiter.exhausted);
+
+        CoalescerStats coalescer = RequestCoalescer::getInstance().getStats();
+        Metrics::appendCounter(out, "pichat_coalescer_flights_total", "Upstream calls made by the coalescer", coalescer.flights);
+        Metrics::appendCounter(out, "pichat_coalescer_saved_calls_total", "Requests that joined a call in flight",
+            coalescer.savedCalls);
+        Metrics::appendGauge(out, "pichat_coalescer_in_flight", "Coalesced calls running", coalescer.inFlight);
+
+        HedgeStats hedger = RequestHedger::getInstance().getStats();
+        Metrics::appendCounter(out, "pichat_hedger_requests_total", "Requests sent while hedging was on", hedger.requests);
+        Metrics::appendCounter(out, "pichat_hedger_hedged_total", "Requests that sent a duplicate", hedger.hedged);
+        Metrics::appendCounter(out, "pichat_hedger_wins_total", "Duplicates that answered first", hedger.hedgeWins);
+        Metrics::appendCounter(out, "pichat_hedger_skipped_total", "Duplicates not sent because the rate limiter had no room",
+            hedger.hedgesSkipped);
+        Metrics::appendCounter(out, "pichat_hedger_saved_seconds_total", "Estimated latency saved by hedging",
+            hedger.latencySavedMs / 1000);
+
+        CacheStats cache = ResponseCache::getInstance().getStats();
+        Metrics::appendHeader(out, "pichat_cache_hits_total", "Replies served from the response cache", "counter");
+        Metrics::appendSample(out, "pichat_cache_hits_total", "tier=\"memory\"", static_cast<double>(cache.memoryHits));
+        Metrics::appendSample(out, "pichat_cache_hits_total", "tier=\"disk\"", static_cast<double>(cache.diskHits));
+        Metrics::appendCounter(out, "pichat_cache_misses_total", "Response cache lookups that missed", cache.misses);
+        Metrics::appendCounter(out, "pichat_cache_stores_total", "Replies written to the response cache", cache.stores);
+        Metrics::appendCounter(out, "pichat_cache_evictions_total", "In-memory entries dropped for capacity", cache.evictions);
+        Metrics::appendGauge(out, "pichat_cache_memory_entries", "Entries in the in-memory cache", cache.memoryEntries);
+
+        CurlPoolStats pool = CurlHandlePool::getInstance().getStats();
+        Metrics::appendCounter(out, "pichat_curl_pool_hits_total", "Handles reused from the pool", pool.hits);
+        Metrics::appendCounter(out, "pichat_curl_pool_misses_total", "Handles created", pool.misses);
+        Metrics::appendGauge(out, "pichat_curl_pool_idle", "Idle handles in the pool", pool.idle);
+        Metrics::appendGauge(out, "pichat_engine_active_transfers", "Transfers queued or in flight on the request engine",
+            RequestEngine::getInstance().activeTransfers());
+
+        AsyncLoggerStats logger = AsyncLogger::getInstance().getStats();
+        Metrics::appendGauge(out, "pichat_log_queue_depth", "Log lines waiting to be written", logger.queued);
+        Metrics::appendCounter(out, "pichat_log_lines_total", "Log lines written", logger.written);
+        Metrics::appendCounter(out, "pichat_log_dropped_total", "Log lines dropped because the log queue was full",
+            logger.dropped);
+
+        ErrorHandler& errors = ErrorHandler::getInstance();
+        Metrics::appendHeader(out, "pichat_log_records_total", "Records logged through the ErrorHandler", "counter");
+        const std::pair<ErrorLevel, const char*> levels[] = {
+            { ErrorLevel::EL_INFO, "info" }, { ErrorLevel::EL_WARNING, "warning" },
+            { ErrorLevel::EL_ERROR, "error" }, { ErrorLevel::EL_FATAL, "fatal" }
+        };
+        for (const auto& level : levels) {
+            Metrics::appendSample(out, "pichat_log_records_total", std::string("level=\"") + level.second + "\"",
+                static_cast<double>(errors.getErrorCount(level.first)));
+        }
+    });
+}
+
+#ifdef __linux__
+
+int ServiceDaemon::run() {
+    ErrorHandler& errorHandler = ErrorHandler::getInstance();
+    startedAt = Clock::now();
+
+    apiKey = ConfigManager::getInstance().getApiKey();
+    if (apiKey.empty()) {
+        errorHandler.logError("API key not set. Use --set-key to configure.", "ServiceDaemon");
+        std::cerr << "Error: API key not set. Use --set-key to configure." << std::endl;
+        return 1;
+    }
+
+    // Any local process, and any web page through the browser, can reach a
+    // loopback port; the Unix socket is protected by its file mode instead
+    if (tcpPort > 0 && httpToken.empty()) {
+        errorHandler.logError("service_tcp_port needs service_http_token to be set", "ServiceDaemon");
+        std::cerr << "Error: set service_http_token before enabling service_tcp_port." << std::endl;
+        return 1;
+    }
+
+    // Threads started from here on inherit the mask, so the signals only
+    // ever arrive through the signalfd
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGTERM);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigset_t previousMask;
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, &previousMask);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    signalFd = signalfd(-1, &shutdownSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || signalFd < 0 || wakeFd < 0 || !openListeners()) {
+        errorHandler.logError(std::string("Failed to start service: ") + std::strerror(errno), "ServiceDaemon");
+        std::cerr << "Failed to start PiChat service" << std::endl;
+        closeListeners();
+        for (int fd : { epollFd, signalFd, wakeFd }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+        return 1;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = TAG_SIGNAL;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event);
+    event.data.u64 = TAG_WAKE;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    warmUpChatConnection(apiKey);
+
+    std::cout << "PiChat service listening on " << socketPath;
+    if (tcpListener >= 0) {
+        std::cout << " and 127.0.0.1:" << tcpPort;
+    }
+    std::cout << std::endl;
+    errorHandler.logInfo("Service started on " + socketPath, "ServiceDaemon");
+
+    bool cancelled = false;
+    epoll_event events[64];
+    for (;;) {
+        if (stopRequested.load() && !draining) {
+            beginShutdown();
+        }
+
+        int timeoutMs = -1;
+        if (draining) {
+            if (activeRequests == 0 && flushed()) {
+                break;
+            }
+
+            Clock::time_point now = Clock::now();
+            if (!cancelled && now >= drainDeadline) {
+                // Out of patience: cancelled requests still report back, briefly
+                cancelAll();
+                cancelled = true;
+                drainDeadline = now + CANCEL_GRACE;
+            }
+            else if (cancelled && now >= drainDeadline) {
+                break;
+            }
+            timeoutMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(drainDeadline - now).count()) + 1;
+        }
+
+        int count = epoll_wait(epollFd, events, 64, timeoutMs);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errorHandler.logError(std::string("epoll_wait failed: ") + std::strerror(errno), "ServiceDaemon");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            uint64_t tag = events[i].data.u64;
+            if (tag == TAG_UNIX_LISTENER) {
+                acceptClients(unixListener);
+            }
+            else if (tag == TAG_TCP_LISTENER) {
+                acceptClients(tcpListener);
+            }
+            else if (tag == TAG_SIGNAL) {
+                signalfd_siginfo info;
+                while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+                }
+                beginShutdown();
+            }
+            else if (tag == TAG_WAKE) {
+                deliverOutgoing();
+            }
+            else if (connections.count(tag)) {
+                if (events[i].events & EPOLLERR) {
+                    closeClient(tag);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) {
+                    writeClient(tag);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP)) {
+                    readClient(tag);
+                }
+                // Hung up both ways: the replies have nowhere to go
+                if ((events[i].events & EPOLLHUP) && connections.count(tag)) {
+                    closeClient(tag);
+                }
+            }
+        }
+    }
+
+    cancelAll();
+    std::vector<uint64_t> remaining;
+    for (const auto& entry : connections) {
+        remaining.push_back(entry.first);
+    }
+    for (uint64_t id : remaining) {
+        closeClient(id);
+    }
+    closeListeners();
+
+    // Drop what cancelled requests still post; nobody will read it
+    {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        outbox.clear();
+    }
+    close(signalFd);
+    close(wakeFd);
+    close(epollFd);
+    signalFd = wakeFd = epollFd = -1;
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+
+    std::cout << "PiChat service stopped" << std::endl;
+    errorHandler.logInfo("Service stopped", "ServiceDaemon");
+    return 0;
+}
+
+void ServiceDaemon::stop() {
+    stopRequested = true;
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+bool ServiceDaemon::openListeners() {
+    sockaddr_un unixAddress{};
+    unixAddress.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(unixAddress.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memcpy(unixAddress.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    unixListener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (unixListener < 0) {
+        return false;
+    }
+
+    // A socket file nobody accepts on is left over from a crash; one that
+    // accepts belongs to a daemon that is still running
+    if (connect(unixListener, reinterpret_cast<sockaddr*>(&unixAddress), sizeof(unixAddress)) == 0 ||
+        errno == EAGAIN || errno == EINPROGRESS) {
+        close(unixListener);
+        unixListener = -1;
+        errno = EADDRINUSE;
+        return false;
+    }
+    close(unixListener);
+    unlink(socketPath.c_str());
+
+    // Only the owner may talk to the daemon, which holds the API key
+    unixListener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    mode_t previousUmask = umask(077);
+    int bound = bind(unixListener, reinterpret_cast<sockaddr*>(&unixAddress), sizeof(unixAddress));
+    umask(previousUmask);
+    if (bound < 0 || listen(unixListener, SOMAXCONN) < 0) {
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = TAG_UNIX_LISTENER;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, unixListener, &event);
+
+    if (tcpPort > 0) {
+        tcpListener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (tcpListener < 0) {
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(tcpListener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in tcpAddress{};
+        tcpAddress.sin_family = AF_INET;
+        tcpAddress.sin_port = htons(static_cast<uint16_t>(tcpPort));
+        tcpAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(tcpListener, reinterpret_cast<sockaddr*>(&tcpAddress), sizeof(tcpAddress)) < 0 ||
+            listen(tcpListener, SOMAXCONN) < 0) {
+            return false;
+        }
+
+        event.data.u64 = TAG_TCP_LISTENER;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, tcpListener, &event);
+    }
+    return true;
+}
+
+void ServiceDaemon::closeListeners() {
+    if (unixListener >= 0) {
+        close(unixListener);
+        unixListener = -1;
+        unlink(socketPath.c_str());
+    }
+    if (tcpListener >= 0) {
+        close(tcpListener);
+        tcpListener = -1;
+    }
+}
+
+void ServiceDaemon::acceptClients(int listener) {
+    for (;;) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+
+        if (connections.size() >= maxConnections) {
+            close(fd);
+            continue;
+        }
+        if (listener == tcpListener) {
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->id = nextConnectionId++;
+        connection->fd = fd;
+        connection->tcp = listener == tcpListener;
+
+        connection->events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection->events;
+        event.data.u64 = connection->id;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+
+        connections.emplace(connection->id, std::move(connection));
+        connectionCount = connections.size();
+        acceptedCount++;
+    }
+}
+
+void ServiceDaemon::readClient(uint64_t id) {
+    Connection* connection = connections[id].get();
+    char buffer[READ_CHUNK];
+    for (;;) {
+        ssize_t n = read(connection->fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            connection->input.append(buffer, static_cast<size_t>(n));
+            if (static_cast<size_t>(n) < sizeof(buffer)) {
+                break;
+            }
+            continue;
+        }
+        if (n == 0) {
+            connection->readClosed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        closeClient(id);
+        return;
+    }
+
+    if (connection->protocol == WireProtocol::WP_UNKNOWN) {
+        size_t first = connection->input.find_first_not_of(" \t\r\n");
+        if (first != std::string::npos) {
+            char c = connection->input[first];
+            connection->protocol = c == '\0' ? WireProtocol::WP_RPC
+                : c >= 'A' && c <= 'Z' ? WireProtocol::WP_HTTP : WireProtocol::WP_JSON_LINES;
+        }
+
+        // Only HTTP carries the bearer token
+        if (connection->tcp && connection->protocol != WireProtocol::WP_UNKNOWN &&
+            connection->protocol != WireProtocol::WP_HTTP) {
+            closeClient(id);
+            return;
+        }
+    }
+    if (connection->protocol == WireProtocol::WP_HTTP) {
+        processHttp(*connection);
+    }
+    else if (connection->protocol == WireProtocol::WP_RPC) {
+        processFrames(*connection);
+    }
+    else {
+        processLines(*connection);
+    }
+
+    writeClient(id);
+}
+
+void ServiceDaemon::processLines(Connection& connection) {
+    size_t start = 0;
+    size_t end;
+    while ((end = connection.input.find('\n', start)) != std::string::npos) {
+        // A whole oversized request can arrive in one read, newline included
+        if (end - start > maxRequestBytes) {
+            connection.output += errorLine("null", "Request too large");
+            connection.input.clear();
+            connection.readClosed = true;
+            return;
+        }
+        std::string line = connection.input.substr(start, end - start);
+        start = end + 1;
+        if (line.find_first_not_of(" \t\r") != std::string::npos) {
+            handleLine(connection, line);
+        }
+    }
+    connection.input.erase(0, start);
+
+    // The last request may lack its newline
+    if (connection.readClosed && !connection.input.empty() && connection.input.size() <= maxRequestBytes) {
+        std::string line;
+        line.swap(connection.input);
+        if (line.find_first_not_of(" \t\r") != std::string::npos) {
+            handleLine(connection, line);
+        }
+    }
+
+    if (connection.input.size() > maxRequestBytes) {
+        connection.output += errorLine("null", "Request too large");
+        connection.input.clear();
+        connection.readClosed = true;
+    }
+}
+
+void ServiceDaemon::writeClient(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    Connection& connection = *it->second;
+
+    // Whatever a streamed reply could not write at once goes first
+    bool sinkBacklog = false;
+    if (connection.sink) {
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lock(connection.sink->mutex);
+            std::string& pending = connection.sink->pending;
+            size_t sent = 0;
+            while (sent < pending.size()) {
+                ssize_t n = send(connection.fd, pending.data() + sent, pending.size() - sent, MSG_NOSIGNAL);
+                if (n > 0) {
+                    sent += static_cast<size_t>(n);
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                failed = true;
+                break;
+            }
+            pending.erase(0, sent);
+            sinkBacklog = !pending.empty();
+        }
+        if (failed) {
+            closeClient(id);
+            return;
+        }
+    }
+
+    while (connection.outputOffset < connection.output.size()) {
+        ssize_t n = send(connection.fd, connection.output.data() + connection.outputOffset,
+            connection.output.size() - connection.outputOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            connection.outputOffset += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        closeClient(id);
+        return;
+    }
+
+    if (connection.outputOffset == connection.output.size()) {
+        connection.output.clear();
+        connection.outputOffset = 0;
+    }
+    else if (connection.outputOffset > connection.output.size() / 2) {
+        connection.output.erase(0, connection.outputOffset);
+        connection.outputOffset = 0;
+    }
+
+    if (connection.readClosed && connection.requests.empty() && connection.output.empty()) {
+        closeClient(id);
+        return;
+    }
+    updateEvents(connection, sinkBacklog);
+}
+
+void ServiceDaemon::updateEvents(Connection& connection, bool sinkBacklog) {
+    bool wantWrite = sinkBacklog || connection.outputOffset < connection.output.size();
+    uint32_t events = (connection.readClosed ? 0u : static_cast<uint32_t>(EPOLLIN)) |
+        (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    if (events == connection.events) {
+        return;
+    }
+
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = connection.id;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void ServiceDaemon::closeClient(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    std::unique_ptr<Connection> connection = std::move(it->second);
+    connections.erase(it);
+    connectionCount = connections.size();
+
+    // Nobody is left to read the replies. The completions still post their
+    // last output, which is then only counted.
+    for (auto& request : connection->requests) {
+        request.second.cancel();
+    }
+    admission.rejectOwner(id, "Client disconnected");
+    if (connection->sink) {
+        std::lock_guard<std::mutex> lock(connection->sink->mutex);
+        connection->sink->fd = -1;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+}
+
+void ServiceDaemon::handleLine(Connection& connection, const std::string& line) {
+    json request = json::parse(line, nullptr, false);
+    if (request.is_discarded() || !request.is_object()) {
+        connection.output += errorLine("null", "Invalid JSON request");
+        return;
+    }
+
+    std::string idText = "null";
+    if (request.contains("id")) {
+        idText = request["id"].dump(-1, ' ', false, json::error_handler_t::replace);
+    }
+    if (draining) {
+        connection.output += errorLine(idText, "Service is shutting down");
+        return;
+    }
+
+    ConversationHistory messages;
+    if (request.contains("messages") && request["messages"].is_array()) {
+        for (const auto& message : request["messages"]) {
+            if (!message.is_object() || !message.contains("content") || !message["content"].is_string()) {
+                connection.output += errorLine(idText, "Every message needs a string \"content\"");
+                return;
+            }
+            std::string role = message.contains("role") && message["role"].is_string()
+                ? message["role"].get<std::string>() : "user";
+            messages.push_back(Message(role, message["content"].get<std::string>()));
+        }
+    }
+    else if (request.contains("prompt") && request["prompt"].is_string()) {
+        messages.push_back(Message("user", request["prompt"].get<std::string>()));
+    }
+    if (messages.empty()) {
+        connection.output += errorLine(idText, "Expected \"prompt\" or \"messages\"");
+        return;
+    }
+
+    std::string model = "deepseek-chat";
+    float temperature = 0.7f;
+    int maxTokens = 1000;
+    bool stream = false;
+    CompletionOptions options;
+    if (request.contains("model") && request["model"].is_string()) {
+        model = request["model"].get<std::string>();
+    }
+    if (request.contains("temperature") && request["temperature"].is_number()) {
+        temperature = request["temperature"].get<float>();
+    }
+    if (request.contains("max_tokens") && request["max_tokens"].is_number_integer()) {
+        maxTokens = request["max_tokens"].get<int>();
+    }
+    if (request.contains("stream") && request["stream"].is_boolean()) {
+        stream = request["stream"].get<bool>();
+    }
+    if (request.contains("no_cache") && request["no_cache"].is_boolean()) {
+        options.bypassCache = request["no_cache"].get<bool>();
+    }
+    if (request.contains("timeout_ms") && request["timeout_ms"].is_number_integer()) {
+        options.deadline = Clock::now() + std::chrono::milliseconds(request["timeout_ms"].get<long long>());
+    }
+    RequestClass requestClass = RequestClass::RC_INTERACTIVE;
+    if (request.contains("class") &&
+        (!request["class"].is_string() || !parseRequestClass(request["class"].get<std::string>(), requestClass))) {
+        connection.output += errorLine(idText, "\"class\" must be \"interactive\", \"voice\" or \"batch\"");
+        return;
+    }
+    std::string client;
+    if (request.contains("client") && request["client"].is_string()) {
+        client = request["client"].get<std::string>();
+    }
+
+    std::string prefix = "{\"id\":" + idText;
+    startCompletion(connection, messages, model, temperature, maxTokens, options, requestClass, client,
+        stream ? [prefix](const std::string& chunk) {
+            std::string line = prefix + ",\"delta\":";
+            appendJsonString(line, chunk);
+            line += "}\n";
+            return line;
+        } : Encoder(),
+        [prefix, stream](const std::string& reply) {
+            return replyLine(prefix, reply, stream);
+        },
+        [idText](const std::string& reason) {
+            return errorLine(idText, reason);
+        });
+}
+
+void ServiceDaemon::startCompletion(Connection& connection, const ConversationHistory& messages,
+    const std::string& model, float temperature, int maxTokens, const CompletionOptions& options,
+    RequestClass requestClass, const std::string& client,
+    Encoder encodeDelta, Encoder encodeReply, Encoder encodeError) {
+    uint64_t connectionId = connection.id;
+    uint64_t requestId = connection.nextRequest++;
+    connection.requests.emplace(requestId, options.cancellation);
+    activeRequests++;
+    activeCount = activeRequests;
+    requestCount++;
+
+    size_t promptBytes = 0;
+    for (const Message& message : messages) {
+        promptBytes += message.getContent().size();
+    }
+
+    AdmissionQueue::Request request;
+    request.requestClass = requestClass;
+    request.client = client.empty() ? "connection " + std::to_string(connectionId) : "client " + client;
+    request.owner = connectionId;
+    request.id = requestId;
+    request.cost = estimateCost(promptBytes, maxTokens);
+
+    // Hashing the key, the disk cache lookup and building the body are left
+    // to an Executor worker so they do not hold up this thread. Completions
+    // then run on that worker (cache hits), the engine thread or another
+    // worker; either way their output goes through post()
+    request.start = [this, connectionId, requestId, messages, model, temperature, maxTokens, options,
+        encodeDelta, encodeReply]() mutable {
+        Executor::getInstance().submit([this, connectionId, requestId, messages = std::move(messages),
+            model = std::move(model), temperature, maxTokens, options, encodeDelta = std::move(encodeDelta),
+            encodeReply = std::move(encodeReply)]() {
+            if (encodeDelta) {
+                streamingChatCompletionAsync(apiKey, messages,
+                    [this, connectionId, requestId, encodeDelta](const std::string& chunk) {
+                        post(connectionId, requestId, encodeDelta(chunk), false);
+                    },
+                    [this, connectionId, requestId, encodeReply](const std::string& reply) {
+                        post(connectionId, requestId, encodeReply(reply), true);
+                    },
+                    model, temperature, maxTokens, options);
+            }
+            else {
+                chatCompletionAsync(apiKey, messages,
+                    [this, connectionId, requestId, encodeReply](const std::string& reply) {
+                        post(connectionId, requestId, encodeReply(reply), true);
+                    },
+                    model, temperature, maxTokens, options);
+            }
+            }, TaskPriority::TP_HIGH);
+    };
+    request.reject = [this, connectionId, requestId, encodeError](const std::string& reason) {
+        post(connectionId, requestId, encodeError(reason), true);
+    };
+    admission.submit(std::move(request));
+}
+
+void ServiceDaemon::processFrames(Connection& connection) {
+    const size_t magicSize = sizeof(RpcProtocol::MAGIC);
+    if (!connection.rpcGreeted) {
+        if (connection.input.size() < magicSize) {
+            return;
+        }
+        if (connection.input.compare(0, magicSize, RpcProtocol::MAGIC, magicSize) != 0) {
+            connection.output += rpcText(RpcType::RPC_ERROR, 0, "Unsupported protocol version");
+            connection.input.clear();
+            connection.readClosed = true;
+            return;
+        }
+        connection.input.erase(0, magicSize);
+        connection.rpcGreeted = true;
+    }
+
+    RpcType type;
+    std::string body;
+    bool invalid;
+    while (RpcProtocol::takeFrame(connection.input, type, body, maxRequestBytes, invalid)) {
+        handleFrame(connection, type, body);
+    }
+    if (invalid) {
+        connection.output += rpcText(RpcType::RPC_ERROR, 0, "Invalid or oversized frame");
+        connection.input.clear();
+        connection.readClosed = true;
+    }
+}
+
+void ServiceDaemon::handleFrame(Connection& connection, RpcType type, const std::string& body) {
+    if (type == RpcType::RPC_STATUS) {
+        ServiceStats stats = getStats();
+        std::string frame;
+        size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_STATUS_REPLY);
+        RpcProtocol::appendU64(frame, static_cast<uint64_t>(getpid()));
+        RpcProtocol::appendU64(frame, static_cast<uint64_t>(stats.uptimeSeconds * 1000));
+        RpcProtocol::appendU64(frame, stats.connections);
+        RpcProtocol::appendU64(frame, stats.acceptedConnections);
+        RpcProtocol::appendU64(frame, stats.requests);
+        RpcProtocol::appendU64(frame, stats.activeRequests);
+        RpcProtocol::endFrame(frame, start);
+        connection.output += frame;
+        return;
+    }
+    if (type == RpcType::RPC_METRICS) {
+        std::string frame;
+        size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_METRICS_REPLY);
+        frame += Metrics::getInstance().renderText();
+        RpcProtocol::endFrame(frame, start);
+        connection.output += frame;
+        return;
+    }
+    if (type == RpcType::RPC_TRACE) {
+        std::string frame;
+        size_t start = RpcProtocol::beginFrame(frame, RpcType::RPC_TRACE_REPLY);
+        frame += Tracer::getInstance().toChromeJson();
+        RpcProtocol::endFrame(frame, start);
+        connection.output += frame;
+        return;
+    }
+    if (type != RpcType::RPC_CHAT) {
+        connection.output += rpcText(RpcType::RPC_ERROR, 0, "Unknown frame type");
+        return;
+    }
+
+    RpcReader reader(body);
+    uint32_t id = reader.readU32();
+    uint8_t flags = reader.readU8();
+    float temperature = reader.readFloat();
+    int maxTokens = static_cast<int>(reader.readU32());
+    std::string model = reader.readString();
+    uint32_t count = reader.readU32();
+    ConversationHistory messages;
+    for (uint32_t i = 0; i < count && reader.ok(); i++) {
+        std::string role = reader.readString();
+        std::string content = reader.readString();
+        messages.push_back(Message(role, content));
+    }
+    if (!reader.ok() || messages.empty()) {
+        connection.output += rpcText(RpcType::RPC_ERROR, id, "Malformed chat request");
+        return;
+    }
+    if (draining) {
+        connection.output += rpcText(RpcType::RPC_ERROR, id, "Service is shutting down");
+        return;
+    }
+
+    CompletionOptions options;
+    options.bypassCache = (flags & RpcProtocol::CHAT_NO_CACHE) != 0;
+    RequestClass requestClass = (flags & RpcProtocol::CHAT_VOICE) ? RequestClass::RC_VOICE
+        : (flags & RpcProtocol::CHAT_BATCH) ? RequestClass::RC_BATCH : RequestClass::RC_INTERACTIVE;
+    startCompletion(connection, messages, model, temperature, maxTokens, options, requestClass, std::string(),
+        (flags & RpcProtocol::CHAT_STREAM) ? [id](const std::string& chunk) {
+            return rpcText(RpcType::RPC_DELTA, id, chunk);
+        } : Encoder(),
+        [id](const std::string& reply) {
+            return rpcReply(id, reply);
+        },
+        [id](const std::string& reason) {
+            return rpcText(RpcType::RPC_ERROR, id, reason);
+        });
+}
+
+void ServiceDaemon::processHttp(Connection& connection) {
+    while (!connection.httpBusy && connection.httpKeepAlive && !connection.input.empty()) {
+        // Clients may send empty lines between requests
+        size_t requestStart = connection.input.find_first_not_of("\r\n");
+        connection.input.erase(0, requestStart);
+        if (connection.input.empty()) {
+            return;
+        }
+
+        size_t headEnd = connection.input.find("\r\n\r\n");
+        if (headEnd == std::string::npos) {
+            if (connection.input.size() > MAX_HTTP_HEAD) {
+                connection.output += httpError(431, "Request head too large", "invalid_request_error", false);
+                connection.input.clear();
+                connection.readClosed = true;
+            }
+            return;
+        }
+
+        // Requests without a body or with a Content-Length only; chunked
+        // uploads are not worth a decoder for chat requests
+        HttpHead head;
+        const char* problem = nullptr;
+        long status = 400;
+        size_t length = 0;
+        if (!head.parse(connection.input.substr(0, headEnd))) {
+            problem = "Malformed HTTP request";
+        }
+        else if (!head.header("transfer-encoding").empty()) {
+            problem = "Chunked request bodies are not supported; send Content-Length";
+            status = 411;
+        }
+        else {
+            std::string lengthText = head.header("content-length");
+            if (!lengthText.empty()) {
+                char* end = nullptr;
+                unsigned long long value = std::strtoull(lengthText.c_str(), &end, 10);
+                if (*end != '\0' || lengthText[0] == '-') {
+                    problem = "Invalid Content-Length";
+                }
+                else if (value > maxRequestBytes) {
+                    problem = "Request too large";
+                    status = 413;
+                }
+                length = static_cast<size_t>(value);
+            }
+        }
+        if (problem) {
+            connection.output += httpError(status, problem, "invalid_request_error", false);
+            connection.input.clear();
+            connection.readClosed = true;
+            return;
+        }
+
+        if (connection.input.size() - headEnd - 4 < length) {
+            return;
+        }
+        std::string body = connection.input.substr(headEnd + 4, length);
+        connection.input.erase(0, headEnd + 4 + length);
+
+        std::string connectionHeader = toLower(head.header("connection"));
+        connection.httpKeepAlive = head.version == "HTTP/1.0"
+            ? connectionHeader == "keep-alive" : connectionHeader != "close";
+        if (!connection.httpKeepAlive) {
+            connection.readClosed = true;
+        }
+        handleHttpRequest(connection, head, std::move(body));
+    }
+}
+
+void ServiceDaemon::handleHttpRequest(Connection& connection, const HttpHead& head, std::string body) {
+    bool keepAlive = connection.httpKeepAlive;
+    std::string path = head.target.substr(0, head.target.find('?'));
+
+    // Browsers send Origin with cross-site requests, and a page reaching us
+    // through a rebound DNS name sends that name as Host
+    if (!head.header("origin").empty() || !isLoopbackHost(head.header("host"))) {
+        connection.output += httpError(403, "Requests from browsers are not accepted", "permission_error", keepAlive);
+        return;
+    }
+    if (!httpToken.empty() && head.header("authorization") != "Bearer " + httpToken) {
+        connection.output += httpError(401, "Invalid or missing bearer token", "authentication_error", keepAlive);
+        return;
+    }
+    if (path == "/metrics" && head.method == "GET") {
+        connection.output += httpResponse(200, "text/plain; version=0.0.4",
+            Metrics::getInstance().renderText(), keepAlive);
+        return;
+    }
+    if (path == "/debug/trace" && head.method == "GET") {
+        connection.output += httpResponse(200, "application/json", Tracer::getInstance().toChromeJson(), keepAlive);
+        return;
+    }
+    if (path != "/v1/chat/completions" && path != "/chat/completions") {
+        connection.output += httpError(404, "Unknown endpoint " + path, "invalid_request_error", keepAlive);
+        return;
+    }
+    if (head.method != "POST") {
+        connection.output += httpError(405, "Use POST", "invalid_request_error", keepAlive);
+        return;
+    }
+    // Forms can post text/plain across sites without a preflight; JSON cannot
+    std::string contentType = toLower(head.header("content-type"));
+    contentType = contentType.substr(0, contentType.find(';'));
+    contentType.erase(contentType.find_last_not_of(" \t") + 1);
+    if (contentType != "application/json") {
+        connection.output += httpError(415, "Content-Type must be application/json", "invalid_request_error", keepAlive);
+        return;
+    }
+    if (draining) {
+        connection.output += httpError(503, "Service is shutting down", "server_error", false);
+        connection.httpKeepAlive = false;
+        connection.readClosed = true;
+        return;
+    }
+    handleChatCompletions(connection, head, std::move(body));
+}
+
+void ServiceDaemon::handleChatCompletions(Connection& connection, const HttpHead& head, std::string body) {
+    bool keepAlive = connection.httpKeepAlive;
+    json request = json::parse(body, nullptr, false);
+    if (request.is_discarded() || !request.is_object() ||
+        !request.contains("messages") || !request["messages"].is_array()) {
+        connection.output += httpError(400, "Expected a JSON object with \"messages\"", "invalid_request_error", keepAlive);
+        return;
+    }
+    RequestClass requestClass = RequestClass::RC_INTERACTIVE;
+    std::string className = toLower(head.header("x-pichat-class"));
+    if (!className.empty() && !parseRequestClass(className, requestClass)) {
+        connection.output += httpError(400, "X-PiChat-Class must be interactive, voice or batch",
+            "invalid_request_error", keepAlive);
+        return;
+    }
+
+    bool stream = request.contains("stream") && request["stream"].is_boolean() && request["stream"].get<bool>();
+    std::string model = request.contains("model") && request["model"].is_string()
+        ? request["model"].get<std::string>() : "deepseek-chat";
+
+    // Only a request made entirely of what the cache key covers may be
+    // answered from the cache; tools, penalties and the like go upstream
+    ResponseCache& cache = ResponseCache::getInstance();
+    bool cacheable = cache.isEnabled() && toLower(head.header("cache-control")).find("no-cache") == std::string::npos;
+    for (auto it = request.begin(); cacheable && it != request.end(); ++it) {
+        static const char* const keyed[] = { "model", "messages", "temperature", "max_tokens", "stream" };
+        cacheable = std::any_of(std::begin(keyed), std::end(keyed),
+            [&it](const char* name) { return it.key() == name; });
+    }
+    ConversationHistory messages;
+    for (const auto& message : request["messages"]) {
+        if (!cacheable) {
+            break;
+        }
+        cacheable = message.is_object() && message.size() == 2 &&
+            message.contains("role") && message["role"].is_string() &&
+            message.contains("content") && message["content"].is_string();
+        if (cacheable) {
+            messages.push_back(Message(message["role"].get<std::string>(), message["content"].get<std::string>()));
+        }
+    }
+
+    // Left out, temperature and max_tokens take the API defaults, which
+    // the key tells apart from any explicit value
+    float temperature = -1.0f;
+    int maxTokens = -1;
+    if (cacheable && request.contains("temperature")) {
+        cacheable = request["temperature"].is_number();
+        temperature = cacheable ? request["temperature"].get<float>() : temperature;
+    }
+    if (cacheable && request.contains("max_tokens")) {
+        cacheable = request["max_tokens"].is_number_integer();
+        maxTokens = cacheable ? request["max_tokens"].get<int>() : maxTokens;
+    }
+
+    CacheKey key;
+    requestCount++;
+    if (cacheable) {
+        key = ResponseCache::makeKey(messages, model, temperature, maxTokens);
+        std::string cached;
+        if (cache.lookup(key, cached)) {
+            uint64_t serial = nextCompletionId++;
+            connection.output += stream
+                ? httpResponse(200, "text/event-stream", cachedStream(model, cached, serial), keepAlive, "X-PiChat-Cache: hit\r\n")
+                : httpResponse(200, "application/json", cachedCompletion(model, cached, serial), keepAlive, "X-PiChat-Cache: hit\r\n");
+            return;
+        }
+    }
+
+    uint64_t connectionId = connection.id;
+    uint64_t requestId = connection.nextRequest++;
+    CompletionOptions options;
+    connection.requests.emplace(requestId, options.cancellation);
+    connection.httpBusy = true;
+    activeRequests++;
+    activeCount = activeRequests;
+
+    int replyTokens = request.contains("max_tokens") && request["max_tokens"].is_number_integer()
+        ? request["max_tokens"].get<int>() : -1;
+    std::string client = head.header("x-pichat-client");
+    AdmissionQueue::Request pending;
+    pending.requestClass = requestClass;
+    pending.client = client.empty() ? "connection " + std::to_string(connectionId) : "client " + client;
+    pending.owner = connectionId;
+    pending.id = requestId;
+    pending.cost = estimateCost(body.size(), replyTokens);
+    pending.start = [this, connectionId, requestId, body = std::move(body), stream, keepAlive, cacheable, key,
+        options]() mutable {
+        forwardHttp(connectionId, requestId, std::move(body), stream, keepAlive, cacheable, key, options);
+    };
+    pending.reject = [this, connectionId, requestId, keepAlive](const std::string& reason) {
+        post(connectionId, requestId, httpError(503, reason, "server_error", keepAlive, "Retry-After: 1\r\n"), true);
+    };
+    admission.submit(std::move(pending));
+}
+
+void ServiceDaemon::forwardHttp(uint64_t connectionId, uint64_t requestId, std::string body, bool stream,
+    bool keepAlive, bool cacheable, const CacheKey& key, const CompletionOptions& options) {
+    auto it = connections.find(connectionId);
+    if (it == connections.end()) {
+        post(connectionId, requestId, std::string(), true);
+        return;
+    }
+    Connection& connection = *it->second;
+
+    if (!stream) {
+        forwardChatCompletionAsync(apiKey, std::move(body), nullptr,
+            [this, connectionId, requestId, keepAlive, cacheable, key](long status,
+                const std::string& responseBody, const std::string& error) {
+                post(connectionId, requestId, upstreamReply(status, responseBody, error, keepAlive), true);
+                if (status != 200 || !cacheable) {
+                    return;
+                }
+
+                // The client has its reply; parsing it for the cache can wait
+                Executor::getInstance().submit([key, responseBody]() {
+                    json reply = json::parse(responseBody, nullptr, false);
+                    if (!reply.is_discarded() && reply.contains("choices") && reply["choices"].is_array() &&
+                        !reply["choices"].empty() && reply["choices"][0].contains("message") &&
+                        reply["choices"][0]["message"].contains("content") &&
+                        reply["choices"][0]["message"]["content"].is_string()) {
+                        ResponseCache::getInstance().store(key, reply["choices"][0]["message"]["content"].get<std::string>());
+                    }
+                    }, TaskPriority::TP_LOW);
+            },
+            options);
+        return;
+    }
+
+    // The reply is written by the engine thread as it arrives; replies
+    // still queued for earlier requests go out ahead of it
+    auto sink = std::make_shared<DirectSink>();
+    sink->fd = connection.fd;
+    sink->connection = connectionId;
+    sink->request = requestId;
+    sink->keepAlive = keepAlive;
+    sink->pending = connection.output.substr(connection.outputOffset);
+    connection.output.clear();
+    connection.outputOffset = 0;
+    connection.sink = sink;
+
+    std::shared_ptr<StreamCollector> collector;
+    if (cacheable) {
+        collector = std::make_shared<StreamCollector>();
+    }
+    forwardChatCompletionAsync(apiKey, std::move(body),
+        [this, sink, collector](const char* data, size_t size) {
+            if (collector) {
+                collector->parser.feed(data, size);
+            }
+            return relay(sink, data, size);
+        },
+        [this, sink, collector, key, connectionId, requestId, keepAlive](long status,
+            const std::string& responseBody, const std::string& error) {
+            bool streamed;
+            {
+                std::lock_guard<std::mutex> lock(sink->mutex);
+                streamed = sink->headSent;
+            }
+            if (!streamed) {
+                post(connectionId, requestId, upstreamReply(status, responseBody, error, keepAlive), true);
+                return;
+            }
+
+            if (collector && status == 200) {
+                collector->parser.finish();
+                if (collector->parser.isDone() && !collector->text.empty()) {
+                    Executor::getInstance().submit([key, collector]() {
+                        ResponseCache::getInstance().store(key, collector->text);
+                        }, TaskPriority::TP_LOW);
+                }
+            }
+            // Ends the chunked body; a cut-off stream simply lacks [DONE]
+            post(connectionId, requestId, "0\r\n\r\n", true);
+        },
+        options);
+}
+
+bool ServiceDaemon::relay(const std::shared_ptr<DirectSink>& sink, const char* data, size_t size) {
+    char chunkHeader[24];
+    int headerLength = std::snprintf(chunkHeader, sizeof(chunkHeader), "%zx\r\n", size);
+    static const char chunkEnd[] = "\r\n";
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(sink->mutex);
+        if (sink->fd < 0) {
+            return false;
+        }
+        std::string head;
+        if (!sink->headSent) {
+            head = streamHead(sink->keepAlive);
+            sink->headSent = true;
+        }
+
+        // Head, chunk framing and the bytes from the transfer buffer in one
+        // system call; only what the socket refuses gets copied
+        iovec parts[4] = {
+            { const_cast<char*>(head.data()), head.size() },
+            { chunkHeader, static_cast<size_t>(headerLength) },
+            { const_cast<char*>(data), size },
+            { const_cast<char*>(chunkEnd), 2 }
+        };
+        bool wasEmpty = sink->pending.empty();
+        size_t sent = 0;
+        if (wasEmpty) {
+            msghdr message{};
+            message.msg_iov = parts;
+            message.msg_iovlen = 4;
+            ssize_t n;
+            do {
+                n = sendmsg(sink->fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+            sent = n > 0 ? static_cast<size_t>(n) : 0;
+        }
+        for (const iovec& part : parts) {
+            if (sent >= part.iov_len) {
+                sent -= part.iov_len;
+                continue;
+            }
+            sink->pending.append(static_cast<const char*>(part.iov_base) + sent, part.iov_len - sent);
+            sent = 0;
+        }
+        if (sink->pending.size() > MAX_SINK_BACKLOG) {
+            return false;
+        }
+        wake = wasEmpty && !sink->pending.empty();
+    }
+
+    // The loop sends the rest once the socket is writable
+    if (wake) {
+        post(sink->connection, sink->request, std::string(), false);
+    }
+    return true;
+}
+
+void ServiceDaemon::finishHttpResponse(Connection& connection, const std::string& tail) {
+    if (connection.sink) {
+        std::lock_guard<std::mutex> lock(connection.sink->mutex);
+        connection.output.insert(connection.outputOffset, connection.sink->pending);
+        connection.sink->pending.clear();
+        connection.sink->fd = -1;
+    }
+    connection.sink.reset();
+    connection.output += tail;
+    connection.httpBusy = false;
+
+    // Pipelined requests waited for this reply
+    processHttp(connection);
+}
+
+void ServiceDaemon::post(uint64_t connection, uint64_t request, std::string data, bool finished) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        wake = outbox.empty();
+        outbox.push_back(Outgoing{ connection, request, std::move(data), finished });
+    }
+
+    // One wake-up per batch; the loop drains the eventfd before taking the outbox
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void ServiceDaemon::deliverOutgoing() {
+    uint64_t value;
+    while (read(wakeFd, &value, sizeof(value)) == sizeof(value)) {
+    }
+
+    std::vector<Outgoing> batch;
+    {
+        std::lock_guard<std::mutex> lock(outboxMutex);
+        batch.swap(outbox);
+    }
+
+    std::vector<uint64_t> touched;
+    for (Outgoing& item : batch) {
+        if (item.finished) {
+            activeRequests--;
+            activeCount = activeRequests;
+            // Frees its slot, which may start waiting requests
+            admission.finish(item.connection, item.request);
+        }
+
+        auto it = connections.find(item.connection);
+        if (it == connections.end()) {
+            continue;
+        }
+        Connection& connection = *it->second;
+        if (item.finished) {
+            connection.requests.erase(item.request);
+        }
+        if (item.finished && connection.protocol == WireProtocol::WP_HTTP) {
+            finishHttpResponse(connection, item.data);
+        }
+        else {
+            connection.output += item.data;
+        }
+        if (touched.empty() || touched.back() != item.connection) {
+            touched.push_back(item.connection);
+        }
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (uint64_t id : touched) {
+        writeClient(id);
+    }
+}
+
+void ServiceDaemon::beginShutdown() {
+    if (draining) {
+        return;
+    }
+    draining = true;
+    drainDeadline = Clock::now() + drainTimeout;
+
+    // New clients get connection refused; connected ones may finish
+    for (uint64_t tag : { TAG_UNIX_LISTENER, TAG_TCP_LISTENER }) {
+        int fd = tag == TAG_UNIX_LISTENER ? unixListener : tcpListener;
+        if (fd >= 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+    }
+    closeListeners();
+    ErrorHandler::getInstance().logInfo("Service shutting down, " + std::to_string(activeRequests) +
+        " requests in flight", "ServiceDaemon");
+}
+
+void ServiceDaemon::cancelAll() {
+    admission.rejectAll("Service is shutting down");
+    for (auto& entry : connections) {
+        for (auto& request : entry.second->requests) {
+            request.second.cancel();
+        }
+    }
+}
+
+bool ServiceDaemon::flushed() const {
+    for (const auto& entry : connections) {
+        if (entry.second->outputOffset < entry.second->output.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+int ServiceDaemon::run() {
+    ErrorHandler::getInstance().logError("Service mode is only supported on Linux", "ServiceDaemon");
+    std::cerr << "Error: PiChat service mode is only supported on Linux" << std::endl;
+    return 1;
+}
+
+void ServiceDaemon::stop() {
+    stopRequested = true;
+}
+
+#endif
@@ -0,0 +1,292 @@
+#include "include/utils/AsyncLogger.h"
+#include "include/config/ConfigManager.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+namespace {
+    const long long DEFAULT_CAPACITY = 4096;
+    const size_t MAX_BATCH = 256;
+    const long long DEFAULT_FILE_MAX_KB = 1024;
+    const long long DEFAULT_FILE_COUNT = 3;
+
+    // Longer messages give their memory back once written, so the ring stays small
+    const size_t KEPT_MESSAGE_CAPACITY = 1024;
+
+    const char* prefix(ErrorLevel level) {
+        switch (level) {
+        case ErrorLevel::EL_INFO:
+            return "[INFO] ";
+        case ErrorLevel::EL_WARNING:
+            return "[WARNING] ";
+        case ErrorLevel::EL_ERROR:
+            return "[ERROR] ";
+        default:
+            return "[FATAL] ";
+        }
+    }
+
+    bool toStderr(ErrorLevel level) {
+        return level == ErrorLevel::EL_ERROR || level == ErrorLevel::EL_FATAL;
+    }
+
+    void emit(std::string& buffer, bool isStderr) {
+        if (buffer.empty()) {
+            return;
+        }
+        std::ostream& stream = isStderr ? std::cerr : std::cout;
+        stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        stream.flush();
+        buffer.clear();
+    }
+}
+
+AsyncLogger& AsyncLogger::getInstance() {
+    static AsyncLogger instance;
+    return instance;
+}
+
+AsyncLogger::AsyncLogger()
+    : tail(0), head(0), dropped(0), written(0), reportedDrops(0), fileSize(0),
+    sleeping(false), running(true), stopping(false) {
+    ConfigManager& config = ConfigManager::getInstance();
+    long long configured = config.getIntSetting("log_queue_capacity", DEFAULT_CAPACITY);
+    size_t capacity = 16;
+    while (capacity < static_cast<size_t>(std::clamp(configured, 16LL, 1LL << 20))) {
+        capacity <<= 1;
+    }
+    mask = capacity - 1;
+    ring.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    filePath = config.getSetting("error_log_file", "");
+    fileMaxBytes = static_cast<size_t>(std::max(1LL, config.getIntSetting("error_log_max_kb", DEFAULT_FILE_MAX_KB))) * 1024;
+    fileCount = static_cast<size_t>(std::max(0LL, config.getIntSetting("error_log_files", DEFAULT_FILE_COUNT)));
+    if (!filePath.empty()) {
+        std::error_code error;
+        uintmax_t existing = std::filesystem::file_size(filePath, error);
+        fileSize = error ? 0 : static_cast<size_t>(existing);
+        file.open(filePath, std::ios::binary | std::ios::app);
+        if (!file) {
+            std::cerr << "Cannot open log file " << filePath << std::endl;
+        }
+    }
+
+    writer = std::thread(&AsyncLogger::writerLoop, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+    shutdown();
+}
+
+bool AsyncLogger::log(ErrorLevel level, const std::string& message, const std::string& context,
+    const std::string& timestamp) {
+    if (!running.load()) {
+        static std::mutex directMutex;
+        std::lock_guard<std::mutex> lock(directMutex);
+        std::string line = prefix(level) + message + "\n";
+        emit(line, toStderr(level));
+        return true;
+    }
+
+    size_t position = tail.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &ring[position & mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            // The writer has not freed this slot yet: the ring is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->message = message;
+    slot->context = context;
+    slot->timestamp = timestamp;
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in writerLoop: either the writer sees the record
+    // before it sleeps, or we see it sleeping and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeUp.notify_one();
+    }
+    return true;
+}
+
+void AsyncLogger::flush() {
+    if (!running.load()) {
+        return;
+    }
+    size_t target = tail.load();
+    std::unique_lock<std::mutex> lock(mutex);
+    wakeUp.notify_one();
+    drained.wait(lock, [this, target]() {
+        return head.load() >= target || stopping;
+    });
+}
+
+void AsyncLogger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        running.store(false);
+        stopping = true;
+    }
+    wakeUp.notify_one();
+    drained.notify_all();
+    writer.join();
+
+    // Callers that saw the logger running just before it stopped may still
+    // be copying their record in
+    while (head.load() != tail.load()) {
+        if (drainBatch() == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+AsyncLoggerStats AsyncLogger::getStats() const {
+    AsyncLoggerStats stats;
+    stats.capacity = mask + 1;
+    size_t read = head.load();
+    size_t claimed = tail.load();
+    stats.queued = claimed > read ? claimed - read : 0;
+    stats.written = written.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool AsyncLogger::hasRecord() const {
+    size_t position = head.load(std::memory_order_relaxed);
+    return ring[position & mask].sequence.load(std::memory_order_acquire) == position + 1;
+}
+
+void AsyncLogger::writerLoop() {
+#ifndef _WIN32
+    // Started before the daemon blocks SIGTERM for its signalfd; a process
+    // signal delivered here would take the default action
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, nullptr);
+#endif
+
+    for (;;) {
+        if (drainBatch() > 0) {
+            // flush() checks head under the mutex, so taking it here cannot miss a waiter
+            { std::lock_guard<std::mutex> lock(mutex); }
+            drained.notify_all();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasRecord()) {
+            wakeUp.wait(lock);
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+size_t AsyncLogger::drainBatch() {
+    // Consecutive lines for one stream go out in one write, in logging order
+    std::string buffer;
+    bool bufferIsStderr = false;
+    std::string fileLines;
+    size_t count = 0;
+    while (count < MAX_BATCH && hasRecord()) {
+        size_t position = head.load(std::memory_order_relaxed);
+        Slot& slot = ring[position & mask];
+        bool isStderr = toStderr(slot.level);
+        if (isStderr != bufferIsStderr) {
+            emit(buffer, bufferIsStderr);
+            bufferIsStderr = isStderr;
+        }
+        buffer += prefix(slot.level);
+        buffer += slot.message;
+        buffer += '\n';
+        if (file.is_open()) {
+            fileLines += slot.timestamp;
+            fileLines += slot.timestamp.empty() ? "" : " ";
+            fileLines += prefix(slot.level);
+            fileLines += slot.context;
+            fileLines += slot.context.empty() ? "" : ": ";
+            fileLines += slot.message;
+            fileLines += '\n';
+        }
+        if (slot.message.capacity() > KEPT_MESSAGE_CAPACITY) {
+            std::string().swap(slot.message);
+        }
+
+        slot.sequence.store(position + mask + 1, std::memory_order_release);
+        head.store(position + 1, std::memory_order_release);
+        count++;
+    }
+
+    uint64_t drops = dropped.load(std::memory_order_relaxed);
+    if (drops > reportedDrops) {
+        emit(buffer, bufferIsStderr);
+        std::string warning = prefix(ErrorLevel::EL_WARNING) + std::to_string(drops - reportedDrops) +
+            " log lines dropped, the log queue was full\n";
+        emit(warning, false);
+        reportedDrops = drops;
+    }
+    emit(buffer, bufferIsStderr);
+    writeFile(fileLines);
+
+    written.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+void AsyncLogger::writeFile(const std::string& lines) {
+    if (lines.empty() || !file.is_open()) {
+        return;
+    }
+    file.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+    file.flush();
+    fileSize += lines.size();
+    if (fileSize < fileMaxBytes) {
+        return;
+    }
+
+    // log -> log.1 -> log.2 ...; the oldest falls off the end
+    file.close();
+    std::error_code error;
+    if (fileCount == 0) {
+        std::filesystem::remove(filePath, error);
+    }
+    else {
+        std::filesystem::remove(filePath + "." + std::to_string(fileCount), error);
+        for (size_t i = fileCount; i-- > 1;) {
+            std::filesystem::rename(filePath + "." + std::to_string(i), filePath + "." + std::to_string(i + 1), error);
+        }
+        std::filesystem::rename(filePath, filePath + ".1", error);
+    }
+    file.open(filePath, std::ios::binary | std::ios::trunc);
+    fileSize = 0;
+}
@@ -0,0 +1,142 @@
+#include "include/utils/BatchCompletion.h"
+#include "include/utils/DeepSeekAPI.h"
+#include "include/config/ConfigManager.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+    const long long DEFAULT_MAX_IN_FLIGHT = 16;
+
+    // How far ahead of the oldest unfinished item requests may run, in
+    // multiples of maxInFlight; bounds the results waiting for their turn
+    const size_t REORDER_WINDOW_FACTOR = 2;
+
+    using Clock = std::chrono::steady_clock;
+
+    double msBetween(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    // Shared with the completion callbacks, which run on Executor workers
+    struct BatchState {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::map<size_t, BatchResult> finished;  // Waiting for earlier items
+        size_t inFlight = 0;
+    };
+}
+
+BatchSummary batchChatCompletion(
+    const std::string& apiKey,
+    BatchSource next,
+    BatchSink sink,
+    size_t maxInFlight,
+    const CompletionOptions& options
+) {
+    if (maxInFlight == 0) {
+        maxInFlight = static_cast<size_t>(std::max(1LL,
+            ConfigManager::getInstance().getIntSetting("batch_max_in_flight", DEFAULT_MAX_IN_FLIGHT)));
+    }
+    const size_t window = maxInFlight * REORDER_WINDOW_FACTOR;
+
+    auto state = std::make_shared<BatchState>();
+    const Clock::time_point start = Clock::now();
+
+    BatchSummary summary;
+    double totalLatencyMs = 0.0;
+    size_t nextIndex = 0;      // Index of the next item to send
+    size_t nextToDeliver = 0;  // Index of the next result the sink expects
+    bool drained = false;
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (;;) {
+        // The callback may run before chatCompletionAsync returns (cache
+        // hits), so the lock is released around every call out
+        while (!drained && state->inFlight < maxInFlight && nextIndex - nextToDeliver < window) {
+            lock.unlock();
+            BatchItem item;
+            drained = options.cancellation.isCancelled() || !next(item);
+            lock.lock();
+            if (drained) {
+                break;
+            }
+
+            size_t index = nextIndex++;
+            state->inFlight++;
+            lock.unlock();
+
+            Clock::time_point sentAt = Clock::now();
+            chatCompletionAsync(apiKey, item.messages, [state, index, start, sentAt](const std::string& reply) {
+                Clock::time_point now = Clock::now();
+                BatchResult result{ index, reply, !isErrorReply(reply), msBetween(start, sentAt), msBetween(sentAt, now) };
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.emplace(index, std::move(result));
+                state->inFlight--;
+                state->changed.notify_all();
+                }, item.model, item.temperature, item.maxTokens, options);
+
+            lock.lock();
+        }
+
+        auto it = state->finished.find(nextToDeliver);
+        while (it != state->finished.end()) {
+            BatchResult result = std::move(it->second);
+            state->finished.erase(it);
+            nextToDeliver++;
+            lock.unlock();
+
+            summary.items++;
+            if (result.ok) {
+                summary.succeeded++;
+            }
+            else {
+                summary.failed++;
+            }
+            totalLatencyMs += result.latencyMs;
+            summary.maxLatencyMs = std::max(summary.maxLatencyMs, result.latencyMs);
+            sink(std::move(result));
+
+            lock.lock();
+            it = state->finished.find(nextToDeliver);
+        }
+
+        if (drained && nextToDeliver == nextIndex) {
+            break;
+        }
+
+        // Wait for the next result in order, or for room to send another item
+        state->changed.wait(lock, [&]() {
+            return state->finished.count(nextToDeliver) > 0 ||
+                (!drained && state->inFlight < maxInFlight && nextIndex - nextToDeliver < window);
+            });
+    }
+
+    summary.elapsedMs = msBetween(start, Clock::now());
+    if (summary.items > 0) {
+        summary.meanLatencyMs = totalLatencyMs / summary.items;
+    }
+    return summary;
+}
+
+BatchSummary batchChatCompletion(
+    const std::string& apiKey,
+    const std::vector<BatchItem>& items,
+    BatchSink sink,
+    size_t maxInFlight,
+    const CompletionOptions& options
+) {
+    size_t position = 0;
+    BatchSource next = [&items, &position](BatchItem& item) {
+        if (position >= items.size()) {
+            return false;
+        }
+        item = items[position++];
+        return true;
+    };
+    return batchChatCompletion(apiKey, std::move(next), std::move(sink), maxInFlight, options);
+}
@@ -0,0 +1,644 @@
+#include "include/utils/BpeTokenizer.h"
+#include "include/config/ConfigManager.h"
+#include "include/utils/ErrorHandler.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BPE_USE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BPE_USE_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+namespace {
+    const size_t DEFAULT_CACHE_ENTRIES = 32768;
+
+    // Longer pieces rarely repeat and would only churn the cache
+    const size_t MAX_CACHED_PIECE = 64;
+
+    enum CharClass {
+        CC_LETTER,
+        CC_NUMBER,
+        CC_SPACE,
+        CC_OTHER
+    };
+
+    CharClass classifyAscii(unsigned char c) {
+        if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') {
+            return CC_LETTER;
+        }
+        if (c >= '0' && c <= '9') {
+            return CC_NUMBER;
+        }
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            return CC_SPACE;
+        }
+        return CC_OTHER;
+    }
+
+    // Coarse Unicode categories: whitespace, digits and the common punctuation
+    // and symbol blocks. Everything else outside ASCII counts as a letter.
+    CharClass classifyCodePoint(uint32_t cp) {
+        if (cp == 0x85 || cp == 0xA0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) ||
+            cp == 0x2028 || cp == 0x2029 || cp == 0x202F || cp == 0x205F || cp == 0x3000) {
+            return CC_SPACE;
+        }
+        if ((cp >= 0x660 && cp <= 0x669) || (cp >= 0x6F0 && cp <= 0x6F9) || (cp >= 0x966 && cp <= 0x96F) ||
+            (cp >= 0xFF10 && cp <= 0xFF19) || cp == 0xB2 || cp == 0xB3 || cp == 0xB9 ||
+            (cp >= 0xBC && cp <= 0xBE) || (cp >= 0x2150 && cp <= 0x218B) || (cp >= 0x2460 && cp <= 0x249B)) {
+            return CC_NUMBER;
+        }
+        if ((cp >= 0x80 && cp <= 0xBF && cp != 0xAA && cp != 0xB5 && cp != 0xBA) ||
+            cp == 0xD7 || cp == 0xF7 ||
+            (cp >= 0x2010 && cp <= 0x2027) || (cp >= 0x2030 && cp <= 0x205E) ||
+            (cp >= 0x20A0 && cp <= 0x20CF) || (cp >= 0x2190 && cp <= 0x245F) ||
+            (cp >= 0x2500 && cp <= 0x2BFF) || (cp >= 0x3001 && cp <= 0x3003) ||
+            (cp >= 0x3008 && cp <= 0x3011) || (cp >= 0x3014 && cp <= 0x301F) ||
+            (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF01 && cp <= 0xFF0F) ||
+            (cp >= 0xFF1A && cp <= 0xFF20) || (cp >= 0xFF3B && cp <= 0xFF40) ||
+            (cp >= 0xFF5B && cp <= 0xFF65) || (cp >= 0x1F000 && cp <= 0x1FAFF)) {
+            return CC_OTHER;
+        }
+        return CC_LETTER;
+    }
+
+    // Class and byte length of the character at p. Invalid UTF-8 is taken
+    // one byte at a time as a symbol.
+    CharClass classify(const char* p, const char* end, size_t& length) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c < 0x80) {
+            length = 1;
+            return classifyAscii(c);
+        }
+
+        uint32_t cp;
+        if ((c & 0xE0) == 0xC0) {
+            length = 2;
+            cp = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0) {
+            length = 3;
+            cp = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0) {
+            length = 4;
+            cp = c & 0x07;
+        }
+        else {
+            length = 1;
+            return CC_OTHER;
+        }
+
+        if (static_cast<size_t>(end - p) < length) {
+            length = 1;
+            return CC_OTHER;
+        }
+        for (size_t i = 1; i < length; i++) {
+            unsigned char next = static_cast<unsigned char>(p[i]);
+            if ((next & 0xC0) != 0x80) {
+                length = 1;
+                return CC_OTHER;
+            }
+            cp = (cp << 6) | (next & 0x3F);
+        }
+        return classifyCodePoint(cp);
+    }
+
+#ifdef BPE_USE_SSE2
+    unsigned countTrailingZeros(unsigned value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(value));
+#endif
+    }
+#endif
+
+    // Length of the run of ASCII letters at p, sixteen bytes per step
+    size_t asciiLetterRun(const char* p, const char* end) {
+        size_t n = 0;
+#if defined(BPE_USE_SSE2)
+        // (c | 0x20) - 'a' < 26, as a signed compare after biasing by -128
+        const __m128i caseBit = _mm_set1_epi8(0x20);
+        const __m128i bias = _mm_set1_epi8(static_cast<char>(128 - 'a'));
+        const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + 26));
+        while (end - (p + n) >= 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + n));
+            __m128i shifted = _mm_add_epi8(_mm_or_si128(bytes, caseBit), bias);
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmplt_epi8(shifted, limit)));
+            if (mask != 0xFFFF) {
+                return n + countTrailingZeros(~mask & 0xFFFF);
+            }
+            n += 16;
+        }
+#elif defined(BPE_USE_NEON)
+        const uint8x16_t caseBit = vdupq_n_u8(0x20);
+        const uint8x16_t lowest = vdupq_n_u8('a');
+        const uint8x16_t span = vdupq_n_u8(26);
+        while (end - (p + n) >= 16) {
+            uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p + n));
+            uint8x16_t offset = vsubq_u8(vorrq_u8(bytes, caseBit), lowest);
+            if (vminvq_u8(vcltq_u8(offset, span)) != 0xFF) {
+                break;
+            }
+            n += 16;
+        }
+#endif
+        while (p + n < end && classifyAscii(static_cast<unsigned char>(p[n])) == CC_LETTER) {
+            n++;
+        }
+        return n;
+    }
+
+    // GPT-2 maps every byte to a printable code point so tokens are valid text
+    std::array<int, 324> makeByteDecoder() {
+        std::array<int, 324> decoder;
+        decoder.fill(-1);
+        int extra = 0;
+        for (int b = 0; b < 256; b++) {
+            bool printable = (b >= 33 && b <= 126) || (b >= 161 && b <= 172) || (b >= 174 && b <= 255);
+            decoder[printable ? b : 256 + extra++] = b;
+        }
+        return decoder;
+    }
+
+    // Raw bytes of a token written in the byte-level alphabet
+    bool decodeByteLevel(const std::string& text, std::string& raw) {
+        static const std::array<int, 324> decoder = makeByteDecoder();
+        raw.clear();
+        for (size_t i = 0; i < text.size();) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            uint32_t cp;
+            if (c < 0x80) {
+                cp = c;
+                i += 1;
+            }
+            else if ((c & 0xE0) == 0xC0 && i + 1 < text.size()) {
+                cp = ((c & 0x1F) << 6) | (static_cast<unsigned char>(text[i + 1]) & 0x3F);
+                i += 2;
+            }
+            else {
+                return false;
+            }
+            if (cp >= decoder.size() || decoder[cp] < 0) {
+                return false;
+            }
+            raw.push_back(static_cast<char>(decoder[cp]));
+        }
+        return true;
+    }
+
+    struct Candidate {
+        int rank;
+        int position;
+        bool operator>(const Candidate& other) const {
+            return rank != other.rank ? rank > other.rank : position > other.position;
+        }
+    };
+}
+
+BpeTokenizer& BpeTokenizer::getInstance() {
+    static BpeTokenizer instance;
+    static std::once_flag loadOnce;
+    std::call_once(loadOnce, [] { instance.loadFromSettings(); });
+    return instance;
+}
+
+BpeTokenizer::BpeTokenizer()
+    : loaded(false),
+      cacheCapacity(DEFAULT_CACHE_ENTRIES),
+      cacheHits(0),
+      cacheMisses(0) {
+    std::fill(std::begin(byteTokens), std::end(byteTokens), -1);
+}
+
+void BpeTokenizer::loadFromSettings() {
+    ConfigManager& config = ConfigManager::getInstance();
+    long long entries = config.getIntSetting("tokenizer_cache_entries", DEFAULT_CACHE_ENTRIES);
+    setCacheCapacity(static_cast<size_t>(std::max(0LL, entries)));
+
+    std::string jsonPath = config.getSetting("tokenizer_path");
+    std::string vocabPath = config.getSetting("tokenizer_vocab");
+    std::string mergesPath = config.getSetting("tokenizer_merges");
+
+    if (jsonPath.empty() && vocabPath.empty()) {
+        fs::path dir = fs::path(config.getConfigDirectory()) / "tokenizer";
+        if (fs::exists(dir / "tokenizer.json")) {
+            jsonPath = (dir / "tokenizer.json").string();
+        }
+        else if (fs::exists(dir / "vocab.json") && fs::exists(dir / "merges.txt")) {
+            vocabPath = (dir / "vocab.json").string();
+            mergesPath = (dir / "merges.txt").string();
+        }
+        else {
+            // No tokenizer installed; callers fall back to estimates
+            return;
+        }
+    }
+
+    bool ok = !jsonPath.empty() ? loadTokenizerJson(jsonPath) : load(vocabPath, mergesPath);
+    if (!ok) {
+        ErrorHandler::getInstance().logWarning("Tokenizer not loaded: " + lastError, "BpeTokenizer");
+    }
+}
+
+bool BpeTokenizer::load(const std::string& vocabPath, const std::string& mergesPath) {
+    std::unordered_map<std::string, int> vocab;
+    std::vector<std::pair<std::string, std::string>> mergeList;
+
+    std::ifstream vocabFile(vocabPath);
+    if (!vocabFile) {
+        lastError = "Cannot open " + vocabPath;
+        return false;
+    }
+    json vocabJson = json::parse(vocabFile, nullptr, false);
+    if (!vocabJson.is_object()) {
+        lastError = "Invalid vocabulary file " + vocabPath;
+        return false;
+    }
+    for (auto it = vocabJson.begin(); it != vocabJson.end(); ++it) {
+        if (it.value().is_number_integer()) {
+            vocab.emplace(it.key(), it.value().get<int>());
+        }
+    }
+
+    std::ifstream mergesFile(mergesPath);
+    if (!mergesFile) {
+        lastError = "Cannot open " + mergesPath;
+        return false;
+    }
+    std::string line;
+    while (std::getline(mergesFile, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line.compare(0, 8, "#version") == 0) {
+            continue;
+        }
+        size_t space = line.find(' ');
+        if (space != std::string::npos) {
+            mergeList.emplace_back(line.substr(0, space), line.substr(space + 1));
+        }
+    }
+
+    return finishLoad(vocab, mergeList);
+}
+
+bool BpeTokenizer::loadTokenizerJson(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        lastError = "Cannot open " + path;
+        return false;
+    }
+    json tokenizerJson = json::parse(file, nullptr, false);
+    if (!tokenizerJson.is_object() || !tokenizerJson.contains("model") ||
+        !tokenizerJson["model"].is_object()) {
+        lastError = "Invalid tokenizer file " + path;
+        return false;
+    }
+
+    const json& model = tokenizerJson["model"];
+    if (model.contains("type") && model["type"] != "BPE") {
+        lastError = "Tokenizer model is not BPE: " + path;
+        return false;
+    }
+    if (!model.contains("vocab") || !model["vocab"].is_object() ||
+        !model.contains("merges") || !model["merges"].is_array()) {
+        lastError = "Tokenizer file lacks vocab or merges: " + path;
+        return false;
+    }
+
+    std::unordered_map<std::string, int> vocab;
+    for (auto it = model["vocab"].begin(); it != model["vocab"].end(); ++it) {
+        if (it.value().is_number_integer()) {
+            vocab.emplace(it.key(), it.value().get<int>());
+        }
+    }
+
+    // Merges are "left right" strings, or [left, right] pairs in newer files
+    std::vector<std::pair<std::string, std::string>> mergeList;
+    for (const auto& merge : model["merges"]) {
+        if (merge.is_string()) {
+            const std::string& text = merge.get_ref<const std::string&>();
+            size_t space = text.find(' ');
+            if (space != std::string::npos) {
+                mergeList.emplace_back(text.substr(0, space), text.substr(space + 1));
+            }
+        }
+        else if (merge.is_array() && merge.size() == 2 && merge[0].is_string() && merge[1].is_string()) {
+            mergeList.emplace_back(merge[0].get<std::string>(), merge[1].get<std::string>());
+        }
+    }
+
+    return finishLoad(vocab, mergeList);
+}
+
+bool BpeTokenizer::finishLoad(const std::unordered_map<std::string, int>& vocab,
+    const std::vector<std::pair<std::string, std::string>>& mergeList) {
+    loaded = false;
+    merges.clear();
+    tokenBytes.clear();
+    std::fill(std::begin(byteTokens), std::end(byteTokens), -1);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cacheIndex.clear();
+        cacheOrder.clear();
+    }
+
+    int maxId = -1;
+    for (const auto& entry : vocab) {
+        maxId = std::max(maxId, entry.second);
+    }
+    tokenBytes.resize(static_cast<size_t>(maxId + 1));
+
+    // Special tokens are not in the byte-level alphabet and are skipped
+    std::string raw;
+    for (const auto& [text, id] : vocab) {
+        if (id < 0 || !decodeByteLevel(text, raw)) {
+            continue;
+        }
+        tokenBytes[id] = raw;
+        if (raw.size() == 1) {
+            int& byteToken = byteTokens[static_cast<unsigned char>(raw[0])];
+            if (byteToken < 0 || id < byteToken) {
+                byteToken = id;
+            }
+        }
+    }
+    for (int b = 0; b < 256; b++) {
+        if (byteTokens[b] < 0) {
+            lastError = "Vocabulary has no token for byte " + std::to_string(b);
+            return false;
+        }
+    }
+
+    int rank = 0;
+    for (const auto& [left, right] : mergeList) {
+        auto leftIt = vocab.find(left);
+        auto rightIt = vocab.find(right);
+        auto mergedIt = vocab.find(left + right);
+        if (leftIt == vocab.end() || rightIt == vocab.end() || mergedIt == vocab.end()) {
+            continue;
+        }
+        uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(leftIt->second)) << 32) |
+            static_cast<uint32_t>(rightIt->second);
+        merges.emplace(key, Merge{ rank++, mergedIt->second });
+    }
+
+    lastError.clear();
+    loaded = true;
+    return true;
+}
+
+bool BpeTokenizer::isLoaded() const {
+    return loaded;
+}
+
+std::string BpeTokenizer::getLastError() const {
+    return lastError;
+}
+
+size_t BpeTokenizer::nextPiece(const char* begin, const char* end) {
+    const char* p = begin;
+
+    // Contractions: 's 't 'm 'd 're 've 'll
+    if (*p == '\'' && end - p >= 2) {
+        char c = p[1];
+        if (c == 's' || c == 't' || c == 'm' || c == 'd') {
+            return 2;
+        }
+        if (end - p >= 3 && ((c == 'r' && p[2] == 'e') || (c == 'v' && p[2] == 'e') || (c == 'l' && p[2] == 'l'))) {
+            return 3;
+        }
+    }
+
+    size_t length;
+    CharClass cls = classify(p, end, length);
+
+    if (cls == CC_SPACE) {
+        const char* last = p;
+        const char* q = p;
+        while (q < end) {
+            size_t spaceLength;
+            if (classify(q, end, spaceLength) != CC_SPACE) {
+                break;
+            }
+            last = q;
+            q += spaceLength;
+        }
+
+        // Trailing whitespace is one piece; otherwise the last whitespace
+        // character is left to start the next piece
+        if (q == end) {
+            return q - begin;
+        }
+        if (last > p) {
+            return last - begin;
+        }
+        if (*p != ' ') {
+            return length;
+        }
+
+        // A single space is a prefix of the run that follows
+        p += 1;
+        cls = classify(p, end, length);
+    }
+
+    const char* q = p + length;
+    while (q < end) {
+        if (cls == CC_LETTER) {
+            q += asciiLetterRun(q, end);
+            if (q >= end) {
+                break;
+            }
+        }
+        size_t nextLength;
+        if (classify(q, end, nextLength) != cls) {
+            break;
+        }
+        q += nextLength;
+    }
+    return q - begin;
+}
+
+void BpeTokenizer::mergePiece(std::string_view piece, std::vector<int>& out) const {
+    thread_local std::vector<int> ids;
+    thread_local std::vector<int> next;
+    thread_local std::vector<int> prev;
+    thread_local std::vector<Candidate> heapStorage;
+
+    int n = static_cast<int>(piece.size());
+    ids.resize(n);
+    next.resize(n);
+    prev.resize(n);
+    for (int i = 0; i < n; i++) {
+        ids[i] = byteTokens[static_cast<unsigned char>(piece[i])];
+        prev[i] = i - 1;
+        next[i] = i + 1 < n ? i + 1 : -1;
+    }
+
+    auto findMerge = [this](int left, int right) -> const Merge* {
+        uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(left)) << 32) | static_cast<uint32_t>(right);
+        auto it = merges.find(key);
+        return it == merges.end() ? nullptr : &it->second;
+    };
+
+    // Min-heap on (rank, position): lowest rank first, leftmost on ties.
+    // Stale candidates are skipped when popped.
+    std::vector<Candidate>& heap = heapStorage;
+    heap.clear();
+    auto pushCandidate = [&](int position) {
+        if (position >= 0 && next[position] >= 0) {
+            if (const Merge* merge = findMerge(ids[position], ids[next[position]])) {
+                heap.push_back(Candidate{ merge->rank, position });
+                std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+            }
+        }
+    };
+
+    for (int i = 0; i + 1 < n; i++) {
+        pushCandidate(i);
+    }
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        Candidate candidate = heap.back();
+        heap.pop_back();
+
+        int position = candidate.position;
+        int right = next[position];
+        if (ids[position] < 0 || right < 0) {
+            continue;
+        }
+        const Merge* merge = findMerge(ids[position], ids[right]);
+        if (!merge || merge->rank != candidate.rank) {
+            continue;
+        }
+
+        ids[position] = merge->id;
+        ids[right] = -1;
+        next[position] = next[right];
+        if (next[right] >= 0) {
+            prev[next[right]] = position;
+        }
+
+        pushCandidate(prev[position]);
+        pushCandidate(position);
+    }
+
+    for (int i = 0; i >= 0 && i < n; i = next[i]) {
+        out.push_back(ids[i]);
+    }
+}
+
+size_t BpeTokenizer::tokenizePiece(std::string_view piece, std::vector<int>* out) const {
+    if (piece.size() == 1) {
+        if (out) {
+            out->push_back(byteTokens[static_cast<unsigned char>(piece[0])]);
+        }
+        return 1;
+    }
+
+    bool cacheable = piece.size() <= MAX_CACHED_PIECE && cacheCapacity.load(std::memory_order_relaxed) > 0;
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cacheIndex.find(piece);
+        if (it != cacheIndex.end()) {
+            cacheOrder.splice(cacheOrder.begin(), cacheOrder, it->second);
+            const std::vector<int>& tokens = it->second->second;
+            if (out) {
+                out->insert(out->end(), tokens.begin(), tokens.end());
+            }
+            cacheHits.fetch_add(1, std::memory_order_relaxed);
+            return tokens.size();
+        }
+    }
+
+    thread_local std::vector<int> merged;
+    merged.clear();
+    mergePiece(piece, merged);
+
+    if (cacheable) {
+        cacheMisses.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (cacheIndex.find(piece) == cacheIndex.end()) {
+            cacheOrder.emplace_front(std::string(piece), merged);
+            cacheIndex.emplace(cacheOrder.front().first, cacheOrder.begin());
+            while (cacheOrder.size() > cacheCapacity.load(std::memory_order_relaxed)) {
+                cacheIndex.erase(cacheOrder.back().first);
+                cacheOrder.pop_back();
+            }
+        }
+    }
+
+    if (out) {
+        out->insert(out->end(), merged.begin(), merged.end());
+    }
+    return merged.size();
+}
+
+std::vector<int> BpeTokenizer::encode(std::string_view text) const {
+    std::vector<int> ids;
+    if (!loaded) {
+        return ids;
+    }
+    ids.reserve(text.size() / 4 + 1);
+    splitPieces(text, [&](std::string_view piece) {
+        tokenizePiece(piece, &ids);
+        });
+    return ids;
+}
+
+size_t BpeTokenizer::countTokens(std::string_view text) const {
+    size_t count = 0;
+    if (!loaded) {
+        return count;
+    }
+    splitPieces(text, [&](std::string_view piece) {
+        count += tokenizePiece(piece, nullptr);
+        });
+    return count;
+}
+
+std::string BpeTokenizer::decode(const std::vector<int>& ids) const {
+    std::string text;
+    for (int id : ids) {
+        if (id >= 0 && static_cast<size_t>(id) < tokenBytes.size()) {
+            text += tokenBytes[id];
+        }
+    }
+    return text;
+}
+
+void BpeTokenizer::setCacheCapacity(size_t entries) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheCapacity.store(entries, std::memory_order_relaxed);
+    while (cacheOrder.size() > entries) {
+        cacheIndex.erase(cacheOrder.back().first);
+        cacheOrder.pop_back();
+    }
+}
+
+TokenizerStats BpeTokenizer::getStats() const {
+    TokenizerStats stats;
+    stats.cacheHits = cacheHits.load(std::memory_order_relaxed);
+    stats.cacheMisses = cacheMisses.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    stats.cacheEntries = cacheOrder.size();
+    return stats;
+}
@@ -0,0 +1,193 @@
+#include "include/utils/ContextWindow.h"
+#include "include/config/ConfigManager.h"
+#include <algorithm>
+
+namespace {
+    const size_t DEFAULT_BUDGET = 32000;
+    const size_t DEFAULT_MAX_TURNS = 20;
+}
+
+ContextWindow::ContextWindow()
+    : policy(ContextPolicy::CP_SLIDING_WINDOW),
+      budget(DEFAULT_BUDGET),
+      maxTurns(DEFAULT_MAX_TURNS),
+      runningTotal(0) {
+}
+
+void ContextWindow::loadSettings() {
+    ConfigManager& config = ConfigManager::getInstance();
+
+    std::string policyName = config.getSetting("context_policy", "window");
+    if (policyName == "all") {
+        policy = ContextPolicy::CP_KEEP_ALL;
+    }
+    else if (policyName == "turns") {
+        policy = ContextPolicy::CP_LAST_TURNS;
+    }
+    else {
+        policy = ContextPolicy::CP_SLIDING_WINDOW;
+    }
+
+    budget = static_cast<size_t>(std::max(0LL, config.getIntSetting("context_budget", DEFAULT_BUDGET)));
+    maxTurns = static_cast<size_t>(std::max(1LL, config.getIntSetting("context_turns", DEFAULT_MAX_TURNS)));
+}
+
+void ContextWindow::setPolicy(ContextPolicy policy) {
+    this->policy = policy;
+}
+
+ContextPolicy ContextWindow::getPolicy() const {
+    return policy;
+}
+
+void ContextWindow::setBudget(size_t tokens) {
+    budget = tokens;
+}
+
+size_t ContextWindow::getBudget() const {
+    return budget;
+}
+
+void ContextWindow::setMaxTurns(size_t turns) {
+    maxTurns = std::max<size_t>(1, turns);
+}
+
+void ContextWindow::setTokenCounter(TokenCounter counter) {
+    this->counter = std::move(counter);
+    // Estimates from the old counter are stale; select() recounts lazily
+    tokenCounts.clear();
+    runningTotal = 0;
+}
+
+void ContextWindow::pin(size_t index) {
+    auto it = std::lower_bound(pinned.begin(), pinned.end(), index);
+    if (it == pinned.end() || *it != index) {
+        pinned.insert(it, index);
+    }
+}
+
+void ContextWindow::clear() {
+    tokenCounts.clear();
+    runningTotal = 0;
+    pinned.clear();
+}
+
+size_t ContextWindow::totalTokens() const {
+    return runningTotal;
+}
+
+ContextStats ContextWindow::getStats() const {
+    return stats;
+}
+
+size_t ContextWindow::estimateTokens(const Message& message) {
+    size_t asciiBytes = 0;
+    size_t otherCharacters = 0;
+    for (const std::string* text : { &message.getRole(), &message.getContent() }) {
+        for (unsigned char c : *text) {
+            if (c < 0x80) {
+                asciiBytes++;
+            }
+            else if ((c & 0xC0) != 0x80) {
+                // Count lead bytes only: one token per non-ASCII character
+                otherCharacters++;
+            }
+        }
+    }
+    return MESSAGE_OVERHEAD_TOKENS + (asciiBytes + 3) / 4 + otherCharacters;
+}
+
+void ContextWindow::countNewMessages(const ConversationHistory& history) {
+    if (history.size() < tokenCounts.size()) {
+        // The conversation was cleared or replaced behind our back
+        clear();
+    }
+
+    for (size_t i = tokenCounts.size(); i < history.size(); i++) {
+        size_t tokens = counter ? counter(history[i]) : estimateTokens(history[i]);
+        tokenCounts.push_back(tokens);
+        runningTotal += tokens;
+    }
+}
+
+bool ContextWindow::isPinned(const ConversationHistory& history, size_t index) const {
+    return history[index].getRole() == "system" ||
+        std::binary_search(pinned.begin(), pinned.end(), index);
+}
+
+ConversationHistory ContextWindow::select(const ConversationHistory& history) {
+    countNewMessages(history);
+
+    size_t count = history.size();
+    std::vector<bool> keep(count, false);
+    size_t used = 0;
+
+    // Messages that are always sent
+    for (size_t i = 0; i < count; i++) {
+        if (isPinned(history, i) || i + 1 == count) {
+            keep[i] = true;
+            used += tokenCounts[i];
+        }
+    }
+
+    // Walk back from the newest message, keeping whatever the policy allows.
+    // The new turn itself does not count toward maxTurns.
+    size_t turns = 0;
+    size_t windowStart = count;
+    bool cut = false;
+    for (size_t i = count; i-- > 0;) {
+        bool countsAsTurn = history[i].getRole() == "user" && i + 1 != count;
+        if (keep[i]) {
+            if (countsAsTurn) {
+                turns++;
+            }
+            windowStart = i;
+            continue;
+        }
+
+        if (policy == ContextPolicy::CP_LAST_TURNS && turns >= maxTurns) {
+            cut = true;
+            break;
+        }
+        if (policy != ContextPolicy::CP_KEEP_ALL && budget > 0 && used + tokenCounts[i] > budget) {
+            // The window ends at the first message that does not fit
+            cut = true;
+            break;
+        }
+
+        keep[i] = true;
+        used += tokenCounts[i];
+        windowStart = i;
+        if (countsAsTurn) {
+            turns++;
+        }
+    }
+
+    // A trimmed window opens with a user message, not the reply to one left out
+    for (size_t i = windowStart; cut && i + 1 < count && history[i].getRole() != "user"; i++) {
+        if (!isPinned(history, i)) {
+            keep[i] = false;
+            used -= tokenCounts[i];
+        }
+    }
+
+    size_t dropped = static_cast<size_t>(std::count(keep.begin(), keep.end(), false));
+    stats.requests++;
+    stats.lastTokensSent = used;
+    stats.lastTokensSaved = runningTotal - used;
+    stats.lastDropped = dropped;
+    stats.tokensSent += used;
+    stats.tokensSaved += runningTotal - used;
+
+    if (dropped == 0) {
+        return history;
+    }
+
+    ConversationHistory trimmed;
+    for (size_t i = 0; i < count; i++) {
+        if (keep[i]) {
+            trimmed.push_back(history[i]);
+        }
+    }
+    return trimmed;
+}
@@ -0,0 +1,141 @@
+#include "include/utils/CurlHandlePool.h"
+
+namespace {
+    // Idle handles kept by default; each one may hold a live connection
+    const size_t DEFAULT_MAX_IDLE_HANDLES = 8;
+}
+
+CurlHandlePool::CurlHandlePool()
+    : share(nullptr), maxIdleHandles(DEFAULT_MAX_IDLE_HANDLES), hits(0), misses(0) {
+    share = curl_share_init();
+    if (share) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &CurlHandlePool::lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &CurlHandlePool::unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        // Connections are not shared here: libcurl does not support sharing the
+        // connection cache between concurrent threads. Each pooled handle keeps
+        // its own live connection instead.
+    }
+}
+
+CurlHandlePool::~CurlHandlePool() {
+    shutdown();
+}
+
+CurlHandlePool& CurlHandlePool::getInstance() {
+    static CurlHandlePool instance;
+    return instance;
+}
+
+CURL* CurlHandlePool::acquire() {
+    CURL* handle = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!idleHandles.empty()) {
+            handle = idleHandles.back();
+            idleHandles.pop_back();
+        }
+    }
+
+    if (handle) {
+        hits++;
+        // Reset keeps live connections, the session cache and the share
+        curl_easy_reset(handle);
+    }
+    else {
+        misses++;
+        handle = curl_easy_init();
+        if (!handle) {
+            return nullptr;
+        }
+    }
+
+    prepareHandle(handle);
+    return handle;
+}
+
+void CurlHandlePool::release(CURL* handle) {
+    if (!handle) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (idleHandles.size() < maxIdleHandles) {
+            idleHandles.push_back(handle);
+            return;
+        }
+    }
+
+    curl_easy_cleanup(handle);
+}
+
+CurlPoolStats CurlHandlePool::getStats() const {
+    CurlPoolStats stats;
+    stats.hits = hits.load();
+    stats.misses = misses.load();
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stats.idle = idleHandles.size();
+    }
+    return stats;
+}
+
+void CurlHandlePool::setMaxIdle(size_t maxIdle) {
+    std::vector<CURL*> surplus;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        maxIdleHandles = maxIdle;
+        while (idleHandles.size() > maxIdleHandles) {
+            surplus.push_back(idleHandles.back());
+            idleHandles.pop_back();
+        }
+    }
+
+    for (CURL* handle : surplus) {
+        curl_easy_cleanup(handle);
+    }
+}
+
+void CurlHandlePool::shutdown() {
+    std::vector<CURL*> handles;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        handles.swap(idleHandles);
+    }
+
+    for (CURL* handle : handles) {
+        curl_easy_cleanup(handle);
+    }
+
+    if (share) {
+        curl_share_cleanup(share);
+        share = nullptr;
+    }
+}
+
+void CurlHandlePool::prepareHandle(CURL* handle) const {
+    if (share) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, share);
+    }
+
+    // Keep idle connections alive between chat turns
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, 60L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, 30L);
+
+    // Signals are not thread-safe; pooled handles are used from many threads
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+}
+
+void CurlHandlePool::lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    auto* pool = static_cast<CurlHandlePool*>(userptr);
+    pool->shareMutexes[data].lock();
+}
+
+void CurlHandlePool::unlockShare(CURL*, curl_lock_data data, void* userptr) {
+    auto* pool = static_cast<CurlHandlePool*>(userptr);
+    pool->shareMutexes[data].unlock();
+}
@@ -2,12 +2,28 @@
 #include "include/utils/DeepSeekAPI.h"
 #include "include/config/ConfigManager.h"
 #include "include/utils/ErrorHandler.h"
-#include <QThread>
+#include "include/utils/BpeTokenizer.h"
+#include "include/utils/Executor.h"
+#include <QCoreApplication>
+#include <QPointer>
+#include <QTimer>
 #include <QDebug>
 #include <QMetaType>
 
 // ChatSession ʵ
-ChatSession::ChatSession() : apiKey("") {}
+ChatSession::ChatSession() : apiKey("") {
+    context.loadSettings();
+    requestTimeout = std::chrono::seconds(ConfigManager::getInstance().getIntSetting("request_timeout_seconds", 0));
+
+    // Size prompts with the tokenizer when one is installed
+    BpeTokenizer& tokenizer = BpeTokenizer::getInstance();
+    if (tokenizer.isLoaded()) {
+        context.setTokenCounter([&tokenizer](const Message& message) {
+            return ContextWindow::MESSAGE_OVERHEAD_TOKENS +
+                tokenizer.countTokens(message.getRole()) + tokenizer.countTokens(message.getContent());
+            });
+    }
+}
 
 bool ChatSession::initialize(const std::string& apiKey) {
     this->apiKey = apiKey;
@@ -15,14 +31,22 @@ bool ChatSession::initialize(const std::string& apiKey) {
 }
 
 std::string ChatSession::sendMessage(const std::string& message) {
-    // Add user message to history
+    // Add user message to history; the copy is what to go back to if the turn is cancelled
+    ConversationHistory before = history;
     history.push_back(Message("user", message));
 
     // Get response from API
-    std::string response = chatCompletion(apiKey, history);
+    CompletionOptions options = beginRequest();
+    std::string response = chatCompletion(apiKey, context.select(history), model, 0.7f, 1000, options);
 
-    // Add assistant message to history
-    history.push_back(Message("assistant", response));
+    // Add assistant message to history; a cancelled turn is dropped, so
+    // later turns do not resend a prompt that never got a reply
+    if (!options.cancellation.isCancelled()) {
+        history.push_back(Message("assistant", response));
+    }
+    else {
+        history = before;
+    }
 
     return response;
 }
@@ -32,33 +56,73 @@ std::string ChatSession::sendMessageStreaming(
     std::function<void(const std::string&)> callback
 ) {
     // Add user message to history
+    ConversationHistory before = history;
     history.push_back(Message("user", message));
 
     // Get streaming response from API
-    std::string response = streamingChatCompletion(apiKey, history, callback);
+    CompletionOptions options = beginRequest();
+    std::string response = streamingChatCompletion(apiKey, context.select(history), callback,
+        model, 0.7f, 1000, options);
 
-    // Add assistant message to history
-    history.push_back(Message("assistant", response));
+    // Add assistant message to history; a cancelled stream keeps what arrived
+    if (!options.cancellation.isCancelled() || !response.empty()) {
+        history.push_back(Message("assistant", response));
+    }
+    else {
+        history = before;
+    }
 
     return response;
 }
 
 void ChatSession::clearHistory() {
     history.clear();
+    context.clear();
 }
 
-const std::vector<Message>& ChatSession::getHistory() const {
+const ConversationHistory& ChatSession::getHistory() const {
     return history;
 }
 
+ContextWindow& ChatSession::getContextWindow() {
+    return context;
+}
+
+void ChatSession::cancel() {
+    CancellationToken request;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        request = activeRequest;
+    }
+    request.cancel();
+}
+
+void ChatSession::setRequestTimeout(std::chrono::milliseconds timeout) {
+    requestTimeout = timeout;
+}
+
+CompletionOptions ChatSession::beginRequest() {
+    CompletionOptions options;
+    if (requestTimeout.count() > 0) {
+        options.deadline = std::chrono::steady_clock::now() + requestTimeout;
+    }
+
+    std::lock_guard<std::mutex> lock(requestMutex);
+    activeRequest = options.cancellation;
+    return options;
+}
+
 // DeepSeekAPI ʵ
 DeepSeekAPI::DeepSeekAPI(QObject* parent) : QObject(parent) {
     // עstd::stringԱźŲۻʹ
     qRegisterMetaType<std::string>("std::string");
     getApiKey();
+    requestTimeout = std::chrono::seconds(ConfigManager::getInstance().getIntSetting("request_timeout_seconds", 0));
 }
 
 DeepSeekAPI::~DeepSeekAPI() {
+    // Abort transfers still in flight; their replies find the object gone and are dropped
+    cancelPending();
 }
 
 bool DeepSeekAPI::getApiKey() {
@@ -72,42 +136,66 @@ bool DeepSeekAPI::getApiKey() {
     return true;
 }
 
-void DeepSeekAPI::sendMessage(const std::string& message, const std::vector<Message>& history) {
-    // ̴߳API󣬱UI
-    QThread* thread = QThread::create([this, message, history]() {
-        std::string response = sendRequest(message, history);
-        // ʹQStringת
-        emit responseReceived(QString::fromStdString(response));
-        });
+void DeepSeekAPI::sendMessage(const std::string& message, const ConversationHistory& history) {
+    // The request engine runs the transfer without blocking the UI or a worker thread
+    sendRequest(message, history);
+}
 
-    // ߳ɺԶɾ
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+void DeepSeekAPI::cancelPending() {
+    pending.cancel();
+    pending = CancellationToken();
 }
 
-std::string DeepSeekAPI::sendRequest(const std::string& message, const std::vector<Message>& history) {
+void DeepSeekAPI::sendRequest(const std::string& message, const ConversationHistory& history) {
     qDebug() << "Sending request to API with message:" << QString::fromStdString(message);
 
     // API keyΪգʹʾģʽ
     if (apiKey.empty()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(500)); // ģӳ
-        return "API key not set. Please configure your API key in settings. You said: " + message;
+        QString reply = QString::fromStdString(
+            "API key not set. Please configure your API key in settings. You said: " + message);
+        QTimer::singleShot(500, this, [this, reply]() {
+            emit responseReceived(reply);
+            });
+        return;
     }
 
     try {
         // ʹⲿchatCompletionʵAPI
         // ע⣺Ҫһµhistoryǰmessage
-        std::vector<Message> newHistory = history;
-        if (newHistory.empty() || newHistory.back().role != "user" || newHistory.back().content != message) {
+        // Snapshotting the history is O(1); the copy shares its chunks
+        ConversationHistory newHistory = history;
+        if (newHistory.empty() || newHistory.back().getRole() != "user" || newHistory.back().getContent() != message) {
             newHistory.push_back(Message("user", message));
         }
-        std::string response = ::chatCompletion(apiKey, newHistory);
-        qDebug() << "API Response:" << QString::fromStdString(response);
-        return response;
+        CompletionOptions options;
+        options.cancellation = pending;
+        if (requestTimeout.count() > 0) {
+            options.deadline = std::chrono::steady_clock::now() + requestTimeout;
+        }
+
+        // Building the body and a cache lookup that may touch the disk stay
+        // off the UI thread too
+        // The reply is checked and emitted on the application thread, which
+        // is also where this object is destroyed, so the check cannot race
+        QPointer<DeepSeekAPI> self(this);
+        CancellationToken request = pending;
+        std::string key = apiKey;
+        Executor::getInstance().submit([self, key, newHistory, options, request]() {
+            ::chatCompletionAsync(key, newHistory, [self, request](const std::string& response) {
+                QString reply = QString::fromStdString(response);
+                QMetaObject::invokeMethod(QCoreApplication::instance(), [self, request, reply]() {
+                    if (!self || request.isCancelled()) {
+                        return;
+                    }
+                    qDebug() << "API Response:" << reply;
+                    emit self->responseReceived(reply);
+                    }, Qt::QueuedConnection);
+                }, "deepseek-chat", 0.7f, 1000, options);
+            }, TaskPriority::TP_HIGH);
     }
     catch (const std::exception& e) {
         std::string errorMsg = std::string("Error in API request: ") + e.what();
         qDebug() << "API Error:" << QString::fromStdString(errorMsg);
-        return errorMsg;
+        emit responseReceived(QString::fromStdString(errorMsg));
     }
 }
@@ -1,129 +1,131 @@
 // src/utils/DeepSeekChatAPI.cpp
 #include "include/utils/DeepSeekAPI.h"
+#include "include/utils/RequestEngine.h"
+#include "include/utils/RateLimiter.h"
+#include "include/utils/SseParser.h"
+#include "include/utils/DeltaExtractor.h"
+#include "include/utils/JsonWriter.h"
+#include "include/utils/ResponseCache.h"
+#include "include/utils/RequestCoalescer.h"
+#include "include/utils/Executor.h"
+#include "include/utils/Metrics.h"
+#include "include/utils/Tracer.h"
 #include <curl/curl.h>
+#include <cstring>
 #include <nlohmann/json.hpp>
+#include <future>
+#include <memory>
+#include <string_view>
 
 using json = nlohmann::json;
 
-// Callback for handling HTTP response data
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    userp->append((char*)contents, size * nmemb);
-    return size * nmemb;
-}
+static const char* const CHAT_COMPLETIONS_URL = "https://api.deepseek.com/v1/chat/completions";
 
-// Callback for handling streaming data with improved error handling
-static size_t StreamingWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    auto callback = reinterpret_cast<std::function<void(const std::string&)>*>(userp);
-    std::string data((char*)contents, size * nmemb);
-
-    // Each line starts with "data: " for SSE
-    if (data.find("data: ") == 0) {
-        data = data.substr(6); // Skip "data: "
-
-        // Skip keep-alive lines and end markers
-        if (data != "[DONE]" && !data.empty() && data != "\n") {
-            try {
-                // Strip any trailing characters that might corrupt the JSON
-                size_t jsonEnd = data.find_last_of('}');
-                if (jsonEnd != std::string::npos && jsonEnd < data.length() - 1) {
-                    data = data.substr(0, jsonEnd + 1);
-                }
-
-                json responseJson = json::parse(data);
-
-                // Extract content from the response
-                if (responseJson.contains("choices") && responseJson["choices"].is_array() &&
-                    responseJson["choices"].size() > 0 &&
-                    responseJson["choices"][0].contains("delta") &&
-                    responseJson["choices"][0]["delta"].contains("content")) {
-
-                    std::string content = responseJson["choices"][0]["delta"]["content"];
-                    (*callback)(content);
-                }
-            }
-            catch (const json::parse_error&) {
-                // Just ignore parse errors for streaming responses
-            }
-        }
-    }
+// Latency of completions that went upstream; cache hits are counted by the cache
+struct ChatMetrics {
+    MetricHistogram& latency;
+    MetricHistogram& streamLatency;
+    MetricHistogram& firstToken;
+    MetricHistogram& tokensPerSecond;
+};
 
-    return size * nmemb;
+static ChatMetrics& chatMetrics() {
+    Metrics& registry = Metrics::getInstance();
+    const std::vector<double>& bounds = Metrics::latencyBounds();
+    static ChatMetrics metrics{
+        registry.histogram("pichat_chat_latency_seconds", "Time until a completion's full reply", 1e-6, bounds, "kind=\"whole\""),
+        registry.histogram("pichat_chat_latency_seconds", "Time until a completion's full reply", 1e-6, bounds, "kind=\"stream\""),
+        registry.histogram("pichat_chat_first_token_seconds", "Time until the first streamed token", 1e-6, bounds),
+        registry.histogram("pichat_chat_tokens_per_second", "Streaming rate after the first token", 0.01,
+            { 1, 2, 5, 10, 20, 30, 50, 75, 100, 150, 200, 300, 500 })
+    };
+    return metrics;
 }
 
-// Create JSON request body for DeepSeek API
-static std::string createChatRequestBody(
-    const std::vector<Message>& messages,
+// Progress of one streamed completion, for chatMetrics()
+struct StreamTiming {
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point firstToken;
+    long long deltas = 0;
+    long long completionTokens = 0;  // From the usage chunk, if the server sent one
+};
+
+// Write the JSON request body for DeepSeek API into body, reusing its capacity.
+// Keys are written in the sorted order nlohmann::json uses, so the bytes match
+// what serializing a json object would produce.
+static void createChatRequestBody(
+    std::string& body,
+    const ConversationHistory& messages,
     const std::string& model,
     float temperature,
     int maxTokens,
     bool stream
 ) {
-    json requestBody;
+    TraceSpan span("createChatRequestBody", "chat");
 
-    // Convert messages to JSON format
-    json messagesJson = json::array();
+    // Message fragments are cached, so a turn only serializes what is new
+    size_t estimate = 96 + model.size();
     for (const auto& message : messages) {
-        messagesJson.push_back({
-            {"role", message.role},
-            {"content", message.content}
-            });
+        estimate += message.jsonFragment()->size() + 1;
     }
+    body.clear();
+    body.reserve(estimate);
 
-    requestBody["model"] = model;
-    requestBody["messages"] = messagesJson;
-    requestBody["temperature"] = temperature;
-    requestBody["max_tokens"] = maxTokens;
-    requestBody["stream"] = stream;
+    body.append("{\"max_tokens\":");
+    JsonWriter::appendInt(body, maxTokens);
 
-    return requestBody.dump();
-}
-
-// ʵ chatCompletion 
-std::string chatCompletion(
-    const std::string& apiKey,
-    const std::vector<Message>& messages,
-    const std::string& model,
-    float temperature,
-    int maxTokens
-) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        return "Error: Failed to initialize CURL";
+    body.append(",\"messages\":[");
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (i > 0) {
+            body.push_back(',');
+        }
+        body.append(*messages[i].jsonFragment());
     }
 
-    std::string responseData;
-    std::string requestBody = createChatRequestBody(messages, model, temperature, maxTokens, false);
-
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string authHeader = "Authorization: Bearer " + apiKey;
-    headers = curl_slist_append(headers, authHeader.c_str());
-
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.deepseek.com/v1/chat/completions");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, requestBody.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseData);
+    body.append("],\"model\":");
+    JsonWriter::appendString(body, model);
+    body.append(",\"stream\":");
+    JsonWriter::appendBool(body, stream);
+    body.append(",\"temperature\":");
+    JsonWriter::appendFloat(body, temperature);
+    body.push_back('}');
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+// Create the HTTP request for a chat completion call; the body is filled in by the caller
+static HttpRequest createChatRequest(const std::string& apiKey) {
+    HttpRequest request;
+    request.url = CHAT_COMPLETIONS_URL;
+    request.headers.push_back("Content-Type: application/json");
+    request.headers.push_back("Authorization: Bearer " + apiKey);
+    return request;
+}
 
-    if (res != CURLE_OK) {
-        return std::string("CURL error: ") + curl_easy_strerror(res);
+// Extract the reply text from a non-streaming response; ok is set only for a real reply
+static std::string parseCompletionResponse(const HttpResponse& response, bool& ok) {
+    TraceSpan span("parseCompletionResponse", "chat");
+    ok = false;
+    if (response.result != CURLE_OK) {
+        return "CURL error: " + response.error;
     }
 
+    const std::string& responseData = response.body;
     try {
         json responseJson = json::parse(responseData);
         if (responseJson.contains("choices") && responseJson["choices"].is_array() &&
             responseJson["choices"].size() > 0 &&
             responseJson["choices"][0].contains("message") &&
-            responseJson["choices"][0]["message"].contains("content")) {
+            responseJson["choices"][0]["message"].contains("content") &&
+            responseJson["choices"][0]["message"]["content"].is_string()) {
 
-            return responseJson["choices"][0]["message"]["content"];
+            ok = true;
+            return responseJson["choices"][0]["message"]["content"].get<std::string>();
         }
         else if (responseJson.contains("error")) {
-            return "API Error: " + responseJson["error"]["message"].get<std::string>();
+            const json& error = responseJson["error"];
+            if (error.contains("message") && error["message"].is_string()) {
+                return "API Error: " + error["message"].get<std::string>();
+            }
+            return "API Error: " + error.dump(-1, ' ', false, json::error_handler_t::replace);
         }
         else {
             return "Error: Invalid response format\n" + responseData;
@@ -132,49 +134,266 @@ std::string chatCompletion(
     catch (const json::parse_error& e) {
         return std::string("JSON parse error: ") + e.what() + "\nResponse: " + responseData;
     }
+    catch (const json::exception&) {
+        // Every caller waits on a reply, so a malformed one still completes
+        return "Error: Invalid response format\n" + responseData;
+    }
 }
 
-// ʵ streamingChatCompletion 
-std::string streamingChatCompletion(
+bool isErrorReply(const std::string& reply) {
+    static const char* const prefixes[] = {
+        "CURL error: ", "API Error: ", "Error: Invalid response format", "JSON parse error: "
+    };
+    for (const char* prefix : prefixes) {
+        if (reply.compare(0, std::strlen(prefix), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void forwardChatCompletionAsync(
+    const std::string& apiKey,
+    std::string body,
+    std::function<bool(const char* data, size_t size)> onData,
+    std::function<void(long statusCode, const std::string& body, const std::string& error)> onComplete,
+    const CompletionOptions& options
+) {
+    HttpRequest request = createChatRequest(apiKey);
+    request.body = std::move(body);
+    request.onData = std::move(onData);
+    request.cancellation = options.cancellation;
+    request.deadline = options.deadline;
+
+    RateLimiter::getInstance().submit(std::move(request), [onComplete](HttpResponse response) {
+        long status = response.result == CURLE_OK ? response.statusCode : 0;
+        onComplete(status, response.body, response.error);
+        });
+}
+
+void warmUpChatConnection(const std::string& apiKey) {
+    HttpRequest request = createChatRequest(apiKey);
+    request.body = "{}";
+    RequestEngine::getInstance().submit(std::move(request), [](HttpResponse) {});
+}
+
+void chatCompletionAsync(
     const std::string& apiKey,
-    const std::vector<Message>& messages,
+    const ConversationHistory& messages,
+    std::function<void(const std::string&)> onComplete,
+    const std::string& model,
+    float temperature,
+    int maxTokens,
+    const CompletionOptions& options
+) {
+    ResponseCache& cache = ResponseCache::getInstance();
+    bool useCache = !options.bypassCache && cache.isEnabled();
+    CacheKey key;
+    if (useCache || options.coalesce) {
+        key = ResponseCache::makeKey(messages, model, temperature, maxTokens);
+    }
+    if (useCache) {
+        std::string cached;
+        if (cache.lookup(key, cached)) {
+            onComplete(cached);
+            return;
+        }
+    }
+
+    HttpRequest request = createChatRequest(apiKey);
+    request.cancellation = options.cancellation;
+    request.deadline = options.deadline;
+
+    // An identical request already in flight delivers its reply to us too.
+    // Cancellation and deadline then apply to our place in the flight, not
+    // to the shared upstream call.
+    if (options.coalesce) {
+        RequestCoalescer& coalescer = RequestCoalescer::getInstance();
+        auto flight = coalescer.join(FlightKey{ key, apiKey, false }, nullptr, std::move(onComplete),
+            options.cancellation, options.deadline);
+        if (!flight) {
+            return;
+        }
+        onComplete = [flight](const std::string& reply) {
+            RequestCoalescer::getInstance().finish(flight, reply);
+            };
+        request.cancellation = coalescer.upstreamCancellation(flight);
+        request.deadline = std::chrono::steady_clock::time_point::max();
+    }
+
+    createChatRequestBody(request.body, messages, model, temperature, maxTokens, false);
+
+    // Parsing the reply and writing it to the cache would hold up every
+    // other transfer on the engine thread
+    auto started = std::chrono::steady_clock::now();
+    RateLimiter::getInstance().submit(std::move(request), [onComplete, useCache, key, started](HttpResponse response) {
+        auto shared = std::make_shared<HttpResponse>(std::move(response));
+        Executor::getInstance().submit([shared, onComplete, useCache, key, started]() {
+            bool ok;
+            std::string reply = parseCompletionResponse(*shared, ok);
+            if (ok) {
+                chatMetrics().latency.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+            }
+            if (ok && useCache) {
+                ResponseCache::getInstance().store(key, reply);
+            }
+            onComplete(reply);
+            }, TaskPriority::TP_HIGH);
+        });
+}
+
+void streamingChatCompletionAsync(
+    const std::string& apiKey,
+    const ConversationHistory& messages,
     std::function<void(const std::string&)> callback,
+    std::function<void(const std::string&)> onComplete,
     const std::string& model,
     float temperature,
-    int maxTokens
+    int maxTokens,
+    const CompletionOptions& options
 ) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        return "Error: Failed to initialize CURL";
+    // A cached reply is replayed as a single chunk
+    ResponseCache& cache = ResponseCache::getInstance();
+    bool useCache = !options.bypassCache && cache.isEnabled();
+    CacheKey key;
+    if (useCache || options.coalesce) {
+        key = ResponseCache::makeKey(messages, model, temperature, maxTokens);
+    }
+    if (useCache) {
+        std::string cached;
+        if (cache.lookup(key, cached)) {
+            callback(cached);
+            onComplete(cached);
+            return;
+        }
     }
 
-    std::string requestBody = createChatRequestBody(messages, model, temperature, maxTokens, true);
-    std::string fullResponse;
+    // Joining an identical stream replays what it has produced so far, then
+    // fans its remaining chunks out to us
+    HttpRequest request = createChatRequest(apiKey);
+    request.cancellation = options.cancellation;
+    request.deadline = options.deadline;
+
+    if (options.coalesce) {
+        RequestCoalescer& coalescer = RequestCoalescer::getInstance();
+        auto flight = coalescer.join(FlightKey{ key, apiKey, true }, std::move(callback), std::move(onComplete),
+            options.cancellation, options.deadline);
+        if (!flight) {
+            return;
+        }
+        callback = [flight](const std::string& chunk) {
+            RequestCoalescer::getInstance().publish(flight, chunk);
+            };
+        onComplete = [flight](const std::string& reply) {
+            RequestCoalescer::getInstance().finish(flight, reply);
+            };
+        request.cancellation = coalescer.upstreamCancellation(flight);
+        request.deadline = std::chrono::steady_clock::time_point::max();
+    }
 
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string authHeader = "Authorization: Bearer " + apiKey;
-    headers = curl_slist_append(headers, authHeader.c_str());
+    createChatRequestBody(request.body, messages, model, temperature, maxTokens, true);
 
-    // Create a wrapper function that both updates the full response and calls the user callback
-    auto wrappedCallback = [&fullResponse, callback](const std::string& chunk) {
-        fullResponse += chunk;
-        callback(chunk);
+    // Updates the full response and calls the user callback for every event
+    auto fullResponse = std::make_shared<std::string>();
+    auto delta = std::make_shared<StreamDelta>();
+    auto timing = std::make_shared<StreamTiming>();
+    auto parser = std::make_shared<SseParser>([fullResponse, delta, timing, callback](std::string_view data) {
+        if (!DeltaExtractor::extract(data, *delta)) {
+            return;
+        }
+        if (delta->hasUsage) {
+            timing->completionTokens = delta->completionTokens;
+        }
+        if (delta->hasContent) {
+            if (timing->deltas++ == 0) {
+                timing->firstToken = std::chrono::steady_clock::now();
+                chatMetrics().firstToken.observe(std::chrono::duration<double>(timing->firstToken - timing->started).count());
+            }
+            *fullResponse += delta->content;
+            callback(delta->content);
+        }
+        });
+
+    request.onData = [parser](const char* data, size_t size) {
+        TraceSpan span("SseParser::feed", "chat");
+        parser->feed(data, size);
+        return true;
         };
 
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.deepseek.com/v1/chat/completions");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, requestBody.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamingWriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &wrappedCallback);
+    RateLimiter::getInstance().submit(std::move(request), [parser, fullResponse, timing, onComplete, useCache, key](HttpResponse response) {
+        parser->finish();
+        if (response.result != CURLE_OK) {
+            // Stopped on purpose: the text so far is the reply
+            if (response.cancelled) {
+                onComplete(*fullResponse);
+            }
+            else {
+                onComplete("CURL error: " + response.error);
+            }
+            return;
+        }
+        // An error status carries a JSON error body instead of a stream
+        if (response.statusCode >= 400) {
+            bool ok;
+            onComplete(parseCompletionResponse(response, ok));
+            return;
+        }
+        // Without a usage chunk, each delta is about one token
+        if (response.statusCode == 200 && timing->deltas > 0) {
+            ChatMetrics& metrics = chatMetrics();
+            auto now = std::chrono::steady_clock::now();
+            metrics.streamLatency.observe(std::chrono::duration<double>(now - timing->started).count());
+            double streaming = std::chrono::duration<double>(now - timing->firstToken).count();
+            long long tokens = timing->completionTokens > 0 ? timing->completionTokens : timing->deltas;
+            if (streaming > 0 && tokens > 1) {
+                metrics.tokensPerSecond.observe((tokens - 1) / streaming);
+            }
+        }
+        // Only a stream that ran to [DONE] is a complete reply
+        if (useCache && response.statusCode == 200 && parser->isDone() && !fullResponse->empty()) {
+            Executor::getInstance().submit([key, fullResponse]() {
+                ResponseCache::getInstance().store(key, *fullResponse);
+                }, TaskPriority::TP_LOW);
+        }
+        onComplete(*fullResponse);
+        });
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+// ʵ chatCompletion 
+std::string chatCompletion(
+    const std::string& apiKey,
+    const ConversationHistory& messages,
+    const std::string& model,
+    float temperature,
+    int maxTokens,
+    const CompletionOptions& options
+) {
+    std::promise<std::string> result;
+    std::future<std::string> reply = result.get_future();
 
-    if (res != CURLE_OK) {
-        return std::string("CURL error: ") + curl_easy_strerror(res);
-    }
+    chatCompletionAsync(apiKey, messages, [&result](const std::string& response) {
+        result.set_value(response);
+        }, model, temperature, maxTokens, options);
+
+    return reply.get();
+}
+
+// ʵ streamingChatCompletion 
+std::string streamingChatCompletion(
+    const std::string& apiKey,
+    const ConversationHistory& messages,
+    std::function<void(const std::string&)> callback,
+    const std::string& model,
+    float temperature,
+    int maxTokens,
+    const CompletionOptions& options
+) {
+    std::promise<std::string> result;
+    std::future<std::string> reply = result.get_future();
+
+    streamingChatCompletionAsync(apiKey, messages, callback, [&result](const std::string& response) {
+        result.set_value(response);
+        }, model, temperature, maxTokens, options);
 
-    return fullResponse;
+    return reply.get();
 }
@@ -0,0 +1,410 @@
+#include "include/utils/DeltaExtractor.h"
+#include <nlohmann/json.hpp>
+#include <charconv>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Forward-only JSON scanner over a single payload. Values the chat API
+// fields do not need are skipped without being validated.
+class Scanner {
+public:
+    explicit Scanner(std::string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool atEnd() {
+        skipWhitespace();
+        return p == end;
+    }
+
+    // Keys are read in place; only a key containing escapes is copied
+    bool readKey(std::string_view& key, std::string& scratch) {
+        if (!consume('"')) {
+            return false;
+        }
+
+        const char* start = p;
+        while (p < end && *p != '"' && *p != '\\') {
+            p++;
+        }
+        if (p < end && *p == '"') {
+            key = std::string_view(start, p - start);
+            p++;
+            return true;
+        }
+
+        p = start;
+        scratch.clear();
+        if (!readStringBody(scratch)) {
+            return false;
+        }
+        key = scratch;
+        return true;
+    }
+
+    bool readString(std::string& out) {
+        out.clear();
+        return consume('"') && readStringBody(out);
+    }
+
+    bool readNull() {
+        skipWhitespace();
+        if (end - p >= 4 && p[0] == 'n' && p[1] == 'u' && p[2] == 'l' && p[3] == 'l') {
+            p += 4;
+            return true;
+        }
+        return false;
+    }
+
+    bool readInteger(long long& value) {
+        skipWhitespace();
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc() || result.ptr == p) {
+            return false;
+        }
+        p = result.ptr;
+        // Fractions and exponents mean the field is not the integer we expect
+        return p == end || (*p != '.' && *p != 'e' && *p != 'E');
+    }
+
+    bool skipValue() {
+        skipWhitespace();
+        if (p >= end) {
+            return false;
+        }
+
+        char c = *p;
+        if (c == '"') {
+            p++;
+            return skipStringBody();
+        }
+        if (c == '{' || c == '[') {
+            return skipContainer();
+        }
+
+        // Number or literal: runs until the next delimiter
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+            *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        return p > start;
+    }
+
+private:
+    bool readStringBody(std::string& out) {
+        for (;;) {
+            // Copy the run up to the next quote, escape or control character at once
+            const char* start = p;
+            while (p < end) {
+                unsigned char c = static_cast<unsigned char>(*p);
+                if (c == '"' || c == '\\' || c < 0x20) {
+                    break;
+                }
+                p++;
+            }
+            out.append(start, p - start);
+
+            if (p >= end) {
+                return false;
+            }
+
+            char c = *p++;
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\' || p >= end) {
+                return false;
+            }
+
+            switch (*p++) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                unsigned int codePoint;
+                if (!readHex4(codePoint)) {
+                    return false;
+                }
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+                    // A high surrogate must be followed by an escaped low surrogate
+                    unsigned int low;
+                    if (end - p < 6 || p[0] != '\\' || p[1] != 'u') {
+                        return false;
+                    }
+                    p += 2;
+                    if (!readHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+                    return false;
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+
+    bool readHex4(unsigned int& value) {
+        if (end - p < 4) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p++;
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned int codePoint) {
+        if (codePoint < 0x80) {
+            out.push_back(static_cast<char>(codePoint));
+        }
+        else if (codePoint < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else if (codePoint < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else {
+            out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    bool skipStringBody() {
+        while (p < end) {
+            if (*p == '\\') {
+                if (end - p < 2) {
+                    return false;
+                }
+                p += 2;
+            }
+            else if (*p++ == '"') {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool skipContainer() {
+        int depth = 0;
+        while (p < end) {
+            char c = *p++;
+            if (c == '"') {
+                if (!skipStringBody()) {
+                    return false;
+                }
+            }
+            else if (c == '{' || c == '[') {
+                depth++;
+            }
+            else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    const char* p;
+    const char* end;
+};
+
+// Reads one object, calling onField(key) positioned at each value
+template <typename FieldHandler>
+bool scanObject(Scanner& scanner, std::string& scratch, FieldHandler onField) {
+    if (!scanner.consume('{')) {
+        return false;
+    }
+    if (scanner.consume('}')) {
+        return true;
+    }
+
+    do {
+        std::string_view key;
+        if (!scanner.readKey(key, scratch) || !scanner.consume(':')) {
+            return false;
+        }
+        if (!onField(key)) {
+            return false;
+        }
+    } while (scanner.consume(','));
+
+    return scanner.consume('}');
+}
+
+bool scanDelta(Scanner& scanner, std::string& scratch, StreamDelta& delta) {
+    return scanObject(scanner, scratch, [&](std::string_view key) {
+        if (key == "content") {
+            if (scanner.readNull()) {
+                delta.hasContent = false;
+                return true;
+            }
+            delta.hasContent = scanner.readString(delta.content);
+            return delta.hasContent;
+        }
+        return scanner.skipValue();
+        });
+}
+
+bool scanChoice(Scanner& scanner, std::string& scratch, StreamDelta& delta) {
+    return scanObject(scanner, scratch, [&](std::string_view key) {
+        if (key == "delta") {
+            return scanDelta(scanner, scratch, delta);
+        }
+        if (key == "finish_reason") {
+            if (scanner.readNull()) {
+                delta.hasFinishReason = false;
+                return true;
+            }
+            delta.hasFinishReason = scanner.readString(delta.finishReason);
+            return delta.hasFinishReason;
+        }
+        return scanner.skipValue();
+        });
+}
+
+bool scanChoices(Scanner& scanner, std::string& scratch, StreamDelta& delta) {
+    if (!scanner.consume('[')) {
+        return false;
+    }
+    if (scanner.consume(']')) {
+        return true;
+    }
+
+    // Only the first choice is used, like the DOM path
+    bool first = true;
+    do {
+        bool ok = first ? scanChoice(scanner, scratch, delta) : scanner.skipValue();
+        if (!ok) {
+            return false;
+        }
+        first = false;
+    } while (scanner.consume(','));
+
+    return scanner.consume(']');
+}
+
+bool scanUsage(Scanner& scanner, std::string& scratch, StreamDelta& delta) {
+    if (scanner.readNull()) {
+        return true;
+    }
+
+    delta.hasUsage = true;
+    return scanObject(scanner, scratch, [&](std::string_view key) {
+        if (key == "prompt_tokens") {
+            return scanner.readInteger(delta.promptTokens);
+        }
+        if (key == "completion_tokens") {
+            return scanner.readInteger(delta.completionTokens);
+        }
+        if (key == "total_tokens") {
+            return scanner.readInteger(delta.totalTokens);
+        }
+        return scanner.skipValue();
+        });
+}
+
+} // namespace
+
+bool DeltaExtractor::extract(std::string_view payload, StreamDelta& delta) {
+    if (scan(payload, delta)) {
+        return true;
+    }
+    return extractWithDom(payload, delta);
+}
+
+bool DeltaExtractor::scan(std::string_view payload, StreamDelta& delta) {
+    delta.clear();
+
+    Scanner scanner(payload);
+    std::string scratch;
+    bool ok = scanObject(scanner, scratch, [&](std::string_view key) {
+        if (key == "choices") {
+            return scanChoices(scanner, scratch, delta);
+        }
+        if (key == "usage") {
+            return scanUsage(scanner, scratch, delta);
+        }
+        return scanner.skipValue();
+        });
+
+    return ok && scanner.atEnd();
+}
+
+bool DeltaExtractor::extractWithDom(std::string_view payload, StreamDelta& delta) {
+    delta.clear();
+
+    json responseJson = json::parse(payload.begin(), payload.end(), nullptr, false);
+    if (!responseJson.is_object()) {
+        return false;
+    }
+
+    if (responseJson.contains("choices") && responseJson["choices"].is_array() &&
+        responseJson["choices"].size() > 0 &&
+        responseJson["choices"][0].is_object()) {
+
+        const json& choice = responseJson["choices"][0];
+        if (choice.contains("delta") && choice["delta"].is_object() &&
+            choice["delta"].contains("content") && choice["delta"]["content"].is_string()) {
+            delta.hasContent = true;
+            delta.content = choice["delta"]["content"].get<std::string>();
+        }
+        if (choice.contains("finish_reason") && choice["finish_reason"].is_string()) {
+            delta.hasFinishReason = true;
+            delta.finishReason = choice["finish_reason"].get<std::string>();
+        }
+    }
+
+    if (responseJson.contains("usage") && responseJson["usage"].is_object()) {
+        const json& usage = responseJson["usage"];
+        try {
+            delta.promptTokens = usage.value("prompt_tokens", 0LL);
+            delta.completionTokens = usage.value("completion_tokens", 0LL);
+            delta.totalTokens = usage.value("total_tokens", 0LL);
+            delta.hasUsage = true;
+        }
+        catch (const json::type_error&) {
+            // Counts that are not numbers are left out
+        }
+    }
+
+    return true;
+}
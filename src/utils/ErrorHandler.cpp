@@ -1,16 +1,29 @@
 #include "include/utils/ErrorHandler.h"
-#include <iostream>
+#include "include/utils/AsyncLogger.h"
+#include "include/config/ConfigManager.h"
+#include <algorithm>
 #include <chrono>
-#include <iomanip>
-#include <sstream>
+#include <ctime>
+
+namespace {
+    const long long DEFAULT_HISTORY_CAPACITY = 256;
+}
 
 /**
  * @brief Constructor for ErrorHandler
  *
- * Initializes the ErrorHandler with empty error records.
+ * Initializes the ErrorHandler with an empty ring of error_history_capacity records.
  */
-ErrorHandler::ErrorHandler() {
-    // Initialize with empty error records
+ErrorHandler::ErrorHandler() : nextSequence(0), clearedBefore(0) {
+    // Constructed first, so the logger outlives the handler
+    AsyncLogger::getInstance();
+
+    historyCapacity = static_cast<size_t>(std::max(1LL,
+        ConfigManager::getInstance().getIntSetting("error_history_capacity", DEFAULT_HISTORY_CAPACITY)));
+    history.reset(new std::shared_ptr<const HistoryEntry>[historyCapacity]);
+    for (auto& count : levelCounts) {
+        count.store(0);
+    }
 }
 
 /**
@@ -31,30 +44,30 @@ ErrorHandler& ErrorHandler::getInstance() {
  * @param context Additional context information
  */
 void ErrorHandler::logError(ErrorLevel level, const std::string& message, const std::string& context) {
-    std::lock_guard<std::mutex> lock(errorMutex);
-
-    ErrorRecord record;
-    record.level = level;
-    record.message = message;
-    record.context = context;
-    record.timestamp = getCurrentTimestamp();
-
-    errorRecords.push_back(record);
-
-    // Output to console based on level
-    switch (level) {
-    case ErrorLevel::EL_INFO:
-        std::cout << "[INFO] " << message << std::endl;
-        break;
-    case ErrorLevel::EL_WARNING:
-        std::cout << "[WARNING] " << message << std::endl;
-        break;
-    case ErrorLevel::EL_ERROR:
-        std::cerr << "[ERROR] " << message << std::endl;
-        break;
-    case ErrorLevel::EL_FATAL:
-        std::cerr << "[FATAL] " << message << std::endl;
-        break;
+    auto entry = std::make_shared<HistoryEntry>();
+    entry->record.level = level;
+    entry->record.message = message;
+    entry->record.context = context;
+    entry->record.timestamp = getCurrentTimestamp();
+    entry->sequence = nextSequence.fetch_add(1);
+    levelCounts[static_cast<size_t>(level)].fetch_add(1, std::memory_order_relaxed);
+
+    // A logger a full lap ahead may already have taken the slot; the newer record stays
+    std::shared_ptr<const HistoryEntry>& slot = history[entry->sequence % historyCapacity];
+    std::shared_ptr<const HistoryEntry> desired = entry;
+    std::shared_ptr<const HistoryEntry> current = std::atomic_load(&slot);
+    while (!current || current->sequence < entry->sequence) {
+        if (std::atomic_compare_exchange_weak(&slot, &current, desired)) {
+            break;
+        }
+    }
+
+    // Console output is written by the logger thread; a fatal error is
+    // likely the last thing logged, so it is not left in the queue
+    AsyncLogger& logger = AsyncLogger::getInstance();
+    logger.log(level, message, context, entry->record.timestamp);
+    if (level == ErrorLevel::EL_FATAL) {
+        logger.flush();
     }
 }
 
@@ -101,34 +114,92 @@ void ErrorHandler::logFatal(const std::string& message, const std::string& conte
 /**
  * @brief Get the most recent error
  *
- * @return The most recent error record, or nullptr if no errors
+ * @return Copy of the most recent error record, or nothing if no errors
  */
-const ErrorRecord* ErrorHandler::getLastError() const {
-    std::lock_guard<std::mutex> lock(errorMutex);
+std::optional<ErrorRecord> ErrorHandler::getLastError() const {
+    // A slot claimed but not filled yet is skipped for the one before it
+    uint64_t end = nextSequence.load();
+    uint64_t begin = std::max(clearedBefore.load(), end > historyCapacity ? end - historyCapacity : 0);
+    for (uint64_t sequence = end; sequence-- > begin;) {
+        std::shared_ptr<const HistoryEntry> entry = std::atomic_load(&history[sequence % historyCapacity]);
+        if (entry && entry->sequence == sequence) {
+            return entry->record;
+        }
+    }
+    return std::nullopt;
+}
 
-    if (errorRecords.empty()) {
-        return nullptr;
+/**
+ * @brief Get the retained error records
+ *
+ * @return Copies of at most error_history_capacity records, oldest first
+ */
+std::vector<ErrorRecord> ErrorHandler::getAllErrors() const {
+    std::vector<ErrorRecord> records;
+    std::vector<std::shared_ptr<const HistoryEntry>> entries = snapshot();
+    records.reserve(entries.size());
+    for (const auto& entry : entries) {
+        records.push_back(entry->record);
     }
+    return records;
+}
 
-    return &errorRecords.back();
+/**
+ * @brief Visit the retained error records
+ *
+ * The records are those retained when the call starts; logging from the
+ * visitor is allowed.
+ * @param visit Called with each record, oldest first
+ */
+void ErrorHandler::forEachError(const std::function<void(const ErrorRecord&)>& visit) const {
+    for (const auto& entry : snapshot()) {
+        visit(entry->record);
+    }
 }
 
 /**
- * @brief Get all logged errors
+ * @brief Get how many records were logged at a level
  *
- * @return Vector of all error records
+ * @param level Error severity level
+ * @return Count since start
  */
-std::vector<ErrorRecord> ErrorHandler::getAllErrors() const {
-    std::lock_guard<std::mutex> lock(errorMutex);
-    return errorRecords;
+uint64_t ErrorHandler::getErrorCount(ErrorLevel level) const {
+    return levelCounts[static_cast<size_t>(level)].load(std::memory_order_relaxed);
 }
 
 /**
- * @brief Clear all logged errors
+ * @brief Clear all retained error records
  */
 void ErrorHandler::clearErrors() {
-    std::lock_guard<std::mutex> lock(errorMutex);
-    errorRecords.clear();
+    uint64_t cleared = nextSequence.load();
+    clearedBefore.store(cleared);
+
+    // Release the records now rather than when their slots are reused
+    std::shared_ptr<const HistoryEntry> empty;
+    for (size_t i = 0; i < historyCapacity; i++) {
+        std::shared_ptr<const HistoryEntry> current = std::atomic_load(&history[i]);
+        while (current && current->sequence < cleared) {
+            if (std::atomic_compare_exchange_weak(&history[i], &current, empty)) {
+                break;
+            }
+        }
+    }
+}
+
+std::vector<std::shared_ptr<const ErrorHandler::HistoryEntry>> ErrorHandler::snapshot() const {
+    std::vector<std::shared_ptr<const HistoryEntry>> entries;
+    entries.reserve(historyCapacity);
+    uint64_t cleared = clearedBefore.load();
+    for (size_t i = 0; i < historyCapacity; i++) {
+        std::shared_ptr<const HistoryEntry> entry = std::atomic_load(&history[i]);
+        if (entry && entry->sequence >= cleared) {
+            entries.push_back(std::move(entry));
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        return a->sequence < b->sequence;
+    });
+    return entries;
 }
 
 /**
@@ -148,7 +219,7 @@ std::string ErrorHandler::getCurrentTimestamp() const {
     localtime_r(&time, &timeinfo);
 #endif
 
-    std::stringstream ss;
-    ss << std::put_time(&timeinfo, "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+    char buffer[32];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return std::string(buffer, length);
 }
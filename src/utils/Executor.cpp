@@ -0,0 +1,201 @@
+#include "include/utils/Executor.h"
+#include "include/config/ConfigManager.h"
+#include "include/utils/ErrorHandler.h"
+#include "include/utils/Tracer.h"
+#include <algorithm>
+#include <exception>
+#include <string>
+
+namespace {
+    const size_t MIN_WORKERS = 2;
+
+    // Worker the current thread runs, if any
+    thread_local const Executor* currentExecutor = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+Executor& Executor::getInstance() {
+    static Executor instance;
+    return instance;
+}
+
+Executor::Executor()
+    : sleeping(0),
+      pending(0),
+      stopping(false),
+      stopped(false),
+      nextWorker(0),
+      active(0),
+      executed(0),
+      stolen(0) {
+    long long configured = ConfigManager::getInstance().getIntSetting("executor_threads", 0);
+    size_t count = configured > 0
+        ? static_cast<size_t>(configured)
+        : std::max<size_t>(MIN_WORKERS, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < count; i++) {
+        workers[i]->thread = std::thread(&Executor::workerLoop, this, i);
+    }
+}
+
+Executor::~Executor() {
+    shutdown();
+}
+
+void Executor::submit(Task task, TaskPriority priority) {
+    if (stopped.load()) {
+        runTask(task);
+        return;
+    }
+
+    size_t index = currentExecutor == this ? currentWorker : nextWorker.fetch_add(1) % workers.size();
+    size_t level = static_cast<size_t>(priority);
+    Worker& worker = *workers[index];
+    // Counted before it is queued, so pending never drops below the tasks
+    // a worker can find
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queues[level].push_back(std::move(task));
+        worker.depths[level].fetch_add(1);
+    }
+
+    if (sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+
+    // Lost the race with shutdown(): nobody else will run it
+    if (stopped.load()) {
+        runLeftovers();
+    }
+}
+
+bool Executor::isWorkerThread() const {
+    return currentExecutor == this;
+}
+
+size_t Executor::getWorkerCount() const {
+    return workers.size();
+}
+
+ExecutorStats Executor::getStats() const {
+    ExecutorStats stats;
+    stats.workers = workers.size();
+    stats.queued = 0;
+    stats.maxQueueDepth = 0;
+    for (const auto& worker : workers) {
+        size_t depth = 0;
+        for (const auto& levelDepth : worker->depths) {
+            depth += levelDepth.load();
+        }
+        stats.queued += depth;
+        stats.maxQueueDepth = std::max(stats.maxQueueDepth, depth);
+    }
+    stats.active = active.load();
+    stats.executed = executed.load();
+    stats.stolen = stolen.load();
+    return stats;
+}
+
+void Executor::shutdown() {
+    std::lock_guard<std::mutex> shutdownLock(shutdownMutex);
+    if (stopped.load()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    stopped = true;
+    runLeftovers();
+}
+
+void Executor::workerLoop(size_t index) {
+    Tracer::setThreadName("Executor");
+    currentExecutor = this;
+    currentWorker = index;
+
+    Task task;
+    for (;;) {
+        if (takeTask(index, task)) {
+            runTask(task);
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1);
+        wake.wait(lock, [this]() { return pending.load() > 0 || stopping; });
+        sleeping.fetch_sub(1);
+        if (stopping && pending.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool Executor::takeTask(size_t index, Task& task) {
+    size_t count = workers.size();
+    for (size_t level = 0; level < PRIORITY_COUNT; level++) {
+        // Own tasks in submission order, then the newest of another worker
+        for (size_t offset = 0; offset < count; offset++) {
+            Worker& worker = *workers[(index + offset) % count];
+            if (worker.depths[level].load() == 0) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            std::deque<Task>& queue = worker.queues[level];
+            if (queue.empty()) {
+                continue;
+            }
+            if (offset == 0) {
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            else {
+                task = std::move(queue.back());
+                queue.pop_back();
+                stolen.fetch_add(1);
+            }
+            worker.depths[level].fetch_sub(1);
+            pending.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::runTask(Task& task) {
+    active.fetch_add(1);
+    try {
+        task();
+    }
+    catch (const std::exception& e) {
+        ErrorHandler::getInstance().logError(std::string("Task failed: ") + e.what(), "Executor");
+    }
+    catch (...) {
+        ErrorHandler::getInstance().logError("Task failed with an unknown exception", "Executor");
+    }
+    active.fetch_sub(1);
+    executed.fetch_add(1);
+}
+
+void Executor::runLeftovers() {
+    Task task;
+    while (takeTask(0, task)) {
+        runTask(task);
+        task = nullptr;
+    }
+}
@@ -0,0 +1,111 @@
+#include "include/utils/JsonWriter.h"
+#include <nlohmann/json.hpp>
+#include <charconv>
+#include <cstring>
+
+namespace {
+    const char HEX_DIGITS[] = "0123456789abcdef";
+
+    // Length of the valid UTF-8 sequence starting at p, or 0 if it is invalid.
+    // Accepts exactly what nlohmann's decoder accepts (no overlongs, no
+    // surrogates, nothing above U+10FFFF).
+    size_t validUtf8Length(const unsigned char* p, const unsigned char* end) {
+        unsigned char lead = p[0];
+        size_t length;
+        if (lead >= 0xC2 && lead <= 0xDF) length = 2;
+        else if (lead >= 0xE0 && lead <= 0xEF) length = 3;
+        else if (lead >= 0xF0 && lead <= 0xF4) length = 4;
+        else return 0;
+
+        if (static_cast<size_t>(end - p) < length) {
+            return 0;
+        }
+
+        unsigned char second = p[1];
+        if (lead == 0xE0 && second < 0xA0) return 0;
+        if (lead == 0xED && second > 0x9F) return 0;
+        if (lead == 0xF0 && second < 0x90) return 0;
+        if (lead == 0xF4 && second > 0x8F) return 0;
+
+        for (size_t i = 1; i < length; i++) {
+            if ((p[i] & 0xC0) != 0x80) {
+                return 0;
+            }
+        }
+        return length;
+    }
+}
+
+void JsonWriter::appendString(std::string& out, std::string_view value) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(value.data());
+    const unsigned char* end = p + value.size();
+    const unsigned char* run = p;
+
+    out.push_back('"');
+    while (p < end) {
+        unsigned char c = *p;
+
+        // Printable ASCII is copied in runs
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+            p++;
+            continue;
+        }
+
+        if (c >= 0x80) {
+            size_t length = validUtf8Length(p, end);
+            if (length == 0) {
+                // Let nlohmann raise the same type_error dump() would
+                nlohmann::json(std::string(value)).dump();
+            }
+            p += length;
+            continue;
+        }
+
+        out.append(reinterpret_cast<const char*>(run), p - run);
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default: {
+            char escaped[6] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F] };
+            out.append(escaped, sizeof(escaped));
+            break;
+        }
+        }
+        p++;
+        run = p;
+    }
+
+    out.append(reinterpret_cast<const char*>(run), p - run);
+    out.push_back('"');
+}
+
+void JsonWriter::appendInt(std::string& out, long long value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr - buffer);
+}
+
+void JsonWriter::appendBool(std::string& out, bool value) {
+    out.append(value ? "true" : "false");
+}
+
+void JsonWriter::appendFloat(std::string& out, float value) {
+    // Float formatting is delegated to nlohmann so the digits match dump()
+    // exactly. The same temperature is sent on every turn, so the text is
+    // cached per thread.
+    thread_local bool hasCached = false;
+    thread_local float cachedValue = 0.0f;
+    thread_local std::string cachedText;
+
+    if (!hasCached || std::memcmp(&cachedValue, &value, sizeof(value)) != 0) {
+        cachedText = nlohmann::json(value).dump();
+        cachedValue = value;
+        hasCached = true;
+    }
+    out.append(cachedText);
+}
@@ -0,0 +1,220 @@
+#include "include/utils/Metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+    // Threads take shards in turn; more threads than shards share
+    std::atomic<size_t> nextShard(0);
+
+    size_t threadShard() {
+        thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed);
+        return shard;
+    }
+
+    std::string formatNumber(double value) {
+        if (std::isinf(value)) {
+            return value > 0 ? "+Inf" : "-Inf";
+        }
+        char buffer[32];
+        if (value == std::floor(value) && std::fabs(value) < 1e15) {
+            std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+        }
+        else {
+            std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+        }
+        return buffer;
+    }
+}
+
+void MetricCounter::add(uint64_t amount) {
+    shards[threadShard() % SHARDS].value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t MetricCounter::value() const {
+    uint64_t total = 0;
+    for (const Shard& shard : shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+MetricHistogram::MetricHistogram(double unit, std::vector<double> bounds)
+    : unit(unit), bounds(std::move(bounds)), shards(new Shard[MetricCounter::SHARDS]) {
+}
+
+size_t MetricHistogram::bucketOf(uint64_t units) {
+    if (units < SUB_BUCKETS) {
+        return static_cast<size_t>(units);
+    }
+    size_t magnitude = 0;
+    for (uint64_t rest = units; rest > 1; rest >>= 1) {
+        magnitude++;
+    }
+    if (magnitude > MAX_MAGNITUDE) {
+        return BUCKETS - 1;
+    }
+    size_t shift = magnitude - SUB_BUCKET_BITS;
+    size_t sub = static_cast<size_t>(units >> shift) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + shift * SUB_BUCKETS + sub;
+}
+
+uint64_t MetricHistogram::bucketEnd(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket + 1;
+    }
+    size_t shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    size_t sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    return static_cast<uint64_t>(SUB_BUCKETS + sub + 1) << shift;
+}
+
+void MetricHistogram::observe(double value) {
+    double scaled = value / unit;
+    uint64_t units = scaled > 0 ? static_cast<uint64_t>(std::llround(std::min(scaled, 9.0e18))) : 0;
+    Shard& shard = shards[threadShard() % MetricCounter::SHARDS];
+    shard.counts[bucketOf(units)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(units, std::memory_order_relaxed);
+}
+
+void MetricHistogram::render(std::string& out, const std::string& name, const std::string& labels) const {
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t sum = 0;
+    for (size_t s = 0; s < MetricCounter::SHARDS; s++) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts[i] += shards[s].counts[i].load(std::memory_order_relaxed);
+        }
+        sum += shards[s].sum.load(std::memory_order_relaxed);
+    }
+
+    // A bucket counts towards a bound once all of it lies below the bound
+    std::string prefix = name + "_bucket{" + labels + (labels.empty() ? "" : ",") + "le=\"";
+    uint64_t cumulative = 0;
+    size_t next = 0;
+    for (double bound : bounds) {
+        double limit = bound / unit;
+        while (next < BUCKETS && static_cast<double>(bucketEnd(next) - 1) <= limit) {
+            cumulative += counts[next++];
+        }
+        out += prefix + formatNumber(bound) + "\"} " + formatNumber(static_cast<double>(cumulative)) + "\n";
+    }
+    while (next < BUCKETS) {
+        cumulative += counts[next++];
+    }
+    out += prefix + "+Inf\"} " + formatNumber(static_cast<double>(cumulative)) + "\n";
+
+    std::string braces = labels.empty() ? std::string() : "{" + labels + "}";
+    out += name + "_sum" + braces + " " + formatNumber(static_cast<double>(sum) * unit) + "\n";
+    out += name + "_count" + braces + " " + formatNumber(static_cast<double>(cumulative)) + "\n";
+}
+
+Metrics& Metrics::getInstance() {
+    static Metrics instance;
+    return instance;
+}
+
+Metrics::Family& Metrics::family(const std::string& name, const std::string& help, bool isHistogram) {
+    for (Family& existing : families) {
+        if (existing.name == name) {
+            return existing;
+        }
+    }
+    families.push_back(Family{ name, help, isHistogram, {}, {} });
+    return families.back();
+}
+
+MetricCounter& Metrics::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Family& entry = family(name, help, false);
+    for (auto& counter : entry.counters) {
+        if (counter.first == labels) {
+            return *counter.second;
+        }
+    }
+    entry.counters.emplace_back(labels, std::make_unique<MetricCounter>());
+    return *entry.counters.back().second;
+}
+
+MetricHistogram& Metrics::histogram(const std::string& name, const std::string& help, double unit,
+    const std::vector<double>& bounds, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Family& entry = family(name, help, true);
+    for (auto& histogram : entry.histograms) {
+        if (histogram.first == labels) {
+            return *histogram.second;
+        }
+    }
+    entry.histograms.emplace_back(labels, std::make_unique<MetricHistogram>(unit, bounds));
+    return *entry.histograms.back().second;
+}
+
+void Metrics::addCollector(Collector collector) {
+    std::lock_guard<std::mutex> lock(mutex);
+    collectors.push_back(std::move(collector));
+}
+
+std::string Metrics::renderText() const {
+    std::string out;
+    std::vector<Collector> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Family& entry : families) {
+            appendHeader(out, entry.name, entry.help, entry.isHistogram ? "histogram" : "counter");
+            for (const auto& counter : entry.counters) {
+                appendSample(out, entry.name, counter.first, static_cast<double>(counter.second->value()));
+            }
+            for (const auto& histogram : entry.histograms) {
+                histogram.second->render(out, entry.name, histogram.first);
+            }
+        }
+        pending = collectors;
+    }
+
+    // Collectors read other components' stats, which take their own locks
+    for (const Collector& collector : pending) {
+        collector(out);
+    }
+    return out;
+}
+
+const std::vector<double>& Metrics::latencyBounds() {
+    static const std::vector<double> bounds = {
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60
+    };
+    return bounds;
+}
+
+void Metrics::appendHeader(std::string& out, const std::string& name, const std::string& help, const char* type) {
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+void Metrics::appendGauge(std::string& out, const std::string& name, const std::string& help, double value) {
+    appendHeader(out, name, help, "gauge");
+    appendSample(out, name, "", value);
+}
+
+void Metrics::appendCounter(std::string& out, const std::string& name, const std::string& help, double value) {
+    appendHeader(out, name, help, "counter");
+    appendSample(out, name, "", value);
+}
+
+void Metrics::appendSample(std::string& out, const std::string& name, const std::string& labels, double value) {
+    out += name;
+    if (!labels.empty()) {
+        out += "{" + labels + "}";
+    }
+    out += " " + formatNumber(value) + "\n";
+}
+
+void Metrics::appendBuckets(std::string& out, const std::string& name, const std::string& labels,
+    const std::vector<double>& bounds, const std::vector<size_t>& counts, double sum) {
+    std::string prefix = labels.empty() ? std::string() : labels + ",";
+    size_t cumulative = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        cumulative += counts[i];
+        std::string bound = i < bounds.size() ? formatNumber(bounds[i]) : "+Inf";
+        appendSample(out, name + "_bucket", prefix + "le=\"" + bound + "\"", static_cast<double>(cumulative));
+    }
+    appendSample(out, name + "_sum", labels, sum);
+    appendSample(out, name + "_count", labels, static_cast<double>(cumulative));
+}
@@ -0,0 +1,460 @@
+#include "include/utils/RateLimiter.h"
+#include "include/utils/RequestHedger.h"
+#include "include/config/ConfigManager.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+    const long long DEFAULT_INITIAL_CONCURRENCY = 8;
+    const long long DEFAULT_MAX_CONCURRENCY = 64;
+    const long long DEFAULT_MAX_RETRIES = 4;
+    const long long DEFAULT_RETRY_BASE_MS = 500;
+    const long long DEFAULT_RETRY_MAX_MS = 30000;
+
+    // Gentler than halving, which keeps the swing after a throttle small
+    const double DECREASE_FACTOR = 0.7;
+
+    // Growth is slowed this much within 10% of the last throttled limit
+    const double PROBE_SLOWDOWN = 4.0;
+
+    const double MIN_COOLDOWN_MS = 100.0;
+
+    bool isThrottle(const HttpResponse& response) {
+        return response.result == CURLE_OK && (response.statusCode == 429 || response.statusCode == 503);
+    }
+
+    // Seconds in "20ms", "1s", "6m0s", "1h2m3.5s" or a bare number; -1 if unreadable
+    double parseDurationSeconds(const std::string& text) {
+        if (text.empty()) {
+            return -1.0;
+        }
+
+        double total = 0.0;
+        const char* p = text.c_str();
+        while (*p) {
+            char* end;
+            double value = std::strtod(p, &end);
+            if (end == p) {
+                return -1.0;
+            }
+            p = end;
+
+            if (p[0] == 'm' && p[1] == 's') {
+                total += value / 1000.0;
+                p += 2;
+            }
+            else if (*p == 'h') {
+                total += value * 3600.0;
+                p++;
+            }
+            else if (*p == 'm') {
+                total += value * 60.0;
+                p++;
+            }
+            else if (*p == 's' || *p == '\0') {
+                total += value;
+                if (*p) p++;
+            }
+            else {
+                return -1.0;
+            }
+        }
+        return total;
+    }
+}
+
+RateLimiter& RateLimiter::getInstance() {
+    static RateLimiter instance;
+    return instance;
+}
+
+RateLimiter::RateLimiter()
+    : nextJobId(1),
+      inFlight(0),
+      pumpScheduled(false),
+      tokens(0.0),
+      lastThrottleLimit(0.0),
+      smoothedLatencyMs(0.0),
+      random(std::random_device()()),
+      throttled(0),
+      retries(0),
+      exhausted(0) {
+    ConfigManager& config = ConfigManager::getInstance();
+    enabled = config.getIntSetting("rate_limit_enabled", 1) != 0;
+
+    configuredRate = static_cast<double>(std::max(0LL, config.getIntSetting("rate_limit_rps", 0)));
+    configuredBurst = static_cast<double>(std::max(1LL, config.getIntSetting("rate_limit_burst",
+        std::max(1LL, static_cast<long long>(configuredRate)))));
+    rate = configuredRate;
+    burst = configuredBurst;
+    tokens = burst;
+
+    maxLimit = static_cast<double>(std::max(1LL, config.getIntSetting("concurrency_max", DEFAULT_MAX_CONCURRENCY)));
+    minLimit = 1.0;
+    limit = std::clamp(static_cast<double>(config.getIntSetting("concurrency_initial", DEFAULT_INITIAL_CONCURRENCY)),
+        minLimit, maxLimit);
+
+    maxRetries = static_cast<int>(std::max(0LL, config.getIntSetting("retry_max", DEFAULT_MAX_RETRIES)));
+    retryBase = std::chrono::milliseconds(std::max(1LL, config.getIntSetting("retry_base_ms", DEFAULT_RETRY_BASE_MS)));
+    retryCap = std::chrono::milliseconds(std::max(1LL, config.getIntSetting("retry_max_ms", DEFAULT_RETRY_MAX_MS)));
+
+    refilledAt = Clock::now();
+
+    // Backoffs and paced pumps wait on engine timers, which stop with the engine
+    shutdownHook = RequestEngine::getInstance().onShutdown([this]() {
+        failWaiting();
+        });
+}
+
+RateLimiter::~RateLimiter() {
+    RequestEngine::getInstance().removeShutdownHook(shutdownHook);
+}
+
+bool RateLimiter::isEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return enabled;
+}
+
+void RateLimiter::setEnabled(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    enabled = enable;
+}
+
+void RateLimiter::submit(HttpRequest request, RequestEngine::Completion onComplete) {
+    if (!isEnabled()) {
+        RequestHedger::getInstance().submit(std::move(request), std::move(onComplete));
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->request = std::move(request);
+    job->onComplete = std::move(onComplete);
+
+    // Id and callback are set before the job is visible to other threads. A
+    // cancellation that fires before it is queued is caught by the engine.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->id = nextJobId++;
+    }
+    uint64_t id = job->id;
+    job->cancelCallback = job->request.cancellation.onCancel([this, id]() {
+        abandon(id, false);
+        });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        waiting[id] = job;
+        ready.push_back(job);
+    }
+
+    if (job->request.deadline != Clock::time_point::max()) {
+        auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(job->request.deadline - Clock::now());
+        RequestEngine::getInstance().schedule(std::max(delay, std::chrono::milliseconds(0)), [this, id]() {
+            abandon(id, true);
+            });
+    }
+
+    pump();
+}
+
+bool RateLimiter::tryAcquireHedge(bool& counted) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counted = false;
+    if (!enabled) {
+        return true;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (!ready.empty() || now < pausedUntil || now < cooldownUntil ||
+        static_cast<double>(inFlight + 1) > std::max(1.0, std::floor(limit))) {
+        return false;
+    }
+    Clock::duration wait;
+    if (!takeToken(now, wait)) {
+        return false;
+    }
+    inFlight++;
+    counted = true;
+    return true;
+}
+
+void RateLimiter::releaseHedge() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight--;
+    }
+    pump();
+}
+
+void RateLimiter::pump() {
+    std::vector<std::shared_ptr<Job>> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point now = Clock::now();
+        size_t slots = static_cast<size_t>(std::max(1.0, std::floor(limit)));
+
+        while (!ready.empty() && inFlight < slots) {
+            if (now < pausedUntil) {
+                schedulePump(pausedUntil);
+                break;
+            }
+
+            Clock::duration wait;
+            if (!takeToken(now, wait)) {
+                schedulePump(now + wait);
+                break;
+            }
+
+            std::shared_ptr<Job> job = ready.front();
+            ready.pop_front();
+            waiting.erase(job->id);
+            inFlight++;
+            job->attempts++;
+            job->sentAt = now;
+            batch.push_back(std::move(job));
+        }
+    }
+
+    for (const auto& job : batch) {
+        dispatch(job);
+    }
+}
+
+void RateLimiter::dispatch(const std::shared_ptr<Job>& job) {
+    // The job keeps its request for retries; each attempt sends a copy
+    RequestHedger::getInstance().submit(job->request, [this, job](HttpResponse response) {
+        onResponse(job, std::move(response));
+        });
+}
+
+void RateLimiter::onResponse(const std::shared_ptr<Job>& job, HttpResponse response) {
+    Clock::time_point now = Clock::now();
+    bool retry = false;
+    std::chrono::milliseconds delay(0);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight--;
+
+        double latencyMs = std::chrono::duration<double, std::milli>(now - job->sentAt).count();
+        smoothedLatencyMs = smoothedLatencyMs == 0.0 ? latencyMs : 0.8 * smoothedLatencyMs + 0.2 * latencyMs;
+
+        applyRateHeaders(response, now);
+
+        if (isThrottle(response)) {
+            throttled++;
+            decreaseLimit(now);
+
+            std::chrono::milliseconds retryAfter(0);
+            double seconds = parseDurationSeconds(response.header("retry-after"));
+            if (seconds > 0.0) {
+                retryAfter = std::chrono::milliseconds(static_cast<long long>(seconds * 1000.0));
+                pausedUntil = std::max(pausedUntil, now + retryAfter);
+            }
+
+            if (job->attempts <= maxRetries && !job->request.cancellation.isCancelled()) {
+                delay = backoff(job->attempts, retryAfter);
+                if (now + delay < job->request.deadline) {
+                    retry = true;
+                    retries++;
+                    waiting[job->id] = job;
+                }
+            }
+            if (!retry) {
+                exhausted++;
+            }
+        }
+        else if (response.result == CURLE_OK && response.statusCode < 400) {
+            // Grow only when the limit is what holds requests back
+            if (static_cast<double>(inFlight + 1) >= std::floor(limit)) {
+                increaseLimit();
+            }
+        }
+    }
+
+    if (retry) {
+        RequestEngine::getInstance().schedule(delay, [this, job]() {
+            requeue(job);
+            });
+    }
+    else {
+        finish(job, std::move(response));
+    }
+    pump();
+}
+
+void RateLimiter::requeue(const std::shared_ptr<Job>& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (waiting.find(job->id) == waiting.end()) {
+            return;
+        }
+        // Retries go ahead of first attempts
+        ready.push_front(job);
+    }
+    pump();
+}
+
+void RateLimiter::abandon(uint64_t id, bool timedOut) {
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = waiting.find(id);
+        if (it == waiting.end()) {
+            return;
+        }
+        job = it->second;
+        waiting.erase(it);
+
+        auto queued = std::find(ready.begin(), ready.end(), job);
+        if (queued != ready.end()) {
+            ready.erase(queued);
+        }
+    }
+
+    HttpResponse response;
+    response.result = timedOut ? CURLE_OPERATION_TIMEDOUT : CURLE_ABORTED_BY_CALLBACK;
+    response.error = timedOut ? "Deadline exceeded" : "Request cancelled";
+    response.cancelled = true;
+    finish(job, std::move(response));
+}
+
+void RateLimiter::finish(const std::shared_ptr<Job>& job, HttpResponse response) {
+    job->request.cancellation.removeCallback(job->cancelCallback);
+    if (job->onComplete) {
+        job->onComplete(std::move(response));
+    }
+}
+
+void RateLimiter::failWaiting() {
+    std::vector<std::shared_ptr<Job>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // The engine fails later requests itself; nothing here would pump them
+        enabled = false;
+        for (auto& entry : waiting) {
+            jobs.push_back(std::move(entry.second));
+        }
+        waiting.clear();
+        ready.clear();
+    }
+
+    for (const auto& job : jobs) {
+        HttpResponse response;
+        response.result = CURLE_ABORTED_BY_CALLBACK;
+        response.error = "Request engine shut down";
+        finish(job, std::move(response));
+    }
+}
+
+bool RateLimiter::takeToken(Clock::time_point now, Clock::duration& wait) {
+    // The reported quota window has passed; back to the configured pace
+    if (quotaResetAt != Clock::time_point() && now >= quotaResetAt) {
+        quotaResetAt = Clock::time_point();
+        rate = configuredRate;
+        burst = configuredBurst;
+        tokens = std::max(tokens, 1.0);
+    }
+
+    if (rate <= 0.0) {
+        return true;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - refilledAt).count();
+    tokens = std::min(burst, tokens + elapsed * rate);
+    refilledAt = now;
+
+    if (tokens >= 1.0) {
+        tokens -= 1.0;
+        return true;
+    }
+
+    wait = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - tokens) / rate));
+    return false;
+}
+
+void RateLimiter::increaseLimit() {
+    double step = 1.0 / limit;
+    if (lastThrottleLimit > 0.0 && limit >= lastThrottleLimit * 0.9 && limit <= lastThrottleLimit * 1.1) {
+        step /= PROBE_SLOWDOWN;
+    }
+    limit = std::min(maxLimit, limit + step);
+}
+
+void RateLimiter::decreaseLimit(Clock::time_point now) {
+    // Throttles from requests sent before the last cut report the same overload
+    if (now < cooldownUntil) {
+        return;
+    }
+
+    lastThrottleLimit = limit;
+    limit = std::max(minLimit, limit * DECREASE_FACTOR);
+    auto cooldown = std::chrono::duration<double, std::milli>(std::max(MIN_COOLDOWN_MS, smoothedLatencyMs));
+    cooldownUntil = now + std::chrono::duration_cast<Clock::duration>(cooldown);
+}
+
+void RateLimiter::applyRateHeaders(const HttpResponse& response, Clock::time_point now) {
+    std::string remainingText = response.header("x-ratelimit-remaining-requests");
+    double resetSeconds = parseDurationSeconds(response.header("x-ratelimit-reset-requests"));
+    if (remainingText.empty() || resetSeconds <= 0.0) {
+        return;
+    }
+
+    double remaining = std::max(0.0, std::atof(remainingText.c_str()));
+    Clock::time_point resetAt = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(resetSeconds));
+
+    if (remaining < 1.0) {
+        pausedUntil = std::max(pausedUntil, resetAt);
+        return;
+    }
+
+    // Spread what is left of the quota evenly over the window
+    double quotaRate = remaining / resetSeconds;
+    if (rate <= 0.0) {
+        tokens = 1.0;
+        refilledAt = now;
+    }
+    rate = configuredRate > 0.0 ? std::min(configuredRate, quotaRate) : quotaRate;
+    burst = 1.0;
+    tokens = std::min(tokens, burst);
+    quotaResetAt = resetAt;
+}
+
+std::chrono::milliseconds RateLimiter::backoff(int attempt, std::chrono::milliseconds retryAfter) {
+    // Full jitter: uniform in [0, min(cap, base * 2^(attempt - 1))]
+    long long ceiling = retryBase.count() << std::min(attempt - 1, 20);
+    ceiling = std::min(ceiling, static_cast<long long>(retryCap.count()));
+    std::uniform_int_distribution<long long> distribution(0, ceiling);
+    return std::max(std::chrono::milliseconds(distribution(random)), retryAfter);
+}
+
+void RateLimiter::schedulePump(Clock::time_point at) {
+    if (pumpScheduled && pumpAt <= at) {
+        return;
+    }
+    pumpScheduled = true;
+    pumpAt = at;
+
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(at - Clock::now()) + std::chrono::milliseconds(1);
+    RequestEngine::getInstance().schedule(std::max(delay, std::chrono::milliseconds(0)), [this]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pumpScheduled = false;
+        }
+        pump();
+        });
+}
+
+RateLimiterStats RateLimiter::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    RateLimiterStats stats;
+    stats.concurrencyLimit = limit;
+    stats.inFlight = inFlight;
+    stats.queued = waiting.size();
+    stats.throttled = throttled;
+    stats.retries = retries;
+    stats.exhausted = exhausted;
+    stats.requestsPerSecond = rate;
+    return stats;
+}
@@ -0,0 +1,231 @@
+#include "include/utils/RequestCoalescer.h"
+#include <vector>
+
+class RequestCoalescer::Flight {
+public:
+    struct Waiter {
+        uint64_t id;
+        ChunkCallback onChunk;
+        Completion onComplete;
+        CancellationToken cancellation;
+        CancellationToken::CallbackId cancelCallback;
+    };
+
+    explicit Flight(const FlightKey& key) : key(key), nextWaiterId(1) {}
+
+    const FlightKey key;
+    const CancellationToken upstream;
+
+    std::mutex mutex;
+    std::vector<Waiter> waiters;
+    std::string streamed;  // Everything published so far, for late joiners
+    uint64_t nextWaiterId;
+};
+
+RequestCoalescer& RequestCoalescer::getInstance() {
+    static RequestCoalescer instance;
+    return instance;
+}
+
+RequestCoalescer::RequestCoalescer() : flightCount(0), savedCalls(0), engineStopped(false) {
+    shutdownHook = RequestEngine::getInstance().onShutdown([this]() {
+        abandonAll();
+        });
+}
+
+RequestCoalescer::~RequestCoalescer() {
+    RequestEngine::getInstance().removeShutdownHook(shutdownHook);
+}
+
+std::shared_ptr<RequestCoalescer::Flight> RequestCoalescer::join(const FlightKey& key,
+    ChunkCallback onChunk, Completion onComplete,
+    const CancellationToken& cancellation, std::chrono::steady_clock::time_point deadline) {
+    std::shared_ptr<Flight> flight;
+    std::shared_ptr<Flight> leader;
+    uint64_t waiterId;
+    {
+        std::unique_lock<std::mutex> flightsLock(flightsMutex);
+
+        auto it = flights.find(key);
+        if (it == flights.end()) {
+            flight = std::make_shared<Flight>(key);
+            leader = flight;
+            flights.emplace(key, flight);
+            flightCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            flight = it->second;
+        }
+
+        // Take the flight lock before letting go of the map, so finish() cannot
+        // complete the flight between lookup and registration
+        std::lock_guard<std::mutex> flightLock(flight->mutex);
+        flightsLock.unlock();
+
+        if (!leader) {
+            if (onChunk && !flight->streamed.empty()) {
+                onChunk(flight->streamed);
+            }
+            savedCalls.fetch_add(1, std::memory_order_relaxed);
+        }
+        waiterId = flight->nextWaiterId++;
+        flight->waiters.push_back(Flight::Waiter{ waiterId, std::move(onChunk), std::move(onComplete), cancellation, 0 });
+    }
+
+    // Leaving is deferred to the engine thread, so a chunk callback may
+    // cancel its own request while publish() holds the flight lock. Once the
+    // engine has stopped nothing publishes any more, and its timers never run.
+    std::weak_ptr<Flight> weak = flight;
+    CancellationToken::CallbackId callback = cancellation.onCancel([this, weak, waiterId]() {
+        auto leaveFlight = [this, weak, waiterId]() {
+            if (auto flight = weak.lock()) {
+                leave(flight, waiterId, false);
+            }
+            };
+        if (engineStopped.load()) {
+            leaveFlight();
+        }
+        else {
+            RequestEngine::getInstance().schedule(std::chrono::milliseconds(0), leaveFlight);
+        }
+        });
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        for (auto& waiter : flight->waiters) {
+            if (waiter.id == waiterId) {
+                waiter.cancelCallback = callback;
+            }
+        }
+    }
+
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        RequestEngine::getInstance().schedule(std::max(delay, std::chrono::milliseconds(0)), [this, weak, waiterId]() {
+            if (auto flight = weak.lock()) {
+                leave(flight, waiterId, true);
+            }
+            });
+    }
+
+    return leader;
+}
+
+CancellationToken RequestCoalescer::upstreamCancellation(const std::shared_ptr<Flight>& flight) const {
+    return flight->upstream;
+}
+
+void RequestCoalescer::publish(const std::shared_ptr<Flight>& flight, const std::string& chunk) {
+    std::lock_guard<std::mutex> lock(flight->mutex);
+    flight->streamed += chunk;
+    for (const auto& waiter : flight->waiters) {
+        if (waiter.onChunk) {
+            waiter.onChunk(chunk);
+        }
+    }
+}
+
+void RequestCoalescer::finish(const std::shared_ptr<Flight>& flight, const std::string& reply) {
+    {
+        std::lock_guard<std::mutex> lock(flightsMutex);
+        auto it = flights.find(flight->key);
+        if (it != flights.end() && it->second == flight) {
+            flights.erase(it);
+        }
+    }
+
+    std::vector<Flight::Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        waiters.swap(flight->waiters);
+    }
+
+    for (const auto& waiter : waiters) {
+        waiter.cancellation.removeCallback(waiter.cancelCallback);
+        if (waiter.onComplete) {
+            waiter.onComplete(reply);
+        }
+    }
+}
+
+void RequestCoalescer::leave(const std::shared_ptr<Flight>& flight, uint64_t waiterId, bool timedOut) {
+    Flight::Waiter waiter;
+    std::string partial;
+    bool lastWaiter;
+    {
+        // Map first, as in join(), so nobody joins a flight about to be aborted
+        std::lock_guard<std::mutex> flightsLock(flightsMutex);
+        std::lock_guard<std::mutex> flightLock(flight->mutex);
+        auto it = flight->waiters.begin();
+        while (it != flight->waiters.end() && it->id != waiterId) {
+            ++it;
+        }
+        if (it == flight->waiters.end()) {
+            return;
+        }
+        waiter = std::move(*it);
+        flight->waiters.erase(it);
+        partial = flight->streamed;
+
+        lastWaiter = flight->waiters.empty();
+        if (lastWaiter) {
+            auto entry = flights.find(flight->key);
+            if (entry != flights.end() && entry->second == flight) {
+                flights.erase(entry);
+            }
+        }
+    }
+
+    // Nobody wants the reply any more
+    if (lastWaiter) {
+        flight->upstream.cancel();
+    }
+
+    waiter.cancellation.removeCallback(waiter.cancelCallback);
+    if (waiter.onComplete) {
+        if (flight->key.stream) {
+            waiter.onComplete(partial);
+        }
+        else {
+            waiter.onComplete(timedOut ? "CURL error: Deadline exceeded" : "CURL error: Request cancelled");
+        }
+    }
+}
+
+void RequestCoalescer::abandonAll() {
+    std::vector<std::shared_ptr<Flight>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(flightsMutex);
+        engineStopped.store(true);
+        for (auto& entry : flights) {
+            abandoned.push_back(std::move(entry.second));
+        }
+        flights.clear();
+    }
+
+    for (const auto& flight : abandoned) {
+        std::vector<Flight::Waiter> waiters;
+        std::string partial;
+        {
+            std::lock_guard<std::mutex> lock(flight->mutex);
+            waiters.swap(flight->waiters);
+            partial = flight->streamed;
+        }
+        flight->upstream.cancel();
+
+        for (const auto& waiter : waiters) {
+            waiter.cancellation.removeCallback(waiter.cancelCallback);
+            if (waiter.onComplete) {
+                waiter.onComplete(flight->key.stream ? partial : "CURL error: Request engine shut down");
+            }
+        }
+    }
+}
+
+CoalescerStats RequestCoalescer::getStats() const {
+    CoalescerStats stats;
+    stats.flights = flightCount.load(std::memory_order_relaxed);
+    stats.savedCalls = savedCalls.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(flightsMutex);
+    stats.inFlight = flights.size();
+    return stats;
+}
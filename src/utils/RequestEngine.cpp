@@ -0,0 +1,676 @@
+#include "include/utils/RequestEngine.h"
+#include "include/utils/CurlHandlePool.h"
+#include "include/utils/ErrorHandler.h"
+#include "include/utils/Metrics.h"
+#include "include/utils/Tracer.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <string_view>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+    // Upper bound on how long the fallback loop sleeps without a wakeup
+    const int FALLBACK_POLL_MS = 1000;
+
+    struct TransferMetrics {
+        MetricCounter& transfers;
+        MetricCounter& failures;
+        MetricCounter& newConnections;
+        MetricHistogram& dns;
+        MetricHistogram& connect;
+        MetricHistogram& tls;
+        MetricHistogram& firstByte;
+        MetricHistogram& total;
+    };
+
+    TransferMetrics& transferMetrics() {
+        Metrics& registry = Metrics::getInstance();
+        const std::vector<double>& bounds = Metrics::latencyBounds();
+        static TransferMetrics metrics{
+            registry.counter("pichat_http_transfers_total", "HTTP transfers finished, cancelled ones excluded"),
+            registry.counter("pichat_http_transfer_errors_total", "HTTP transfers that ended in a transport error"),
+            registry.counter("pichat_http_new_connections_total", "HTTP transfers that opened a new connection"),
+            registry.histogram("pichat_http_dns_seconds", "Name lookup time of new connections", 1e-6, bounds),
+            registry.histogram("pichat_http_connect_seconds", "TCP connect time of new connections", 1e-6, bounds),
+            registry.histogram("pichat_http_tls_seconds", "TLS handshake time of new connections", 1e-6, bounds),
+            registry.histogram("pichat_http_ttfb_seconds", "Time from sending the request to the first response byte", 1e-6, bounds),
+            registry.histogram("pichat_http_total_seconds", "Total time of a transfer", 1e-6, bounds)
+        };
+        return metrics;
+    }
+
+    // Timings are cumulative from the start of the transfer, in microseconds
+    void recordTransfer(CURL* easy, CURLcode result) {
+        TransferMetrics& metrics = transferMetrics();
+        metrics.transfers.add();
+        if (result != CURLE_OK) {
+            metrics.failures.add();
+            return;
+        }
+
+        curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, firstByte = 0, total = 0;
+        long connects = 0;
+        curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+        curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &tls);
+        curl_easy_getinfo(easy, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+        curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+        curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total);
+        curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+
+        // A reused connection has no handshakes to time
+        if (connects > 0) {
+            metrics.newConnections.add();
+            metrics.dns.observe(dns / 1e6);
+            metrics.connect.observe((connect - dns) / 1e6);
+            if (tls > 0) {
+                metrics.tls.observe((tls - connect) / 1e6);
+            }
+        }
+        metrics.firstByte.observe((firstByte - pretransfer) / 1e6);
+        metrics.total.observe(total / 1e6);
+    }
+}
+
+// State of one transfer, owned by the engine until its completion is delivered
+struct RequestEngine::Transfer {
+    TransferId id = 0;
+    HttpRequest request;
+    Completion onComplete;
+    CURL* easy = nullptr;
+    struct curl_slist* headers = nullptr;
+    HttpResponse response;
+    char errorBuffer[CURL_ERROR_SIZE] = { 0 };
+    bool cancelled = false;
+    CancellationToken::CallbackId cancelCallback = 0;
+    int sinkState = 0;  // 0 until the first body chunk, then 1 to stream to onData, -1 to collect
+};
+
+RequestEngine::RequestEngine()
+    : multi(nullptr), running(false), stopped(false), nextHookId(1), nextId(1), timerArmed(false), activeCount(0) {
+#ifdef __linux__
+    epollFd = -1;
+    wakeFd = -1;
+#endif
+}
+
+RequestEngine::~RequestEngine() {
+    shutdown();
+}
+
+RequestEngine& RequestEngine::getInstance() {
+    static RequestEngine instance;
+    return instance;
+}
+
+RequestEngine::TransferId RequestEngine::submit(HttpRequest request, Completion onComplete) {
+    auto transfer = std::make_unique<Transfer>();
+    TransferId id = nextId.fetch_add(1);
+    transfer->id = id;
+    transfer->request = std::move(request);
+    transfer->onComplete = std::move(onComplete);
+
+    ensureStarted();
+    activeCount++;
+
+    if (!running.load()) {
+        transfer->response.result = CURLE_FAILED_INIT;
+        transfer->response.error = "Request engine is not running";
+        deliver(std::move(transfer));
+        return id;
+    }
+
+    if (transfer->request.cancellation.isCancelled()) {
+        transfer->response.result = CURLE_ABORTED_BY_CALLBACK;
+        transfer->response.error = "Request cancelled";
+        transfer->response.cancelled = true;
+        deliver(std::move(transfer));
+        return id;
+    }
+    transfer->cancelCallback = transfer->request.cancellation.onCancel([this, id]() {
+        cancel(id);
+        });
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.push_back(std::move(transfer));
+    }
+    wakeUp();
+    return id;
+}
+
+std::future<HttpResponse> RequestEngine::submit(HttpRequest request) {
+    auto promise = std::make_shared<std::promise<HttpResponse>>();
+    std::future<HttpResponse> future = promise->get_future();
+
+    submit(std::move(request), [promise](HttpResponse response) {
+        promise->set_value(std::move(response));
+        });
+
+    return future;
+}
+
+void RequestEngine::cancel(TransferId id) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (!running.load()) {
+            return;
+        }
+        cancelled.push_back(id);
+    }
+    wakeUp();
+}
+
+void RequestEngine::schedule(std::chrono::milliseconds delay, std::function<void()> task) {
+    ensureStarted();
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        timers.push_back(Timer{ std::chrono::steady_clock::now() + delay, std::move(task) });
+        std::push_heap(timers.begin(), timers.end());
+    }
+    wakeUp();
+}
+
+RequestEngine::HookId RequestEngine::onShutdown(std::function<void()> hook) {
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (!stopped) {
+            HookId id = nextHookId++;
+            shutdownHooks.emplace_back(id, std::move(hook));
+            return id;
+        }
+    }
+    hook();
+    return 0;
+}
+
+void RequestEngine::removeShutdownHook(HookId id) {
+    std::lock_guard<std::mutex> lock(startMutex);
+    shutdownHooks.erase(std::remove_if(shutdownHooks.begin(), shutdownHooks.end(),
+        [id](const std::pair<HookId, std::function<void()>>& entry) { return entry.first == id; }),
+        shutdownHooks.end());
+}
+
+size_t RequestEngine::activeTransfers() const {
+    return activeCount.load();
+}
+
+void RequestEngine::ensureStarted() {
+    std::lock_guard<std::mutex> lock(startMutex);
+    if (running.load() || stopped) {
+        return;
+    }
+
+    multi = curl_multi_init();
+    if (!multi) {
+        return;
+    }
+
+#ifdef __linux__
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+        epollFd = wakeFd = -1;
+        curl_multi_cleanup(multi);
+        multi = nullptr;
+        return;
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, &RequestEngine::socketCallback);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, &RequestEngine::timerCallback);
+    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+#endif
+
+    running.store(true);
+    loopThread = std::thread(&RequestEngine::run, this);
+}
+
+void RequestEngine::shutdown() {
+    std::vector<std::pair<HookId, std::function<void()>>> hooks;
+    bool wasRunning;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        stopped = true;
+        wasRunning = running.load();
+        running.store(false);
+        hooks.swap(shutdownHooks);
+    }
+    if (wasRunning) {
+        stopLoop();
+    }
+
+    // Timers never fire from here on; what waits on them is failed by its owner
+    for (auto& hook : hooks) {
+        hook.second();
+    }
+}
+
+void RequestEngine::stopLoop() {
+    wakeUp();
+    if (loopThread.joinable()) {
+        loopThread.join();
+    }
+
+    // Fail whatever the loop did not finish
+    std::vector<CURL*> unfinished;
+    for (const auto& entry : inFlight) {
+        unfinished.push_back(entry.first);
+    }
+    for (CURL* easy : unfinished) {
+        finishTransfer(easy, CURLE_ABORTED_BY_CALLBACK);
+    }
+
+    std::deque<std::unique_ptr<Transfer>> leftover;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        leftover.swap(pending);
+        cancelled.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        timers.clear();
+    }
+    for (auto& transfer : leftover) {
+        transfer->response.result = CURLE_ABORTED_BY_CALLBACK;
+        transfer->response.error = "Request engine shut down";
+        deliver(std::move(transfer));
+    }
+
+    curl_multi_cleanup(multi);
+    multi = nullptr;
+
+#ifdef __linux__
+    close(epollFd);
+    close(wakeFd);
+    epollFd = wakeFd = -1;
+#endif
+}
+
+void RequestEngine::wakeUp() {
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        // Counter already signalled; the loop will wake anyway
+    }
+#else
+    curl_multi_wakeup(multi);
+#endif
+}
+
+#ifdef __linux__
+void RequestEngine::run() {
+    Tracer::setThreadName("RequestEngine");
+    struct epoll_event events[64];
+    int stillRunning = 0;
+
+    while (running.load()) {
+        int count = epoll_wait(epollFd, events, 64, loopTimeoutMs());
+        if (count < 0 && errno != EINTR) {
+            ErrorHandler::getInstance().logError("epoll_wait failed", "RequestEngine");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                uint64_t value;
+                while (read(wakeFd, &value, sizeof(value)) > 0) {
+                }
+                continue;
+            }
+
+            int flags = 0;
+            if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+            if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+            curl_multi_socket_action(multi, fd, flags, &stillRunning);
+        }
+
+        if (timerArmed && std::chrono::steady_clock::now() >= timerDeadline) {
+            timerArmed = false;
+            curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &stillRunning);
+        }
+
+        addPendingTransfers();
+        runDueTimers();
+        addPendingTransfers();
+        processCancellations();
+        processCompletedTransfers();
+    }
+}
+#else
+void RequestEngine::run() {
+    // Portable fallback: no epoll, let libcurl wait on its own sockets
+    Tracer::setThreadName("RequestEngine");
+    int stillRunning = 0;
+
+    while (running.load()) {
+        addPendingTransfers();
+        runDueTimers();
+        addPendingTransfers();
+        processCancellations();
+        curl_multi_perform(multi, &stillRunning);
+        processCompletedTransfers();
+
+        int timeoutMs = loopTimeoutMs();
+        if (timeoutMs < 0 || timeoutMs > FALLBACK_POLL_MS) {
+            timeoutMs = FALLBACK_POLL_MS;
+        }
+        curl_multi_poll(multi, nullptr, 0, timeoutMs, nullptr);
+    }
+}
+#endif
+
+int RequestEngine::loopTimeoutMs() const {
+    // Earliest of libcurl's timer and our own
+    bool armed = timerArmed;
+    std::chrono::steady_clock::time_point deadline = timerDeadline;
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        if (!timers.empty() && (!armed || timers.front().deadline < deadline)) {
+            armed = true;
+            deadline = timers.front().deadline;
+        }
+    }
+
+    if (!armed) {
+        return -1;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    return remaining > 0 ? static_cast<int>(remaining) + 1 : 0;
+}
+
+void RequestEngine::runDueTimers() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::function<void()>> due;
+    {
+        std::lock_guard<std::mutex> lock(timersMutex);
+        while (!timers.empty() && timers.front().deadline <= now) {
+            std::pop_heap(timers.begin(), timers.end());
+            due.push_back(std::move(timers.back().task));
+            timers.pop_back();
+        }
+    }
+
+    for (auto& task : due) {
+        try {
+            task();
+        }
+        catch (const std::exception& e) {
+            ErrorHandler::getInstance().logError(std::string("Timer task failed: ") + e.what(), "RequestEngine");
+        }
+    }
+}
+
+void RequestEngine::processCancellations() {
+    std::vector<TransferId> ids;
+    std::vector<std::unique_ptr<Transfer>> notStarted;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        ids.swap(cancelled);
+
+        // Submitted after this iteration picked up the pending queue
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (std::find(ids.begin(), ids.end(), (*it)->id) != ids.end()) {
+                notStarted.push_back(std::move(*it));
+                it = pending.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    for (auto& transfer : notStarted) {
+        transfer->response.result = CURLE_ABORTED_BY_CALLBACK;
+        transfer->response.error = "Request cancelled";
+        transfer->response.cancelled = true;
+        deliver(std::move(transfer));
+    }
+
+    for (TransferId id : ids) {
+        for (const auto& entry : inFlight) {
+            if (entry.second->id == id) {
+                entry.second->cancelled = true;
+                finishTransfer(entry.first, CURLE_ABORTED_BY_CALLBACK);
+                break;
+            }
+        }
+    }
+}
+
+void RequestEngine::addPendingTransfers() {
+    std::deque<std::unique_ptr<Transfer>> batch;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        batch.swap(pending);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto& transfer : batch) {
+        bool hasDeadline = transfer->request.deadline != std::chrono::steady_clock::time_point::max();
+        if (hasDeadline && transfer->request.deadline <= now) {
+            transfer->response.result = CURLE_OPERATION_TIMEDOUT;
+            transfer->response.error = "Deadline exceeded";
+            transfer->response.cancelled = true;
+            deliver(std::move(transfer));
+            continue;
+        }
+
+        CURL* easy = CurlHandlePool::getInstance().acquire();
+        if (!easy) {
+            transfer->response.result = CURLE_FAILED_INIT;
+            transfer->response.error = "Failed to initialize CURL";
+            deliver(std::move(transfer));
+            continue;
+        }
+
+        transfer->easy = easy;
+        for (const auto& header : transfer->request.headers) {
+            transfer->headers = curl_slist_append(transfer->headers, header.c_str());
+        }
+
+        curl_easy_setopt(easy, CURLOPT_URL, transfer->request.url.c_str());
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->request.body.c_str());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(transfer->request.body.size()));
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &RequestEngine::writeCallback);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &RequestEngine::headerCallback);
+        curl_easy_setopt(easy, CURLOPT_HEADERDATA, transfer.get());
+        curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, transfer->errorBuffer);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+        if (hasDeadline) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(transfer->request.deadline - now);
+            long long timeoutMs = std::clamp<long long>(remaining.count(), 1, std::numeric_limits<long>::max());
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(timeoutMs));
+        }
+        if (transfer->request.ownConnection) {
+            // HTTP/1.1 never reuses a busy connection, and never joins an HTTP/2 one
+            curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_1_1));
+        }
+
+        Transfer* raw = transfer.get();
+        inFlight[easy] = std::move(transfer);
+
+        if (curl_multi_add_handle(multi, easy) != CURLM_OK) {
+            raw->easy = nullptr;
+            finishTransfer(easy, CURLE_FAILED_INIT);
+            CurlHandlePool::getInstance().release(easy);
+            continue;
+        }
+        Tracer::getInstance().asyncBegin("http_transfer", "net", raw->id);
+    }
+}
+
+void RequestEngine::processCompletedTransfers() {
+    CURLMsg* message;
+    int remaining = 0;
+    while ((message = curl_multi_info_read(multi, &remaining)) != nullptr) {
+        if (message->msg == CURLMSG_DONE) {
+            CURL* easy = message->easy_handle;
+            CURLcode result = message->data.result;
+            finishTransfer(easy, result);
+        }
+    }
+}
+
+void RequestEngine::finishTransfer(CURL* easy, CURLcode result) {
+    auto it = inFlight.find(easy);
+    if (it == inFlight.end()) {
+        return;
+    }
+
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    inFlight.erase(it);
+
+    transfer->response.result = result;
+    if (transfer->cancelled) {
+        transfer->response.error = "Request cancelled";
+        transfer->response.cancelled = true;
+    }
+    else if (result != CURLE_OK) {
+        transfer->response.error = transfer->errorBuffer[0] != '\0'
+            ? std::string(transfer->errorBuffer)
+            : std::string(curl_easy_strerror(result));
+        // With a deadline set, CURLOPT_TIMEOUT_MS bounds every other timeout
+        transfer->response.cancelled = result == CURLE_OPERATION_TIMEDOUT &&
+            transfer->request.deadline != std::chrono::steady_clock::time_point::max();
+    }
+
+    // easy is null when the handle never made it into the multi handle
+    if (transfer->easy) {
+        Tracer::getInstance().asyncEnd("http_transfer", "net", transfer->id);
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->response.statusCode);
+        if (!transfer->response.cancelled) {
+            recordTransfer(easy, result);
+        }
+        curl_multi_remove_handle(multi, easy);
+        CurlHandlePool::getInstance().release(easy);
+        transfer->easy = nullptr;
+    }
+
+    curl_slist_free_all(transfer->headers);
+    transfer->headers = nullptr;
+
+    deliver(std::move(transfer));
+}
+
+void RequestEngine::deliver(std::unique_ptr<Transfer> transfer) {
+    activeCount--;
+    transfer->request.cancellation.removeCallback(transfer->cancelCallback);
+    if (!transfer->onComplete) {
+        return;
+    }
+
+    try {
+        transfer->onComplete(std::move(transfer->response));
+    }
+    catch (const std::exception& e) {
+        ErrorHandler::getInstance().logError(std::string("Completion callback failed: ") + e.what(), "RequestEngine");
+    }
+}
+
+int RequestEngine::socketCallback(CURL*, curl_socket_t socket, int what, void* userp, void*) {
+#ifdef __linux__
+    auto* engine = static_cast<RequestEngine*>(userp);
+
+    if (what == CURL_POLL_REMOVE) {
+        epoll_ctl(engine->epollFd, EPOLL_CTL_DEL, socket, nullptr);
+        return 0;
+    }
+
+    struct epoll_event event = {};
+    event.data.fd = socket;
+    if (what & CURL_POLL_IN) event.events |= EPOLLIN;
+    if (what & CURL_POLL_OUT) event.events |= EPOLLOUT;
+
+    if (epoll_ctl(engine->epollFd, EPOLL_CTL_MOD, socket, &event) != 0 && errno == ENOENT) {
+        epoll_ctl(engine->epollFd, EPOLL_CTL_ADD, socket, &event);
+    }
+#else
+    (void)socket;
+    (void)what;
+    (void)userp;
+#endif
+    return 0;
+}
+
+int RequestEngine::timerCallback(CURLM*, long timeoutMs, void* userp) {
+    auto* engine = static_cast<RequestEngine*>(userp);
+
+    if (timeoutMs < 0) {
+        engine->timerArmed = false;
+    }
+    else {
+        engine->timerArmed = true;
+        engine->timerDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    }
+    return 0;
+}
+
+size_t RequestEngine::writeCallback(char* data, size_t size, size_t nmemb, void* userp) {
+    auto* transfer = static_cast<Transfer*>(userp);
+    size_t bytes = size * nmemb;
+
+    // Only a successful response is streamed; an error body is kept for the caller
+    if (transfer->sinkState == 0) {
+        long status = 0;
+        curl_easy_getinfo(transfer->easy, CURLINFO_RESPONSE_CODE, &status);
+        transfer->sinkState = transfer->request.onData && status >= 200 && status < 300 ? 1 : -1;
+    }
+
+    if (transfer->sinkState > 0) {
+        return transfer->request.onData(data, bytes) ? bytes : 0;
+    }
+
+    transfer->response.body.append(data, bytes);
+    return bytes;
+}
+
+size_t RequestEngine::headerCallback(char* data, size_t size, size_t nmemb, void* userp) {
+    auto* transfer = static_cast<Transfer*>(userp);
+    size_t bytes = size * nmemb;
+    std::string_view line(data, bytes);
+
+    // A status line starts a new response (after 100 Continue or a redirect)
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        transfer->response.headers.clear();
+        return bytes;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+        return bytes;
+    }
+
+    std::string name(line.substr(0, colon));
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+        });
+
+    std::string_view value = line.substr(colon + 1);
+    size_t first = value.find_first_not_of(" \t");
+    size_t last = value.find_last_not_of(" \t\r\n");
+    value = first == std::string_view::npos ? std::string_view() : value.substr(first, last - first + 1);
+
+    transfer->response.headers.emplace_back(std::move(name), std::string(value));
+    return bytes;
+}
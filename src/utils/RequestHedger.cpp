@@ -0,0 +1,283 @@
+#include "include/utils/RequestHedger.h"
+#include "include/utils/RateLimiter.h"
+#include "include/config/ConfigManager.h"
+#include <algorithm>
+
+namespace {
+    const long long DEFAULT_PERCENTILE = 95;
+    const long long DEFAULT_MIN_DELAY_MS = 50;
+    const long long DEFAULT_INITIAL_DELAY_MS = 2000;
+    const long long DEFAULT_MIN_SAMPLES = 20;
+    const size_t LATENCY_WINDOW = 256;
+
+    double elapsedMs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+}
+
+// One request and its (at most two) attempts. Attempt 0 is the primary,
+// attempt 1 the hedge. Everything after submission runs on the engine thread.
+struct RequestHedger::HedgedCall {
+    std::mutex mutex;
+
+    HttpRequest request;  // Template for the hedge, sink stripped
+    std::function<bool(const char* data, size_t size)> onData;
+    RequestEngine::Completion onComplete;
+
+    std::chrono::steady_clock::time_point started[2];
+    RequestEngine::TransferId ids[2] = { 0, 0 };
+    bool launched[2] = { false, false };
+    bool finished[2] = { false, false };
+    int winner = -1;
+    bool delivered = false;
+    bool hedgeCounted = false;  // The hedge holds a RateLimiter slot
+    HttpResponse failure;  // First failed attempt, reported if the other fails too
+};
+
+RequestHedger& RequestHedger::getInstance() {
+    static RequestHedger instance;
+    return instance;
+}
+
+RequestHedger::RequestHedger()
+    : firstByteLatency(LATENCY_WINDOW),
+      responseLatency(LATENCY_WINDOW),
+      requests(0),
+      hedged(0),
+      hedgeWins(0),
+      hedgesSkipped(0),
+      latencySavedUs(0) {
+    ConfigManager& config = ConfigManager::getInstance();
+    enabled = config.getIntSetting("hedge_enabled", 0) != 0;
+    percentile = std::clamp(static_cast<double>(config.getIntSetting("hedge_percentile", DEFAULT_PERCENTILE)), 1.0, 100.0);
+    minDelay = std::chrono::milliseconds(std::max(0LL, config.getIntSetting("hedge_min_delay_ms", DEFAULT_MIN_DELAY_MS)));
+    initialDelay = std::chrono::milliseconds(std::max(0LL, config.getIntSetting("hedge_initial_delay_ms", DEFAULT_INITIAL_DELAY_MS)));
+    minSamples = static_cast<size_t>(std::max(1LL, config.getIntSetting("hedge_min_samples", DEFAULT_MIN_SAMPLES)));
+}
+
+bool RequestHedger::isEnabled() const {
+    return enabled.load();
+}
+
+void RequestHedger::setEnabled(bool enable) {
+    enabled.store(enable);
+}
+
+void RequestHedger::submit(HttpRequest request, RequestEngine::Completion onComplete) {
+    RequestEngine& engine = RequestEngine::getInstance();
+    if (!enabled.load()) {
+        engine.submit(std::move(request), std::move(onComplete));
+        return;
+    }
+
+    requests++;
+
+    auto call = std::make_shared<HedgedCall>();
+    call->onData = std::move(request.onData);
+    call->onComplete = std::move(onComplete);
+    call->request = std::move(request);
+
+    HttpRequest primary = call->request;
+    if (call->onData) {
+        primary.onData = [this, call](const char* data, size_t size) {
+            return onAttemptData(call, 0, data, size);
+            };
+    }
+
+    std::chrono::milliseconds delay = delayFor(call->onData ? firstByteLatency : responseLatency);
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        call->launched[0] = true;
+        call->started[0] = std::chrono::steady_clock::now();
+        call->ids[0] = engine.submit(std::move(primary), [this, call](HttpResponse response) {
+            onAttemptComplete(call, 0, std::move(response));
+            });
+    }
+
+    engine.schedule(delay, [this, call]() {
+        launchHedge(call);
+        });
+}
+
+void RequestHedger::launchHedge(const std::shared_ptr<HedgedCall>& call) {
+    HttpRequest hedge;
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (call->winner >= 0 || call->finished[0]) {
+            return;
+        }
+
+        // A duplicate adds load, which a slow or throttling API can least afford
+        if (!RateLimiter::getInstance().tryAcquireHedge(call->hedgeCounted)) {
+            hedgesSkipped++;
+            return;
+        }
+        call->launched[1] = true;
+        call->started[1] = std::chrono::steady_clock::now();
+        hedge = std::move(call->request);
+    }
+
+    hedge.ownConnection = true;
+    if (call->onData) {
+        hedge.onData = [this, call](const char* data, size_t size) {
+            return onAttemptData(call, 1, data, size);
+            };
+    }
+
+    hedged++;
+    RequestEngine::TransferId id = RequestEngine::getInstance().submit(std::move(hedge),
+        [this, call](HttpResponse response) {
+            onAttemptComplete(call, 1, std::move(response));
+        });
+
+    std::lock_guard<std::mutex> lock(call->mutex);
+    call->ids[1] = id;
+}
+
+bool RequestHedger::onAttemptData(const std::shared_ptr<HedgedCall>& call, int attempt,
+    const char* data, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (call->winner < 0) {
+            declareWinner(*call, attempt);
+        }
+        if (call->winner != attempt) {
+            return false;
+        }
+    }
+    return call->onData(data, size);
+}
+
+void RequestHedger::onAttemptComplete(const std::shared_ptr<HedgedCall>& call, int attempt,
+    HttpResponse response) {
+    int other = 1 - attempt;
+    bool release;
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        call->finished[attempt] = true;
+        release = attempt == 1 && call->hedgeCounted;
+    }
+    if (release) {
+        RateLimiter::getInstance().releaseHedge();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (call->delivered || (call->winner >= 0 && call->winner != attempt)) {
+            return;
+        }
+
+        if (call->winner < 0) {
+            // A streamed attempt that ends without a byte has failed; a whole
+            // response wins unless it is a transport or server error
+            bool succeeded = !call->onData && response.result == CURLE_OK && response.statusCode < 500;
+            if (succeeded) {
+                declareWinner(*call, attempt);
+            }
+            else if (call->launched[other] && !call->finished[other]) {
+                call->failure = std::move(response);
+                return;
+            }
+            else if (call->launched[other]) {
+                // Both failed: report the first failure
+                response = std::move(call->failure);
+            }
+        }
+        call->delivered = true;
+    }
+
+    call->onComplete(std::move(response));
+}
+
+void RequestHedger::declareWinner(HedgedCall& call, int attempt) {
+    int other = 1 - attempt;
+    call.winner = attempt;
+
+    LatencyWindow& window = call.onData ? firstByteLatency : responseLatency;
+    if (attempt == 1) {
+        hedgeWins++;
+        double primaryElapsed = elapsedMs(call.started[0]);
+        double expected = window.expectedGiven(primaryElapsed);
+        latencySavedUs += static_cast<long long>((expected - primaryElapsed) * 1000.0);
+
+        // The primary took at least this long; recording only the fast hedge
+        // would drag the percentile down and hedge ever more requests
+        window.record(primaryElapsed, false);
+    }
+    window.record(elapsedMs(call.started[attempt]));
+
+    if (call.launched[other] && !call.finished[other]) {
+        RequestEngine::getInstance().cancel(call.ids[other]);
+    }
+}
+
+std::chrono::milliseconds RequestHedger::delayFor(const LatencyWindow& window) const {
+    if (window.size() < minSamples) {
+        return initialDelay;
+    }
+    auto delay = std::chrono::milliseconds(static_cast<long long>(window.percentile(percentile)));
+    return std::max(delay, minDelay);
+}
+
+HedgeStats RequestHedger::getStats() const {
+    HedgeStats stats;
+    stats.requests = requests.load();
+    stats.hedged = hedged.load();
+    stats.hedgeWins = hedgeWins.load();
+    stats.hedgesSkipped = hedgesSkipped.load();
+    stats.latencySavedMs = latencySavedUs.load() / 1000.0;
+    stats.firstByteDelayMs = delayFor(firstByteLatency).count();
+    stats.responseDelayMs = delayFor(responseLatency).count();
+    return stats;
+}
+
+RequestHedger::LatencyWindow::LatencyWindow(size_t capacity) : next(0), capacity(capacity) {
+    samples.reserve(capacity);
+}
+
+void RequestHedger::LatencyWindow::record(double ms, bool complete) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (samples.size() < capacity) {
+        samples.push_back(Sample{ ms, complete });
+    }
+    else {
+        samples[next] = Sample{ ms, complete };
+    }
+    next = (next + 1) % capacity;
+}
+
+size_t RequestHedger::LatencyWindow::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return samples.size();
+}
+
+double RequestHedger::LatencyWindow::percentile(double p) const {
+    std::vector<double> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted.reserve(samples.size());
+        for (const Sample& sample : samples) {
+            sorted.push_back(sample.ms);
+        }
+    }
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double RequestHedger::LatencyWindow::expectedGiven(double elapsedMs) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    double sum = 0.0;
+    size_t count = 0;
+    for (const Sample& sample : samples) {
+        if (sample.complete && sample.ms > elapsedMs) {
+            sum += sample.ms;
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : elapsedMs;
+}
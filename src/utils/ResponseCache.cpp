@@ -0,0 +1,605 @@
+#include "include/utils/ResponseCache.h"
+#include "include/config/ConfigManager.h"
+#include "include/utils/ErrorHandler.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    const size_t DEFAULT_MEMORY_ENTRIES = 1024;
+    const long long DEFAULT_MEMORY_TTL_SECONDS = 3600;
+    const long long DEFAULT_DISK_TTL_SECONDS = 86400;
+    const long long DEFAULT_DISK_MAX_MB = 64;
+
+    // Bumped whenever the key material or the disk layout changes
+    const uint32_t CACHE_FORMAT_VERSION = 1;
+
+    // XXH64
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t read64(const unsigned char* p) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t read32(const unsigned char* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint64_t round64(uint64_t accumulator, uint64_t input) {
+        accumulator += input * PRIME2;
+        accumulator = rotl(accumulator, 31);
+        return accumulator * PRIME1;
+    }
+
+    uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+        accumulator ^= round64(0, value);
+        return accumulator * PRIME1 + PRIME4;
+    }
+
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+        uint64_t h;
+
+        if (size >= 32) {
+            uint64_t v1 = seed + PRIME1 + PRIME2;
+            uint64_t v2 = seed + PRIME2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - PRIME1;
+            do {
+                v1 = round64(v1, read64(p));
+                v2 = round64(v2, read64(p + 8));
+                v3 = round64(v3, read64(p + 16));
+                v4 = round64(v4, read64(p + 24));
+                p += 32;
+            } while (end - p >= 32);
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = mergeRound(h, v1);
+            h = mergeRound(h, v2);
+            h = mergeRound(h, v3);
+            h = mergeRound(h, v4);
+        }
+        else {
+            h = seed + PRIME5;
+        }
+
+        h += static_cast<uint64_t>(size);
+        while (end - p >= 8) {
+            h ^= round64(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+            p += 8;
+        }
+        if (end - p >= 4) {
+            h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        while (p < end) {
+            h ^= (*p) * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+            p++;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    int64_t unixSeconds() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+// Persistent tier: a fixed-size open-addressed index mapped into memory and
+// an append-only file holding the replies. Writers take an exclusive file
+// lock; readers do not lock and rely on the per-entry checksum instead.
+class ResponseCache::DiskTier {
+public:
+    DiskTier(const fs::path& directory, uint64_t maxBytes, std::chrono::seconds ttl)
+        : maxBytes(maxBytes), ttl(ttl), slots(nullptr), mapping(nullptr) {
+        // Replies are conversation text, so only the owner may read them
+        std::error_code error;
+        fs::create_directories(directory, error);
+        fs::permissions(directory, fs::perms::owner_all, fs::perm_options::replace, error);
+        indexPath = (directory / "responses.idx").string();
+        dataPath = (directory / "responses.dat").string();
+
+        if (!mapIndex()) {
+            return;
+        }
+
+#ifndef _WIN32
+        // std::fstream would create the file with the umask defaults; a file
+        // left by an older build is tightened as well
+        int created = open(dataPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (created >= 0) {
+            fchmod(created, 0600);
+            close(created);
+        }
+#endif
+        data.open(dataPath, std::ios::in | std::ios::out | std::ios::binary);
+        if (!data.is_open()) {
+            data.open(dataPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+        if (!data.is_open()) {
+            unmapIndex();
+        }
+    }
+
+    ~DiskTier() {
+        unmapIndex();
+    }
+
+    bool isOpen() const {
+        return slots != nullptr;
+    }
+
+    bool lookup(const CacheKey& key, std::string& response, std::chrono::seconds& remaining) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int64_t now = unixSeconds();
+
+        for (uint32_t i = 0; i < PROBE_LIMIT; i++) {
+            Slot slot;
+            memcpy(&slot, &slots[(key.high + i) % SLOT_COUNT], sizeof(slot));
+            if (slot.high == 0 && slot.low == 0) {
+                return false;
+            }
+            if (slot.high != key.high || slot.low != key.low) {
+                continue;
+            }
+            if (slot.expiresAt <= now) {
+                return false;
+            }
+
+            std::string value(slot.length, '\0');
+            data.clear();
+            data.seekg(static_cast<std::streamoff>(slot.offset));
+            if (!data.read(&value[0], slot.length) ||
+                static_cast<uint32_t>(hashBytes(value.data(), value.size(), 0)) != slot.checksum) {
+                // Torn write, or the data file was reset by another process
+                return false;
+            }
+            response = std::move(value);
+            remaining = std::chrono::seconds(slot.expiresAt - now);
+            return true;
+        }
+        return false;
+    }
+
+    void store(const CacheKey& key, const std::string& response) {
+        if (response.size() > maxBytes || response.size() > UINT32_MAX) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        FileLock fileLock(*this);
+        int64_t now = unixSeconds();
+
+        // Reuse the key's own slot, then an empty or expired one, else evict the oldest
+        Slot* target = nullptr;
+        for (uint32_t i = 0; i < PROBE_LIMIT; i++) {
+            Slot* slot = &slots[(key.high + i) % SLOT_COUNT];
+            bool empty = slot->high == 0 && slot->low == 0;
+            if ((slot->high == key.high && slot->low == key.low) || empty || slot->expiresAt <= now) {
+                target = slot;
+                break;
+            }
+            if (!target || slot->expiresAt < target->expiresAt) {
+                target = slot;
+            }
+        }
+
+        data.clear();
+        data.seekp(0, std::ios::end);
+        uint64_t offset = static_cast<uint64_t>(data.tellp());
+        if (offset + response.size() > maxBytes) {
+            resetLocked();
+            offset = 0;
+        }
+        data.write(response.data(), static_cast<std::streamsize>(response.size()));
+        data.flush();
+        if (!data) {
+            return;
+        }
+
+        // Invalidate the slot before rewriting it so readers never pair a key with other data
+        target->high = 0;
+        target->low = 0;
+        target->expiresAt = now + ttl.count();
+        target->offset = offset;
+        target->length = static_cast<uint32_t>(response.size());
+        target->checksum = static_cast<uint32_t>(hashBytes(response.data(), response.size(), 0));
+        target->low = key.low;
+        target->high = key.high;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        FileLock fileLock(*this);
+        resetLocked();
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotCount;
+        uint8_t reserved[48];
+    };
+
+    struct Slot {
+        uint64_t high;
+        uint64_t low;
+        int64_t expiresAt;  // Unix time
+        uint64_t offset;    // Position in the data file
+        uint32_t length;
+        uint32_t checksum;  // Low half of the reply hash
+    };
+
+    static const uint32_t SLOT_COUNT = 16384;
+    static const uint32_t PROBE_LIMIT = 16;
+    static constexpr size_t INDEX_SIZE = sizeof(Header) + SLOT_COUNT * sizeof(Slot);
+
+    class FileLock {
+    public:
+        explicit FileLock(DiskTier& tier) : tier(tier) { tier.lockFile(); }
+        ~FileLock() { tier.unlockFile(); }
+    private:
+        DiskTier& tier;
+    };
+
+    // Caller holds both locks
+    void resetLocked() {
+        memset(static_cast<void*>(slots), 0, SLOT_COUNT * sizeof(Slot));
+        data.close();
+        data.open(dataPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+
+    bool headerValid() const {
+        const Header* header = static_cast<const Header*>(mapping);
+        return memcmp(header->magic, "PICHATRC", 8) == 0 &&
+            header->version == CACHE_FORMAT_VERSION && header->slotCount == SLOT_COUNT;
+    }
+
+    void writeHeader() {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "PICHATRC", 8);
+        header.version = CACHE_FORMAT_VERSION;
+        header.slotCount = SLOT_COUNT;
+        memset(mapping, 0, INDEX_SIZE);
+        memcpy(mapping, &header, sizeof(header));
+    }
+
+#ifdef _WIN32
+    bool mapIndex() {
+        file = CreateFileA(indexPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        lockFile();
+        LARGE_INTEGER size;
+        bool fresh = !GetFileSizeEx(file, &size) || size.QuadPart != static_cast<LONGLONG>(INDEX_SIZE);
+        if (fresh) {
+            LARGE_INTEGER target;
+            target.QuadPart = static_cast<LONGLONG>(INDEX_SIZE);
+            SetFilePointerEx(file, target, NULL, FILE_BEGIN);
+            SetEndOfFile(file);
+        }
+
+        mappingHandle = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(INDEX_SIZE), NULL);
+        if (mappingHandle) {
+            mapping = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, INDEX_SIZE);
+        }
+        if (mapping) {
+            if (fresh || !headerValid()) {
+                writeHeader();
+            }
+            slots = reinterpret_cast<Slot*>(static_cast<char*>(mapping) + sizeof(Header));
+        }
+        unlockFile();
+
+        if (!slots) {
+            unmapIndex();
+            return false;
+        }
+        return true;
+    }
+
+    void unmapIndex() {
+        if (mapping) {
+            UnmapViewOfFile(mapping);
+            mapping = nullptr;
+        }
+        if (mappingHandle) {
+            CloseHandle(mappingHandle);
+            mappingHandle = NULL;
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+        slots = nullptr;
+    }
+
+    void lockFile() {
+        OVERLAPPED overlapped = {};
+        LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+    }
+
+    void unlockFile() {
+        OVERLAPPED overlapped = {};
+        UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &overlapped);
+    }
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    bool mapIndex() {
+        fd = open(indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            return false;
+        }
+
+        lockFile();
+        struct stat info;
+        bool fresh = fstat(fd, &info) != 0 || info.st_size != static_cast<off_t>(INDEX_SIZE);
+        if (fresh && ftruncate(fd, static_cast<off_t>(INDEX_SIZE)) != 0) {
+            unlockFile();
+            unmapIndex();
+            return false;
+        }
+
+        void* address = mmap(nullptr, INDEX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address != MAP_FAILED) {
+            mapping = address;
+            if (fresh || !headerValid()) {
+                writeHeader();
+            }
+            slots = reinterpret_cast<Slot*>(static_cast<char*>(mapping) + sizeof(Header));
+        }
+        unlockFile();
+
+        if (!slots) {
+            unmapIndex();
+            return false;
+        }
+        return true;
+    }
+
+    void unmapIndex() {
+        if (mapping) {
+            munmap(mapping, INDEX_SIZE);
+            mapping = nullptr;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        slots = nullptr;
+    }
+
+    void lockFile() {
+        flock(fd, LOCK_EX);
+    }
+
+    void unlockFile() {
+        flock(fd, LOCK_UN);
+    }
+
+    int fd = -1;
+#endif
+
+    uint64_t maxBytes;
+    std::chrono::seconds ttl;
+    std::string indexPath;
+    std::string dataPath;
+    Slot* slots;
+    void* mapping;
+    std::fstream data;
+    std::mutex mutex;
+};
+
+ResponseCache& ResponseCache::getInstance() {
+    static ResponseCache instance;
+    return instance;
+}
+
+ResponseCache::ResponseCache()
+    : memoryHits(0),
+      diskHits(0),
+      misses(0),
+      stores(0),
+      evictions(0) {
+    ConfigManager& config = ConfigManager::getInstance();
+    enabled = config.getIntSetting("cache_enabled", 1) != 0;
+
+    long long memoryEntries = config.getIntSetting("cache_memory_entries", DEFAULT_MEMORY_ENTRIES);
+    entriesPerShard = std::max<size_t>(1, static_cast<size_t>(std::max(0LL, memoryEntries)) / SHARD_COUNT);
+    memoryTtl = std::chrono::seconds(config.getIntSetting("cache_ttl_seconds", DEFAULT_MEMORY_TTL_SECONDS));
+
+    long long diskMaxMb = config.getIntSetting("cache_disk_max_mb", DEFAULT_DISK_MAX_MB);
+    if (enabled && diskMaxMb > 0) {
+        std::chrono::seconds diskTtl(config.getIntSetting("cache_disk_ttl_seconds", DEFAULT_DISK_TTL_SECONDS));
+        disk = std::make_unique<DiskTier>(fs::path(config.getConfigDirectory()) / "cache",
+            static_cast<uint64_t>(diskMaxMb) * 1024 * 1024, diskTtl);
+        if (!disk->isOpen()) {
+            ErrorHandler::getInstance().logWarning("Disk cache unavailable, using memory only", "ResponseCache");
+            disk.reset();
+        }
+    }
+}
+
+ResponseCache::~ResponseCache() = default;
+
+CacheKey ResponseCache::makeKey(const ConversationHistory& messages, const std::string& model,
+    float temperature, int maxTokens) {
+    // Fixed-size parameters first, then each variable-length part; every part
+    // mixes in its own length, so boundaries are unambiguous
+    struct {
+        uint32_t version;
+        uint32_t temperatureBits;
+        int64_t maxTokens;
+        uint64_t messageCount;
+    } parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.version = CACHE_FORMAT_VERSION;
+    memcpy(&parameters.temperatureBits, &temperature, sizeof(temperature));
+    parameters.maxTokens = maxTokens;
+    parameters.messageCount = messages.size();
+
+    CacheKey key;
+    key.high = hashBytes(&parameters, sizeof(parameters), 0x243F6A8885A308D3ULL);
+    key.low = hashBytes(&parameters, sizeof(parameters), 0x13198A2E03707344ULL);
+    key.high = hashBytes(model.data(), model.size(), key.high);
+    key.low = hashBytes(model.data(), model.size(), key.low);
+    for (const auto& message : messages) {
+        std::shared_ptr<const std::string> fragment = message.jsonFragment();
+        key.high = hashBytes(fragment->data(), fragment->size(), key.high);
+        key.low = hashBytes(fragment->data(), fragment->size(), key.low);
+    }
+    return key;
+}
+
+ResponseCache::Shard& ResponseCache::shardFor(const CacheKey& key) {
+    return shards[key.low % SHARD_COUNT];
+}
+
+bool ResponseCache::lookupMemory(const CacheKey& key, std::string& response) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return false;
+    }
+    if (it->second->expiresAt <= std::chrono::steady_clock::now()) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    response = it->second->response;
+    return true;
+}
+
+void ResponseCache::storeMemory(const CacheKey& key, const std::string& response, std::chrono::seconds ttl) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto expiresAt = std::chrono::steady_clock::now() + ttl;
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        it->second->response = response;
+        it->second->expiresAt = expiresAt;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+
+    shard.entries.push_front(Entry{ key, response, expiresAt });
+    shard.index.emplace(key, shard.entries.begin());
+    while (shard.entries.size() > entriesPerShard) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool ResponseCache::lookup(const CacheKey& key, std::string& response) {
+    if (!enabled) {
+        return false;
+    }
+
+    if (lookupMemory(key, response)) {
+        memoryHits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::chrono::seconds remaining;
+    if (disk && disk->lookup(key, response, remaining)) {
+        // Promote so repeats are served from memory, but no longer than the disk entry lives
+        storeMemory(key, response, std::min(memoryTtl, remaining));
+        diskHits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ResponseCache::store(const CacheKey& key, const std::string& response) {
+    if (!enabled) {
+        return;
+    }
+
+    storeMemory(key, response, memoryTtl);
+    if (disk) {
+        disk->store(key, response);
+    }
+    stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ResponseCache::clear() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+    }
+    if (disk) {
+        disk->clear();
+    }
+}
+
+bool ResponseCache::isEnabled() const {
+    return enabled;
+}
+
+void ResponseCache::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+CacheStats ResponseCache::getStats() const {
+    CacheStats stats;
+    stats.memoryHits = memoryHits.load(std::memory_order_relaxed);
+    stats.diskHits = diskHits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.stores = stores.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    stats.memoryEntries = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.memoryEntries += shard.entries.size();
+    }
+    return stats;
+}
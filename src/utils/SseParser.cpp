@@ -0,0 +1,167 @@
+#include "include/utils/SseParser.h"
+#include <cstring>
+
+namespace {
+    // Sentinel the chat API sends as the data of its final event
+    const std::string_view DONE_SENTINEL = "[DONE]";
+
+    // Find the first '\n' or '\r' in [begin, end), or nullptr
+    const char* findLineEnd(const char* begin, const char* end) {
+        const char* lineFeed = static_cast<const char*>(memchr(begin, '\n', end - begin));
+        const char* limit = lineFeed ? lineFeed : end;
+        const char* carriageReturn = static_cast<const char*>(memchr(begin, '\r', limit - begin));
+        return carriageReturn ? carriageReturn : lineFeed;
+    }
+}
+
+SseParser::SseParser(EventHandler onEvent, size_t initialCapacity)
+    : onEvent(std::move(onEvent)),
+      hasPending(false),
+      pendingInChunk(false),
+      skipLineFeed(false),
+      done(false) {
+    lineBuffer.reserve(initialCapacity);
+    eventBuffer.reserve(initialCapacity);
+}
+
+void SseParser::feed(const char* data, size_t size) {
+    const char* cursor = data;
+    const char* end = data + size;
+
+    while (cursor < end) {
+        if (skipLineFeed) {
+            skipLineFeed = false;
+            if (*cursor == '\n') {
+                cursor++;
+                continue;
+            }
+        }
+
+        const char* lineEnd = findLineEnd(cursor, end);
+        if (!lineEnd) {
+            // Incomplete line: keep it until the next chunk completes it
+            lineBuffer.append(cursor, end - cursor);
+            break;
+        }
+
+        if (lineBuffer.empty()) {
+            processLine(std::string_view(cursor, lineEnd - cursor), false);
+        }
+        else {
+            lineBuffer.append(cursor, lineEnd - cursor);
+            processLine(lineBuffer, true);
+            lineBuffer.clear();
+        }
+
+        // "\r\n" counts as a single line terminator, even across chunks
+        if (*lineEnd == '\r') {
+            if (lineEnd + 1 == end) {
+                skipLineFeed = true;
+            }
+            else if (lineEnd[1] == '\n') {
+                lineEnd++;
+            }
+        }
+        cursor = lineEnd + 1;
+    }
+
+    // The chunk goes away after this call; keep the data of an open event
+    if (hasPending && pendingInChunk) {
+        eventBuffer.assign(pendingData.data(), pendingData.size());
+        pendingData = eventBuffer;
+        pendingInChunk = false;
+    }
+}
+
+void SseParser::finish() {
+    if (!lineBuffer.empty()) {
+        processLine(lineBuffer, true);
+        lineBuffer.clear();
+    }
+    dispatch();
+}
+
+bool SseParser::isDone() const {
+    return done;
+}
+
+void SseParser::reset() {
+    lineBuffer.clear();
+    eventBuffer.clear();
+    pendingData = std::string_view();
+    hasPending = false;
+    pendingInChunk = false;
+    skipLineFeed = false;
+    done = false;
+}
+
+void SseParser::processLine(std::string_view line, bool lineIsBuffered) {
+    // A blank line ends the current event
+    if (line.empty()) {
+        dispatch();
+        return;
+    }
+
+    // Comment lines, used by the API as keep-alives
+    if (line[0] == ':') {
+        return;
+    }
+
+    size_t colon = line.find(':');
+    std::string_view field = line.substr(0, colon);
+    std::string_view value;
+    if (colon != std::string_view::npos) {
+        value = line.substr(colon + 1);
+        if (!value.empty() && value[0] == ' ') {
+            value.remove_prefix(1);
+        }
+    }
+
+    // event, id and retry fields carry nothing the chat API needs
+    if (field != "data") {
+        return;
+    }
+
+    if (!hasPending) {
+        hasPending = true;
+        if (lineIsBuffered) {
+            eventBuffer.assign(value.data(), value.size());
+            pendingData = eventBuffer;
+            pendingInChunk = false;
+        }
+        else {
+            pendingData = value;
+            pendingInChunk = true;
+        }
+        return;
+    }
+
+    // Several data lines in one event are joined with '\n'
+    if (pendingInChunk) {
+        eventBuffer.assign(pendingData.data(), pendingData.size());
+        pendingInChunk = false;
+    }
+    eventBuffer.push_back('\n');
+    eventBuffer.append(value.data(), value.size());
+    pendingData = eventBuffer;
+}
+
+void SseParser::dispatch() {
+    if (!hasPending) {
+        return;
+    }
+
+    std::string_view data = pendingData;
+    hasPending = false;
+    pendingInChunk = false;
+    pendingData = std::string_view();
+
+    if (data == DONE_SENTINEL) {
+        done = true;
+        return;
+    }
+
+    if (onEvent) {
+        onEvent(data);
+    }
+}
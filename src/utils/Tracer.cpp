@@ -0,0 +1,213 @@
+#include "include/utils/Tracer.h"
+#include "include/config/ConfigManager.h"
+#include "include/utils/ErrorHandler.h"
+#include "include/utils/JsonWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    const long long DEFAULT_BUFFER_EVENTS = 16384;
+
+    // Buffers of threads that have exited are kept for the next export, up to this many
+    const size_t MAX_EXITED_BUFFERS = 32;
+
+    // Kept apart from the buffer, which is only allocated once the thread records
+    thread_local const char* currentThreadName = nullptr;
+
+    long long processId() {
+#ifdef _WIN32
+        return static_cast<long long>(GetCurrentProcessId());
+#else
+        return static_cast<long long>(getpid());
+#endif
+    }
+
+    void appendEventHead(std::string& out, const char* name, const char* category, char phase,
+        long long pid, uint64_t tid, int64_t timestamp) {
+        out.append("{\"name\":");
+        JsonWriter::appendString(out, name);
+        out.append(",\"cat\":");
+        JsonWriter::appendString(out, category);
+        out.append(",\"ph\":\"");
+        out.push_back(phase);
+        out.append("\",\"pid\":");
+        JsonWriter::appendInt(out, pid);
+        out.append(",\"tid\":");
+        JsonWriter::appendInt(out, static_cast<long long>(tid));
+        out.append(",\"ts\":");
+        JsonWriter::appendInt(out, timestamp);
+    }
+}
+
+std::atomic<bool> Tracer::active(false);
+
+Tracer& Tracer::getInstance() {
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::Tracer() : nextThreadId(1), wasEnabled(false) {
+    // ConfigManager is traced too, but only checks isEnabled() while tracing is off
+    ConfigManager& config = ConfigManager::getInstance();
+    capacity = static_cast<size_t>(std::max(16LL, config.getIntSetting("trace_buffer_events", DEFAULT_BUFFER_EVENTS)));
+    traceFile = config.getSetting("trace_file",
+        (std::filesystem::path(config.getConfigDirectory()) / "trace.json").string());
+
+    const char* environment = std::getenv("PICHAT_TRACE");
+    bool fromEnvironment = environment && std::string(environment) != "" && std::string(environment) != "0";
+    setEnabled(fromEnvironment || config.getIntSetting("trace_enabled", 0) != 0);
+}
+
+Tracer::ThreadSlot::~ThreadSlot() {
+    if (buffer) {
+        buffer->exited.store(true);
+    }
+}
+
+void Tracer::setEnabled(bool enabled) {
+    if (enabled) {
+        wasEnabled.store(true);
+    }
+    active.store(enabled);
+}
+
+int64_t Tracer::now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    thread_local ThreadSlot slot;
+    if (slot.buffer) {
+        return *slot.buffer;
+    }
+
+    auto buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer->events.resize(capacity);
+    buffer->threadId = nextThreadId++;
+    buffer->threadName = currentThreadName;
+
+    // Short-lived threads would otherwise pile up buffers nobody writes to
+    size_t exited = static_cast<size_t>(std::count_if(buffers.begin(), buffers.end(),
+        [](const std::shared_ptr<ThreadBuffer>& entry) { return entry->exited.load(); }));
+    for (auto it = buffers.begin(); it != buffers.end() && exited > MAX_EXITED_BUFFERS;) {
+        if ((*it)->exited.load()) {
+            it = buffers.erase(it);
+            exited--;
+        }
+        else {
+            ++it;
+        }
+    }
+
+    buffers.push_back(buffer);
+    slot.buffer = std::move(buffer);
+    return *slot.buffer;
+}
+
+void Tracer::record(const Event& event) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events[buffer.next] = event;
+    if (++buffer.next == buffer.events.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+void Tracer::complete(const char* name, const char* category, int64_t start, int64_t duration) {
+    record(Event{ name, category, 'X', start, duration, 0 });
+}
+
+void Tracer::asyncBegin(const char* name, const char* category, uint64_t id) {
+    if (isEnabled()) {
+        record(Event{ name, category, 'b', now(), 0, id });
+    }
+}
+
+void Tracer::asyncEnd(const char* name, const char* category, uint64_t id) {
+    if (isEnabled()) {
+        record(Event{ name, category, 'e', now(), 0, id });
+    }
+}
+
+void Tracer::setThreadName(const char* name) {
+    currentThreadName = name;
+}
+
+std::string Tracer::toChromeJson() const {
+    std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = buffers;
+    }
+
+    long long pid = processId();
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&out, &first]() {
+        if (!first) {
+            out.append(",\n");
+        }
+        first = false;
+        };
+
+    for (const auto& buffer : snapshot) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->threadName) {
+            separate();
+            appendEventHead(out, "thread_name", "__metadata", 'M', pid, buffer->threadId, 0);
+            out.append(",\"args\":{\"name\":");
+            JsonWriter::appendString(out, buffer->threadName);
+            out.append("}}");
+        }
+
+        // Oldest first; after wrapping, the oldest entry is the next to be overwritten
+        size_t count = buffer->wrapped ? buffer->events.size() : buffer->next;
+        size_t index = buffer->wrapped ? buffer->next : 0;
+        for (size_t i = 0; i < count; i++) {
+            const Event& event = buffer->events[index];
+            index = index + 1 == buffer->events.size() ? 0 : index + 1;
+
+            separate();
+            appendEventHead(out, event.name, event.category, event.phase, pid, buffer->threadId, event.timestamp);
+            if (event.phase == 'X') {
+                out.append(",\"dur\":");
+                JsonWriter::appendInt(out, event.duration);
+            }
+            else {
+                out.append(",\"id\":");
+                JsonWriter::appendInt(out, static_cast<long long>(event.id));
+            }
+            out.push_back('}');
+        }
+    }
+    out.append("]}\n");
+    return out;
+}
+
+bool Tracer::writeChromeJson(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        ErrorHandler::getInstance().logError("Cannot write trace to " + path, "Tracer");
+        return false;
+    }
+    file << toChromeJson();
+    return static_cast<bool>(file);
+}
+
+void Tracer::writeOnExit() const {
+    if (wasEnabled.load() && !traceFile.empty()) {
+        writeChromeJson(traceFile);
+    }
+}
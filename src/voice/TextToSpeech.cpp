@@ -1,4 +1,5 @@
 #include "include/voice/TextToSpeech.h"
+#include "include/utils/Tracer.h"
 #include <iostream>
 #include <Windows.h>
 #include <sapi.h>
@@ -20,10 +21,15 @@ bool TextToSpeech::speak(const std::string& text) {
     if (text.empty()) {
         return false;
     }
+    TraceSpan span("TextToSpeech::speak", "voice");
+
+    // May run on an Executor worker, which has not initialized COM yet
+    HRESULT init = CoInitialize(NULL);
 
     ISpVoice* pVoice = NULL;
     HRESULT hr = CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, IID_ISpVoice, (void**)&pVoice);
 
+    bool spoken = false;
     if (SUCCEEDED(hr)) {
         // Convert ASCII text to wide characters
         int size_needed = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, NULL, 0);
@@ -32,10 +38,13 @@ bool TextToSpeech::speak(const std::string& text) {
 
         hr = pVoice->Speak(wstrText.c_str(), 0, NULL);
         pVoice->Release();
-        return SUCCEEDED(hr);
+        spoken = SUCCEEDED(hr);
     }
 
-    return false;
+    if (SUCCEEDED(init)) {
+        CoUninitialize();
+    }
+    return spoken;
 }
 
 void TextToSpeech::shutdown() {
@@ -2,10 +2,12 @@
 #include "include/voice/SpeechRecognizer.h"
 #include "include/voice/TextToSpeech.h"
 #include "include/voice/CommandProcessor.h"
+#include "include/utils/Executor.h"
+#include "include/utils/Metrics.h"
 #include <iostream>
 #include <chrono>
 
-VoiceManager::VoiceManager() : listening(false) {
+VoiceManager::VoiceManager() : listening(false), speaking(false) {
     speechRecognizer = std::make_unique<SpeechRecognizer>();
     textToSpeech = std::make_unique<TextToSpeech>();
     commandProcessor = std::make_unique<CommandProcessor>();
@@ -86,6 +88,9 @@ void VoiceManager::speak(const std::string& text) {
     // Calculate latency
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+    static MetricHistogram& speakSeconds = Metrics::getInstance().histogram("pichat_voice_speak_seconds",
+        "Time to speak one reply", 1e-3, Metrics::latencyBounds());
+    speakSeconds.observe(std::chrono::duration<double>(endTime - startTime).count());
 
     // Log latency if it exceeds threshold (3000ms = 3 seconds)
     if (duration > 3000) {
@@ -93,6 +98,38 @@ void VoiceManager::speak(const std::string& text) {
     }
 }
 
+void VoiceManager::speakAsync(const std::string& text) {
+    bool start;
+    {
+        std::lock_guard<std::mutex> lock(speechMutex);
+        speechQueue.push_back(text);
+        start = !speaking;
+        speaking = true;
+    }
+
+    if (start) {
+        Executor::getInstance().submit([this]() {
+            drainSpeech();
+            });
+    }
+}
+
+void VoiceManager::drainSpeech() {
+    for (;;) {
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(speechMutex);
+            if (speechQueue.empty()) {
+                speaking = false;
+                return;
+            }
+            text = std::move(speechQueue.front());
+            speechQueue.pop_front();
+        }
+        speak(text);
+    }
+}
+
 bool VoiceManager::processCommand(const std::string& command) {
     return commandProcessor->processCommand(command);
 }